@@ -0,0 +1,96 @@
+-- Per-tick cost of Pong-style scripts at scale, for comparing Lua runtimes.
+-- Loaded by LuaBridge_test, which binds the Instances view before running it.
+--
+-- This is pong.lua's Rigidbody/BoxCollider2d loop from before Physics2D took it over,
+-- unchanged but for one ball per entity. pong.lua itself now has one paddle and one
+-- ball, and leaves that loop to native code, so it can't be scaled; LuaBridge_test
+-- runs it as is, next to this.
+
+---@class _G
+---@field package Instances table
+
+local N, TICKS = ...
+local DT = 1 / 120
+local BOUNDS = 1.0
+
+local Rigidbody = {}
+Rigidbody.__index = Rigidbody
+function Rigidbody.new(inst, vx, vy)
+  local self = setmetatable({}, Rigidbody)
+  self.inst = inst
+  self.vx = vx
+  self.vy = vy
+  self.x = inst.posX
+  self.y = inst.posY
+  self.prevX = self.x
+  self.prevY = self.y
+  return self
+end
+
+function Rigidbody:update(dt)
+  self.prevX = self.x
+  self.prevY = self.y
+  self.x = self.x + self.vx * dt
+  self.y = self.y + self.vy * dt
+end
+
+function Rigidbody:draw(alpha)
+  self.inst.posX = self.prevX + (self.x - self.prevX) * alpha
+  self.inst.posY = self.prevY + (self.y - self.prevY) * alpha
+end
+
+local BoxCollider2d = {}
+BoxCollider2d.__index = BoxCollider2d
+function BoxCollider2d.new(rb, width, height)
+  local self = setmetatable({}, BoxCollider2d)
+  self.rb = rb
+  self.width = width
+  self.height = height
+  return self
+end
+
+function BoxCollider2d:checkCollision(other)
+  local r1x = self.rb.x - self.width / 2
+  local r1y = self.rb.y - self.height / 2
+  local r2x = other.rb.x - other.width / 2
+  local r2y = other.rb.y - other.height / 2
+  return r1x + self.width >= r2x and r1x <= r2x + other.width and
+      r1y + self.height >= r2y and r1y <= r2y + other.height
+end
+
+-- every entity is a ball; entity 0 doubles as the paddle everyone checks against
+local colliders = {}
+for i = 0, N - 1 do
+  local inst = _G.Instances:at(i)
+  inst.posX = (i % 100) / 50 - 1
+  inst.posY = math.floor(i / 100) / 50 - 1
+  inst.scaleX = 0.02
+  inst.scaleY = 0.02
+  inst.texId = 2
+  local rb = Rigidbody.new(inst, 0.5 - (i % 7) / 7, 0.5 - (i % 11) / 11)
+  colliders[i + 1] = BoxCollider2d.new(rb, 0.02, 0.02)
+end
+local paddle = colliders[1]
+
+-- one fixed update plus one interpolated draw, like Pong's OnFixedUpdate + OnUpdate
+function Tick()
+  local hits = 0
+  for i = 1, N do
+    local c = colliders[i]
+    local rb = c.rb
+    rb:update(DT)
+    if rb.x < -BOUNDS or rb.x > BOUNDS then rb.vx = -rb.vx end
+    if rb.y < -BOUNDS or rb.y > BOUNDS then rb.vy = -rb.vy end
+    if i > 1 and c:checkCollision(paddle) then hits = hits + 1 end
+  end
+  for i = 1, N do
+    colliders[i].rb:draw(0.5)
+  end
+  return hits
+end
+
+function Run()
+  for _ = 1, TICKS do Tick() end
+end
+
+return jit and jit.version or _VERSION
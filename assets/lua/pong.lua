@@ -2,16 +2,19 @@ print("[Lua] pong script loading.")
 
 -- external interface
 ---@class _G
----@field package LoadTexture fun(file: string): nil
----@field package LoadAudioFile fun(file: string): nil
----@field package LoadShader fun(file: string): nil
----@field package PlayAudio fun(id: number, loop: boolean, gain: number): nil
+---@field package LoadTexture fun(file: string): number
+---@field package LoadAudioFile fun(file: string): number
+---@field package LoadShader fun(file: string): number
+---@field package AssetStatus fun(handle: number): string, number|string|nil
+---@field package LoadingProgress fun(): number, number
+---@field package PlayAudio fun(handle: number, loop: boolean, gain: number): nil
 ---@field package AddInstance fun(): number
 ---@field package GetGamepadInput fun(id: number): number, number, number, number, boolean, boolean, boolean, boolean
 ---@field package GetKeyboardInput fun(): boolean, boolean, boolean, boolean, boolean, number, number
----@field package ReadInstanceVBO fun(id: number): number, number, number, number, number, number, number, number, number, number
----@field package WriteInstanceVBO fun(id: number, posX: number, posY: number, posZ: number, rotX: number, rotY: number, rotZ: number, scaleX: number, scaleY: number, scaleZ: number, texId: number): nil
+---@field package Instances InstanceView
+---@field package WriteInstances fun(first: number, count: number, packed: number[]): nil
 ---@field package WriteWorldUBO fun(aspect: number, camX: number, camY: number, camZ: number, lookX: number, lookY: number, lookZ: number, user1X: number, user1Y: number, user2X: number, user2Y: number): nil
+---@field package Physics Physics
 ---@field package Exit fun(): nil
 
 -- internal OOP
@@ -68,8 +71,13 @@ end
 
 local world = World.new()
 
+---@class InstanceView native instance array, as drawn
+---@field public at fun(self: InstanceView, id: number): Instance
+---@field public write fun(self: InstanceView, first: number, count: number, packed: number[]): nil
+---@field public read fun(self: InstanceView, first: number, count: number, packed?: number[]): number[]
+
+-- NOTICE: instances are views into native memory; writes go straight to the renderer.
 ---@class Instance
----@field public id number
 ---@field public posX number
 ---@field public posY number
 ---@field public posZ number
@@ -79,53 +87,37 @@ local world = World.new()
 ---@field public scaleX number
 ---@field public scaleY number
 ---@field public scaleZ number
----@field public texId number
+---@field public texId number texture slot * 65536 + region; the slot is a texture's AssetStatus() value
 local Instance = {}
-Instance.__index = Instance
+-- starts at the origin, unrotated, at scale 1, with texId 0
+---@return Instance, number proxy, and instance id
 function Instance.new()
-  local self = setmetatable({}, Instance)
-  self.id = _G.AddInstance()
-  self.posX = 0
-  self.posY = 0
-  self.posZ = 0
-  self.rotX = 0
-  self.rotY = 0
-  self.rotZ = 0
-  self.scaleX = 1
-  self.scaleY = 1
-  self.scaleZ = 1
-  self.texId = 0
-  return self
+  local id = _G.AddInstance()
+  return _G.Instances:at(id), id
 end
 
-function Instance:push()
-  _G.WriteInstanceVBO(self.id, self.posX, self.posY, self.posZ, self.rotX, self.rotY, self.rotZ, self.scaleX, self
-    .scaleY, self.scaleZ, self.texId)
-end
-
--- preload assets
+-- NOTICE: bodies are simulated natively, at the fixed update rate; the engine draws them
+-- at their interpolated position, and reports contacts to OnContacts() in one batch.
+---@class Physics
+---@field public add fun(instance: number, x: number, y: number, width?: number, height?: number): number
+---@field public position fun(id: number): number, number
+---@field public velocity fun(id: number): number, number
+---@field public setVelocity fun(id: number, vx: number, vy: number): nil
+---@field public teleport fun(id: number, x: number, y: number): nil
+---@field public setActive fun(id: number, active: boolean): nil
+
+-- preload assets; each load returns a handle right away, and finishes in the background
 _G.LoadTexture("../assets/textures/pong-atlas.png")
-_G.LoadAudioFile("../assets/audio/music/retro.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-01.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-02.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-03.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-04.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-05.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-06.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-07.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-08.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-09.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-10.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-11.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-12.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-13.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-14.wav")
-_G.LoadAudioFile("../assets/audio/sfx/pong-15.wav")
+local music = _G.LoadAudioFile("../assets/audio/music/retro.wav")
+local sfx = {}
+for i = 1, 15 do
+  sfx[i] = _G.LoadAudioFile(string.format("../assets/audio/sfx/pong-%02d.wav", i))
+end
 _G.LoadShader("../assets/shaders/simple_shader.frag.spv")
 _G.LoadShader("../assets/shaders/simple_shader.vert.spv")
 
--- play music on loop
-_G.PlayAudio(0, true, 2.0)
+-- play music on loop; plays of audio still loading start once it has
+_G.PlayAudio(music, true, 2.0)
 
 -- position the camera
 world:set(ASPECT_1_1, 0, 0, 1, 0, 0, 0)
@@ -136,7 +128,6 @@ world:push()
 local BACKGROUND_WH = 800
 local background = Instance.new()
 background.texId = 0
-background:push()
 
 local PIXELS_PER_UNIT = BACKGROUND_WH
 function PixelsToUnits(pixels)
@@ -163,7 +154,6 @@ function CreateGlyphs(x, y, scale, txt)
     t.scaleX = PixelsToUnits(GLYPH_W * scale)
     t.scaleY = PixelsToUnits(GLYPH_H * scale)
     t.texId = code
-    t:push()
 
     table.insert(glyphs, t)
   end
@@ -174,57 +164,6 @@ local OFFSET_X = ((-BACKGROUND_WH + (GLYPH_W * GLYPH_SCALE * 2)) / 2)
 local OFFSET_Y = ((-BACKGROUND_WH + (GLYPH_H * GLYPH_SCALE * 2)) / 2)
 local txtScore = CreateGlyphs(OFFSET_X, OFFSET_Y, GLYPH_SCALE, "Score: 0  ")
 
----@class Rigidbody
----@field public inst Instance
----@field public vx number
----@field public vy number
-local Rigidbody = {}
-Rigidbody.__index = Rigidbody
-function Rigidbody.new(inst, vx, vy)
-  local self = setmetatable({}, Rigidbody)
-  self.inst = inst
-  self.vx = vx or 0 -- Velocity along x-axis
-  self.vy = vy or 0 -- Velocity along y-axis
-  return self
-end
-
--- Update the position of the rigid body based on its velocity
----@param dt number
-function Rigidbody:update(dt)
-  self.inst.posX = self.inst.posX + self.vx * dt
-  self.inst.posY = self.inst.posY + self.vy * dt
-end
-
----@class BoxCollider2d
----@field public rb Rigidbody
----@field public width number
----@field public height number
-local BoxCollider2d = {}
-BoxCollider2d.__index = BoxCollider2d
-function BoxCollider2d.new(rb, width, height)
-  local self = setmetatable({}, BoxCollider2d)
-  self.rb = rb
-  self.width = width or 0
-  self.height = height or 0
-  return self
-end
-
--- Check collision between two rectangles
----@param other BoxCollider2d
-function BoxCollider2d:checkCollision(other)
-  local r1x = self.rb.inst.posX - self.width / 2
-  local r1y = self.rb.inst.posY - self.height / 2
-  local r2x = other.rb.inst.posX - other.width / 2
-  local r2y = other.rb.inst.posY - other.height / 2
-
-  local outcome = r1x + self.width >= r2x and -- r1 right edge past r2 left
-      r1x <= r2x + other.width and            -- r1 left edge past r2 right
-      r1y + self.height >= r2y and            -- r1 top edge past r2 bottom
-      r1y <= r2y + other.height               -- r1 bottom edge past r2 top
-
-  return outcome
-end
-
 local PADDLE_START_Y = PixelsToUnits(720) / 2
 local PADDLE_W = PixelsToUnits(170)
 local PADDLE_H = PixelsToUnits(45)
@@ -232,21 +171,13 @@ local PADDLE_SPEED = 1.0 -- per sec
 local PADDLE_SPEED_INC = 1.0 / 10
 local PADDLE_BOUNDS_X = PixelsToUnits(BACKGROUND_WH / 2)
 
-local paddle = Instance.new()
--- NOTICE: coordinate system is 0,0 == center of screen
--- TODO: do I want 0,0 to be in a corner, instead?
-paddle.posX = 0
-paddle.posY = PADDLE_START_Y
+local paddle, paddle_id = Instance.new()
 paddle.scaleX = PADDLE_W
 paddle.scaleY = PADDLE_H
 paddle.texId = 1
-
----@type Rigidbody
-local paddle_rb = Rigidbody.new(paddle, 0, 0)
----@type BoxCollider2d
-local paddle_collider = BoxCollider2d.new(paddle_rb, PADDLE_W, PADDLE_H)
-
-paddle:push()
+-- NOTICE: coordinate system is 0,0 == center of screen
+-- TODO: do I want 0,0 to be in a corner, instead?
+local paddle_body = _G.Physics.add(paddle_id, 0, PADDLE_START_Y, PADDLE_W, PADDLE_H)
 
 local BALL_START_Y = PixelsToUnits(100)
 local BALL_SIZE_WH = PixelsToUnits(45)
@@ -255,27 +186,19 @@ local BALL_SPEED_INC = 1.0 / 50
 local BALL_BOUNDS_X = PixelsToUnits(BACKGROUND_WH / 2)
 local BALL_BOUNDS_Y = PixelsToUnits(BACKGROUND_WH / 2)
 
-local ball = Instance.new()
+local ball, ball_id = Instance.new()
 ball.scaleX = BALL_SIZE_WH
 ball.scaleY = BALL_SIZE_WH
 ball.texId = 2
+local ball_body = _G.Physics.add(ball_id, 0, 0, BALL_SIZE_WH, BALL_SIZE_WH)
 
----@type Rigidbody
-local ball_rb = Rigidbody.new(ball, 0, 0)
----@type BoxCollider2d
-local ball_collider = BoxCollider2d.new(ball_rb, BALL_SIZE_WH, BALL_SIZE_WH)
-
----@param rb Rigidbody
-function Ball__Reset(rb)
-  rb.inst.posX = 0
-  rb.inst.posY = BALL_START_Y / 2
-  rb.vx = BALL_SPEED / 2
-  rb.vy = BALL_SPEED
+---@param body number
+function Ball__Reset(body)
+  _G.Physics.teleport(body, 0, BALL_START_Y / 2)
+  _G.Physics.setVelocity(body, BALL_SPEED / 2, BALL_SPEED)
 end
 
-Ball__Reset(ball_rb)
-
-ball:push()
+Ball__Reset(ball_body)
 
 -- helper functions
 function FixJoyDrift(x)
@@ -313,7 +236,6 @@ end
 function UpdateGlyph(arr, idx, code)
   if code > 31 and code < 128 then
     arr[idx].texId = code
-    arr[idx]:push()
   end
 end
 
@@ -324,60 +246,68 @@ function UpdateScore(score)
   UpdateGlyph(txtScore, 10, GetCharCodeAt(3, score))
 end
 
-local ball_in_collission = false
 local on_ball_hit_paddle = false
-function OnFixedUpdate(deltaTime)
-  if gameState ~= State.PLAYING then return end
 
-  local colliding = ball_collider:checkCollision(paddle_collider)
-  if colliding and ball_in_collission then
-    on_ball_hit_paddle = false
-    ball_in_collission = true
-  elseif not colliding and ball_in_collission then
-    on_ball_hit_paddle = false
-    ball_in_collission = false
-  elseif colliding and not ball_in_collission then
-    on_ball_hit_paddle = true
-    ball_in_collission = true
-  elseif not colliding and not ball_in_collission then
-    on_ball_hit_paddle = false
-    ball_in_collission = false
+-- called after each fixed update which changed any contacts, before OnFixedUpdate()
+---@param entered number[] body id pairs, packed {a1, b1, a2, b2, ...}
+---@param stayed number[]
+---@param exited number[]
+function OnContacts(entered, stayed, exited)
+  for i = 1, #entered, 2 do
+    local a, b = entered[i], entered[i + 1]
+    if (a == ball_body and b == paddle_body) or (a == paddle_body and b == ball_body) then
+      on_ball_hit_paddle = true
+    end
   end
+end
+
+---@param state number
+function SetGameState(state)
+  gameState = state
+  -- the ball only moves during play
+  _G.Physics.setActive(ball_body, gameState == State.PLAYING)
+end
+
+SetGameState(State.PAUSED)
 
-  -- physics moving ball X,Y
-  ball_rb:update(deltaTime)
+function OnFixedUpdate(deltaTime)
+  local hit = on_ball_hit_paddle
+  on_ball_hit_paddle = false
+  if gameState ~= State.PLAYING then return end
+
+  local x, y = _G.Physics.position(ball_body)
+  local vx, vy = _G.Physics.velocity(ball_body)
 
   -- ball bounce off top wall
-  if ball.posY <= -BALL_BOUNDS_Y then
-    ball_rb.vy = math.abs(ball_rb.vy)
+  if y <= -BALL_BOUNDS_Y then
+    vy = math.abs(vy)
 
     -- ball collision w paddle
-  elseif on_ball_hit_paddle then
+  elseif hit then
     -- play one-shot sound effect
-    _G.PlayAudio(math.random(1, 15), false, 0.5)
+    _G.PlayAudio(sfx[math.random(1, 15)], false, 0.5)
 
     score = score + 1
     UpdateScore(score)
 
-    ball_rb.vy = -math.abs(ball_rb.vy)
+    vy = -math.abs(vy)
 
     -- incease ball velocity with each hit
-    ball_rb.vx = ball_rb.vx + (ball_rb.vx * BALL_SPEED_INC)
-    ball_rb.vy = ball_rb.vy + (ball_rb.vy * BALL_SPEED_INC)
+    vx = vx + (vx * BALL_SPEED_INC)
+    vy = vy + (vy * BALL_SPEED_INC)
 
     -- ball missed paddle
-  elseif ball.posY >= BALL_BOUNDS_Y then
-    gameState = State.SCORE
+  elseif y >= BALL_BOUNDS_Y then
+    SetGameState(State.SCORE)
   end
 
   -- ball collision with side walls
-  if ball.posX >= BALL_BOUNDS_X then
-    ball_rb.vx = -math.abs(ball_rb.vx)
-  elseif ball.posX <= -BALL_BOUNDS_X then
-    ball_rb.vx = math.abs(ball_rb.vx)
+  if x >= BALL_BOUNDS_X then
+    vx = -math.abs(vx)
+  elseif x <= -BALL_BOUNDS_X then
+    vx = math.abs(vx)
   end
-
-  ball:push()
+  _G.Physics.setVelocity(ball_body, vx, vy)
 end
 
 function b(v)
@@ -394,7 +324,9 @@ local left1, right1, left2, right2 = false, false, false, false
 local kbXAxis, xAxis = 0.0, 0.0
 local x = 0
 
-function OnUpdate(deltaTime)
+---@param deltaTime number
+---@param alpha number progress toward the next fixed update [0, 1)
+function OnUpdate(deltaTime, alpha)
   -- read gamepad input
   x1, y1, x2, y2, b1, b2, b3, b4 = _G.GetGamepadInput(0)
   -- on button press
@@ -475,26 +407,27 @@ function OnUpdate(deltaTime)
 
   if pressed then
     if gameState == State.SCORE then
-      gameState = State.PAUSED
+      SetGameState(State.PAUSED)
       score = 0
       UpdateScore(score)
-      Ball__Reset(ball_rb)
-      ball:push()
+      Ball__Reset(ball_body)
     elseif gameState == State.PAUSED then
-      gameState = State.PLAYING
+      SetGameState(State.PLAYING)
     elseif gameState == State.PLAYING then
-      gameState = State.PAUSED
+      SetGameState(State.PAUSED)
     end
   end
 
   -- apply joystick movement over time
-  x = (FixJoyDrift(xAxis) * math.abs(ball_rb.vx) * deltaTime)
+  local ball_vx = _G.Physics.velocity(ball_body)
+  x = (FixJoyDrift(xAxis) * math.abs(ball_vx) * deltaTime)
 
   if x ~= 0 then
     -- player moving paddle X
-    paddle.posX = Math__clamp(paddle.posX + x, -PADDLE_BOUNDS_X, PADDLE_BOUNDS_X)
-    paddle:push()
+    local paddle_x, paddle_y = _G.Physics.position(paddle_body)
+    _G.Physics.teleport(paddle_body, Math__clamp(paddle_x + x, -PADDLE_BOUNDS_X, PADDLE_BOUNDS_X), paddle_y)
   end
+  -- the engine draws the ball, interpolated
 end
 
 print("[Lua] pong script done loading.")
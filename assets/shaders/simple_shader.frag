@@ -1,11 +1,13 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+layout(binding = 1) uniform sampler2D textures[];
 
 layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) flat in uint fragTexSlot;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    outColor = texture(textures[nonuniformEXT(fragTexSlot)], fragTexCoord);
 }
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 // vertex attrs
 layout(location = 0) in vec2 xy;
@@ -7,6 +8,7 @@ layout(location = 0) in vec2 xy;
 layout(location = 1) in vec3 pos;
 layout(location = 2) in vec3 rot;
 layout(location = 3) in vec3 scale;
+// texture slot << 16 | region within that texture
 layout(location = 4) in uint texId;
 
 layout(binding = 0) uniform UBO1 {
@@ -16,7 +18,11 @@ layout(binding = 0) uniform UBO1 {
     vec2 user2;
 } ubo1;
 
+// bindless texture table; slots are filled in by Vulkan::CreateTexture()
+layout(binding = 1) uniform sampler2D textures[];
+
 layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) flat out uint fragTexSlot;
 
 // generate model matrix from position, rotation, and scale
 mat4 generateModelMatrix(vec3 position, vec3 rotation, vec3 scale) {
@@ -65,7 +71,8 @@ mat4 generateModelMatrix(vec3 position, vec3 rotation, vec3 scale) {
     return modelMatrix;
 }
 
-vec2 TEXTURE_WH = vec2(800,900);
+// size of the texture being sampled; set in main()
+vec2 TEXTURE_WH;
 float pixelsToUnitsX(uint pixels) {
     return pixels / TEXTURE_WH.x;
 }
@@ -82,21 +89,27 @@ void main() {
     mat4 model = generateModelMatrix(pos, rot, scale);
     gl_Position = ubo1.proj * ubo1.view * model * vec4(-xy.x, xy.y, 0.0, 1.0);
 
-    // hard-coded map of texId to uvwh coords in texture atlas
-    vec4 uvwh;
-    if (0 == texId) { // background 0x0 800x800
+    uint slot = texId >> 16;
+    uint region = texId & 0xFFFF;
+    fragTexSlot = slot;
+    TEXTURE_WH = vec2(textureSize(textures[nonuniformEXT(slot)], 0));
+
+    // hard-coded map of region to uvwh coords in texture atlas; other regions are the
+    // whole texture
+    vec4 uvwh = vec4(0.0, 0.0, 1.0, 1.0);
+    if (0 == region) { // background 0x0 800x800
         uvwh = vec4(pixelsToUnitsX(0),pixelsToUnitsY(0),pixelsToUnitsX(800),pixelsToUnitsY(800));
     }
-    else if (1 == texId) { // paddle 0x815 170x45
+    else if (1 == region) { // paddle 0x815 170x45
         uvwh = vec4(pixelsToUnitsX(0),pixelsToUnitsY(815),pixelsToUnitsX(170),pixelsToUnitsY(45));
     }
-    else if (2 == texId) { // ball 190x815 45x45
+    else if (2 == region) { // ball 190x815 45x45
         uvwh = vec4(pixelsToUnitsX(190),pixelsToUnitsY(815),pixelsToUnitsX(45),pixelsToUnitsY(45));
     }
 
     // pixel font glyphs 260x822 4x6
-    else if (texId > 31 && texId < 128) {
-        uint x = (texId - 32);
+    else if (region > 31 && region < 128) {
+        uint x = (region - 32);
         uint y = (x / 32) - 1;
         x = x % 32;
         uvwh = vec4(
@@ -18,10 +18,21 @@ const C_COMPILER_PATH = 'clang';
 const RX_EXT = /\.[\w\d]{1,3}$/i;
 const RX_C = /\.c$/i;
 const OUT_FILE = "compile_commands.json";
+// set MKS_LUAJIT=1 to script with LuaJIT (JIT + FFI) instead of Lua 5.4
+const USE_LUAJIT = process.env.MKS_LUAJIT === '1';
 const abs = (...args) => path.join(...args);
 const workspaceFolder = path.join(__dirname, '..');
 const rel = (...args) =>
   path.relative(path.join(workspaceFolder, BUILD_PATH), path.join(...args));
+// NOTICE: LuaJIT is not vendored; on Windows, build it (msvcbuild.bat) and copy it in first
+const LUAJIT_WIN_PATH = path.join(workspaceFolder, 'vendor', 'luajit-2.1');
+if (USE_LUAJIT && isWin && !cbFs.existsSync(LUAJIT_WIN_PATH)) {
+  console.error(
+    `MKS_LUAJIT=1 on Windows needs LuaJIT 2.1 in ${LUAJIT_WIN_PATH}, and it isn't there.\n` +
+    `Expected: include\\ (lua.h, lauxlib.h, lualib.h, luajit.h), x64\\lua51.lib, x64\\lua51.dll.\n` +
+    `See README.md, "LuaJIT"; or unset MKS_LUAJIT to use the vendored Lua 5.4.`);
+  process.exit(1);
+}
 const DEBUG_COMPILER_ARGS = [
   '-O0',
   '-gdwarf', // adds gdb support
@@ -34,18 +45,31 @@ const CPP_COMPILER_ARGS = [
 const COMPILER_ARGS = [];
 COMPILER_ARGS.push('-Wdeprecated-declarations'); // having to use deprecated things for linux cross-platform compatibility
 COMPILER_ARGS.push('-m64');
+if (USE_LUAJIT) {
+  COMPILER_ARGS.push('-DMKS_LUAJIT=1');
+}
 if (isWin) {
   COMPILER_ARGS.push(`-I${abs('C:', 'VulkanSDK', '1.3.236.0', 'Include')}`);
   COMPILER_ARGS.push(`-I${rel(workspaceFolder, 'vendor', 'sdl-2.26.1', 'include')}`);
-  COMPILER_ARGS.push(`-I${rel(workspaceFolder, 'vendor', 'lua-5.4.2', 'include')}`);
+  if (USE_LUAJIT) {
+    COMPILER_ARGS.push(`-I${rel(workspaceFolder, 'vendor', 'luajit-2.1', 'include')}`);
+  } else {
+    COMPILER_ARGS.push(`-I${rel(workspaceFolder, 'vendor', 'lua-5.4.2', 'include')}`);
+  }
 }
 else if (isNix) {
   COMPILER_ARGS.push(`-I/${abs('usr', 'include', 'vulkan')}`);
-  COMPILER_ARGS.push(`-I/${abs('usr', 'include', 'lua5.4')}`);
+  // apt install libluajit-5.1-dev
+  COMPILER_ARGS.push(`-I/${abs('usr', 'include', USE_LUAJIT ? 'luajit-2.1' : 'lua5.4')}`);
 }
 else if (isMac) {
   COMPILER_ARGS.push(`-I/${abs('opt', 'homebrew', 'Cellar', 'sdl2', '2.30.0', 'include')}`);
-  COMPILER_ARGS.push(`-I/${abs('opt', 'homebrew', 'Cellar', 'lua', '5.4.6', 'include', 'lua5.4')}`);
+  if (USE_LUAJIT) {
+    // brew install luajit
+    COMPILER_ARGS.push(`-I/${abs('opt', 'homebrew', 'opt', 'luajit', 'include', 'luajit-2.1')}`);
+  } else {
+    COMPILER_ARGS.push(`-I/${abs('opt', 'homebrew', 'Cellar', 'lua', '5.4.6', 'include', 'lua5.4')}`);
+  }
 }
 COMPILER_ARGS.push(`-I${rel(workspaceFolder, 'vendor', 'glm-0.9.9.8')}`);
 COMPILER_ARGS.push(`-I${rel(workspaceFolder, 'vendor', 'tinyobjloader', 'include')}`);
@@ -59,6 +83,7 @@ if (isWin) {
   LINKER_LIBS.push('-l', 'gdi32');
 }
 else if (isNix) {
+  LINKER_LIBS.push('-pthread'); // std::thread (Jobs)
 }
 else if (isMac) {
 }
@@ -68,19 +93,27 @@ if (isWin) {
   LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'sdl-2.26.1', 'lib', 'x64')}`, '-l', 'SDL2');
   LINKER_LIB_PATHS.push('-L', `${abs('C:', 'VulkanSDK', '1.3.236.0', 'Lib')}`, '-l', 'vulkan-1');
   LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'protobuf-25.2', 'win', 'x64')}`, '-l', 'libprotobuf-lite');
-  LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'lua-5.4.2', 'x64')}`, '-l', 'lua54');
+  if (USE_LUAJIT) {
+    LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'luajit-2.1', 'x64')}`, '-l', 'lua51');
+  } else {
+    LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'lua-5.4.2', 'x64')}`, '-l', 'lua54');
+  }
 }
 else if (isNix) {
   LINKER_LIB_PATHS.push('-D_REENTRANT', '-lSDL2');
   LINKER_LIB_PATHS.push('-lvulkan');
   LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'protobuf-25.2', 'nix', 'lib')}`, '-l', 'protobuf-lite');
-  LINKER_LIB_PATHS.push('-llua5.4');
+  LINKER_LIB_PATHS.push(USE_LUAJIT ? '-lluajit-5.1' : '-llua5.4');
 }
 else if (isMac) {
   LINKER_LIB_PATHS.push(`-L/${abs('opt', 'homebrew', 'Cellar', 'sdl2', '2.30.0', 'lib')}`, '-D_REENTRANT', '-lSDL2');
   LINKER_LIB_PATHS.push('-lvulkan');
   LINKER_LIB_PATHS.push('-L', `${rel(workspaceFolder, 'vendor', 'protobuf-25.2', 'mac', 'lib')}`, '-l', 'protobuf-lite');
-  LINKER_LIB_PATHS.push(`-L/${abs('opt', 'homebrew', 'Cellar', 'lua', '5.4.6', 'lib')}`, '-llua5.4');
+  if (USE_LUAJIT) {
+    LINKER_LIB_PATHS.push(`-L/${abs('opt', 'homebrew', 'opt', 'luajit', 'lib')}`, '-lluajit-5.1');
+  } else {
+    LINKER_LIB_PATHS.push(`-L/${abs('opt', 'homebrew', 'Cellar', 'lua', '5.4.6', 'lib')}`, '-llua5.4');
+  }
 }
 const COMPILER_TRANSLATION_UNITS = [
   rel(workspaceFolder, 'src', 'components', '*.cpp'),
@@ -179,7 +212,11 @@ const copy_dlls = async () => {
   if (isWin) {
     srcs.push(path.join(workspaceFolder, 'vendor', 'sdl-2.26.1', 'lib', 'x64', 'SDL2.dll'));
     srcs.push(path.join(workspaceFolder, 'vendor', 'protobuf-25.2', 'win', 'x64', 'libprotobuf-lite.dll'));
-    srcs.push(path.join(workspaceFolder, 'vendor', 'lua-5.4.2', 'x64', 'lua54.dll'));
+    if (USE_LUAJIT) {
+      srcs.push(path.join(workspaceFolder, 'vendor', 'luajit-2.1', 'x64', 'lua51.dll'));
+    } else {
+      srcs.push(path.join(workspaceFolder, 'vendor', 'lua-5.4.2', 'x64', 'lua54.dll'));
+    }
   }
   const dest = path.join(workspaceFolder, BUILD_PATH);
   for (const src of srcs) {
@@ -335,11 +372,20 @@ const compile_test = async (basename) => {
       case 'compile_commands':
         await generate_clangd_compile_commands();
         break;
+      case 'Assets_test':
       case 'Audio_test':
+      case 'Broadphase_test':
+      case 'Ecs_test':
+      case 'FramePacer_test':
       case 'Gamepad_test':
+      case 'InstanceStress_test':
+      case 'Jobs_test':
+      case 'LuaBridge_test':
       case 'Lua_test':
+      case 'Physics2D_test':
       case 'Pong_test':
       case 'Protobuf_test':
+      case 'Scheduler_test':
       case 'Window_test':
         await compile_test(cmd);
         break;
@@ -351,6 +397,10 @@ Mike's hand-rolled build system.
 USAGE:
   node build_scripts\\Makefile.mjs <SUBCOMMAND>
 
+ENVIRONMENT:
+  MKS_LUAJIT=1
+    Script with LuaJIT (JIT + FFI) instead of Lua 5.4.
+
 SUBCOMMANDS:
   all
     Clean, rebuild, and launch the default app.
@@ -364,16 +414,34 @@ SUBCOMMANDS:
     Compile protobuf .cc code and .bin data files.
   compile_commands
     Generate the .json file needed for clangd for vscode extension.
+  Assets_test
+    Stream textures, audio and shaders; compare loading-screen stalls vs. blocking loads.
   Audio_test
     Test SDL audio integration.
+  Broadphase_test
+    Compare spatial hash vs. sweep and prune on 1k to 100k moving boxes.
+  Ecs_test
+    Benchmark ECS iteration and add/remove churn against per-object pointers.
+  FramePacer_test
+    Test frame pacing accuracy, headless and under load.
   Gamepad_test
     Test SDL gamepad integration.
+  InstanceStress_test
+    Stress test 1M instanced quads; reports frame time.
+  Jobs_test
+    Check job dependencies, ParallelFor and coroutines; scale from 1 to N threads.
+  LuaBridge_test
+    Benchmark Lua instance writes, and per-tick script cost at scale.
   Lua_test
     Test Lua sandbox integration.
+  Physics2D_test
+    Test native contact events; benchmark 1k to 100k bodies.
   Pong_test
     Test everything (game demo).
   Protobuf_test
     Test Google Protobuf data read/write.
+  Scheduler_test
+    Check system ordering under concurrency; time systems serially vs. scheduled.
   Window_test
     Test SDL window integration.
 `);
@@ -1,19 +1,22 @@
 #include "Behavior.hpp"
 
+#include "../lib/Ecs.hpp"
 #include "../lib/Logger.hpp"
 
 namespace mks {
 
-Behavior::Behavior() {
-  mks::Logger::Infof("New Behavior");
+Behavior::Behavior(Registry* registry, Entity entity) : entity(entity), registry(registry) {
 }
 
 Behavior::~Behavior() {
-  mks::Logger::Infof("Behavior deleted");
+}
+
+bool Behavior::IsAlive() const {
+  return registry->IsAlive(entity);
 }
 
 void Behavior::BindScript(void* cls) {
   mks::Logger::Infof("Behavior.BindScript()");
 }
 
-}  // namespace mks
\ No newline at end of file
+}  // namespace mks
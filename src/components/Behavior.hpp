@@ -1,25 +1,52 @@
 #pragma once
 
+#include "../lib/Ecs.hpp"
+#include "Components.hpp"
+
 namespace mks {
 
+/**
+ * Lightweight handle to one entity and its components; cheap to copy, nothing to free.
+ * Components live in the Registry (see Components.hpp), not in the Behavior.
+ */
 class Behavior {
  public:
-  Behavior();
+  Behavior(Registry* registry, Entity entity);
   ~Behavior();
 
-  // attachments
-  void* Animation;
-  void* Audio;
-  void* Camera;
-  void* Collider2D;
-  void* Light;
-  void* Renderer;
-  void* RigidBody2D;
-  void* Transform;
-  void* Scripts;
+  /**
+   * @return - nullptr if the entity was destroyed; nothing is added.
+   */
+  template <typename T>
+  T* Add(const T& component = {}) {
+    return registry->Add<T>(entity, component);
+  }
+
+  /**
+   * @return - nullptr if the entity was destroyed, or has no T.
+   */
+  template <typename T>
+  T* Get() {
+    return registry->Get<T>(entity);
+  }
+
+  template <typename T>
+  bool Has() {
+    return registry->Has<T>(entity);
+  }
+
+  template <typename T>
+  void Remove() {
+    registry->Remove<T>(entity);
+  }
+
+  bool IsAlive() const;
   void BindScript(void*);
 
+  Entity entity;
+
  private:
+  Registry* registry;
 };
 
-}  // namespace mks
\ No newline at end of file
+}  // namespace mks
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../lib/Base.hpp"
+
+namespace mks {
+
+// plain data; stored contiguously per type by the Registry, and operated on by the
+// Engine's systems (Update, Draw)
+
+struct Transform {
+  f32 x = 0;
+  f32 y = 0;
+  f32 rotation = 0;
+  f32 scaleX = 1;
+  f32 scaleY = 1;
+};
+
+struct RigidBody2D {
+  f32 vx = 0;
+  f32 vy = 0;
+};
+
+struct Collider2D {
+  f32 halfW = 0;
+  f32 halfH = 0;
+};
+
+struct Renderer {
+  u32 texId = 0;
+};
+
+}  // namespace mks
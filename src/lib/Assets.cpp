@@ -0,0 +1,268 @@
+#include "Assets.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Audio.hpp"
+#include "Base.hpp"
+#include "Jobs.hpp"
+#include "Logger.hpp"
+#include "Lua.hpp"
+#include "Shader.hpp"
+#include "Vulkan.hpp"
+
+namespace {
+
+const char* STATE_NAMES[] = {"loading", "ready", "failed"};
+
+// bound with the Assets as upvalue 1; see mks::UpvalueSelf()
+
+int AssetsLoadTexture(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Assets>(L);
+  const char* path = luaL_checkstring(L, 1);
+  if (!self->uploadTexture) {
+    luaL_error(L, "LoadTexture: textures can't be uploaded here");
+  }
+  lua_pushinteger(L, self->LoadTexture(path)->id);
+  return 1;
+}
+
+int AssetsLoadAudioFile(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Assets>(L);
+  const char* path = luaL_checkstring(L, 1);
+  if (!self->addAudio) {
+    luaL_error(L, "LoadAudioFile: audio can't be played here");
+  }
+  lua_pushinteger(L, self->LoadAudioFile(path)->id);
+  return 1;
+}
+
+int AssetsLoadShader(lua_State* L) {
+  const char* path = luaL_checkstring(L, 1);
+  lua_pushinteger(L, mks::UpvalueSelf<mks::Assets>(L)->LoadShader(path)->id);
+  return 1;
+}
+
+int AssetsStatus(lua_State* L) {
+  const lua_Integer id = luaL_checkinteger(L, 1);
+  auto self = mks::UpvalueSelf<mks::Assets>(L);
+  mks::Asset* asset = id >= 0 ? self->Get(static_cast<u32>(id)).get() : nullptr;
+  if (!asset) {
+    luaL_error(L, "no such asset: %d", (int)id);
+  }
+  // the assets list keeps it alive
+  const auto state = asset->state.load();
+  lua_pushstring(L, STATE_NAMES[static_cast<u8>(state)]);
+  if (mks::Asset::State::READY == state) {
+    lua_pushinteger(L, asset->value);
+  } else if (mks::Asset::State::FAILED == state) {
+    lua_pushstring(L, asset->error.c_str());
+  } else {
+    lua_pushnil(L);
+  }
+  return 2;
+}
+
+int AssetsProgress(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Assets>(L);
+  lua_pushinteger(L, self->Finished());
+  lua_pushinteger(L, self->Count());
+  return 2;
+}
+
+}  // namespace
+
+namespace mks {
+
+void Assets::MainThreadAwaiter::await_suspend(std::coroutine_handle<> coroutine) {
+  std::lock_guard<std::mutex> lock(assets->mainMutex);
+  assets->mainQueue.push_back(coroutine);
+}
+
+Assets::Assets(Jobs& jobs) : jobs(jobs) {
+}
+
+Assets::~Assets() {
+  // loads in flight still refer to this
+  WaitAll();
+}
+
+void Assets::WaitAll() {
+  for (u32 id = 0; id < Count(); id++) {
+    Wait(Get(id));
+  }
+}
+
+AssetHandle Assets::Find(
+    Asset::Type type, const std::string& path, Jobs::Task (Assets::*task)(AssetHandle)) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const std::string key = std::to_string(static_cast<u8>(type)) + ":" + path;
+  auto it = byPath.find(key);
+  if (it != byPath.end()) {
+    return assets[it->second];
+  }
+  auto asset = std::make_shared<Asset>();
+  asset->type = type;
+  asset->path = path;
+  asset->id = assets.size();
+  // Spawn() only queues the task; it can't run (or re-enter this lock) yet
+  asset->done = jobs.Spawn((this->*task)(asset));
+  byPath[key] = asset->id;
+  assets.push_back(asset);
+  return asset;
+}
+
+AssetHandle Assets::LoadTexture(const std::string& path) {
+  if (!uploadTexture) {
+    throw Logger::Errorf("LoadTexture: no uploadTexture set; can't load %s", path.c_str());
+  }
+  return Find(Asset::Type::TEXTURE, path, &Assets::TextureTask);
+}
+
+AssetHandle Assets::LoadAudioFile(const std::string& path) {
+  if (!addAudio) {
+    throw Logger::Errorf("LoadAudioFile: no addAudio set; can't load %s", path.c_str());
+  }
+  return Find(Asset::Type::AUDIO, path, &Assets::AudioTask);
+}
+
+AssetHandle Assets::LoadShader(const std::string& path) {
+  return Find(Asset::Type::SHADER, path, &Assets::ShaderTask);
+}
+
+// NOTICE: each task starts as a job, so its first step (up to the first co_await) runs on
+// a worker. Errors are recorded on the asset, then rethrown to complete its done handle.
+
+Jobs::Task Assets::TextureTask(AssetHandle asset) {
+  Vulkan::DecodedImage image{};
+  try {
+    image = Vulkan::DecodeImage(asset->path.c_str());
+    co_await MainThread();
+    asset->value = uploadTexture(image);
+  } catch (const std::exception& e) {
+    Vulkan::FreeImage(image);
+    Fail(asset, e.what());
+    throw;
+  }
+  Vulkan::FreeImage(image);
+  Ready(asset);
+}
+
+Jobs::Task Assets::AudioTask(AssetHandle asset) {
+  cm_Source* source = nullptr;
+  try {
+    source = Audio::decodeAudioFile(asset->path.c_str());
+    co_await MainThread();
+    asset->value = addAudio(source, asset->path);
+  } catch (const std::exception& e) {
+    // never handed over
+    if (source) {
+      cm_destroy_source(source);
+    }
+    Fail(asset, e.what());
+    throw;
+  }
+  Ready(asset);
+}
+
+Jobs::Task Assets::ShaderTask(AssetHandle asset) {
+  try {
+    const Shader s{};
+    asset->bytes = s.readFile(asset->path);
+  } catch (const std::exception& e) {
+    Fail(asset, e.what());
+    throw;
+  }
+  Ready(asset);
+  co_return;
+}
+
+// NOTICE: setting state must be the last use of this; ~Assets() may return as soon as
+// no asset is LOADING.
+
+void Assets::Ready(const AssetHandle& asset) {
+  finished++;
+  // release; value and bytes are visible to whoever sees READY
+  asset->state = Asset::State::READY;
+}
+
+void Assets::Fail(const AssetHandle& asset, const char* error) {
+  Logger::Infof("asset failed: %.100s: %.120s", asset->path.c_str(), error);
+  asset->error = error;
+  finished++;
+  asset->state = Asset::State::FAILED;
+}
+
+AssetHandle Assets::Get(u32 id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return id < assets.size() ? assets[id] : nullptr;
+}
+
+u32 Assets::Count() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return assets.size();
+}
+
+u32 Assets::Finished() const {
+  return finished;
+}
+
+Assets::MainThreadAwaiter Assets::MainThread() {
+  return MainThreadAwaiter{this};
+}
+
+void Assets::Update(f64 budgetMs) {
+  const auto begin = std::chrono::high_resolution_clock::now();
+  while (true) {
+    std::coroutine_handle<> coroutine;
+    {
+      std::lock_guard<std::mutex> lock(mainMutex);
+      if (mainQueue.empty()) {
+        return;
+      }
+      coroutine = mainQueue.front();
+      mainQueue.pop_front();
+    }
+    coroutine.resume();
+    if (std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - begin)
+            .count() >= budgetMs) {
+      return;
+    }
+  }
+}
+
+bool Assets::Wait(const AssetHandle& asset) {
+  if (!asset) {
+    return false;
+  }
+  while (Asset::State::LOADING == asset->state) {
+    Update();
+    if (!jobs.RunOne()) {
+      std::this_thread::yield();
+    }
+  }
+  return Asset::State::READY == asset->state;
+}
+
+void Assets::Bind(lua_State* L) {
+  const luaL_Reg functions[] = {
+      {"LoadTexture", AssetsLoadTexture},
+      {"LoadAudioFile", AssetsLoadAudioFile},
+      {"LoadShader", AssetsLoadShader},
+      {"AssetStatus", AssetsStatus},
+      {"LoadingProgress", AssetsProgress},
+  };
+  for (const auto& fn : functions) {
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, fn.func, 1);
+    lua_setglobal(L, fn.name);
+  }
+}
+
+}  // namespace mks
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Audio.hpp"
+#include "Base.hpp"
+#include "Jobs.hpp"
+#include "Lua.hpp"
+#include "Vulkan.hpp"
+
+namespace mks {
+
+/**
+ * One file being loaded, or loaded. Shared by everyone who asked for it.
+ */
+struct Asset {
+  enum class Type : u8 {
+    TEXTURE = 0,
+    AUDIO = 1,
+    SHADER = 2,
+  };
+  enum class State : u8 {
+    LOADING = 0,
+    READY = 1,
+    FAILED = 2,
+  };
+
+  Type type;
+  std::string path;
+  // id to pass to Lua, and to Assets::Get()
+  u32 id = 0;
+  // the others are only meaningful once this is READY (or FAILED, for error)
+  std::atomic<State> state = State::LOADING;
+  // TEXTURE: whatever Assets::uploadTexture returned; AUDIO: Audio::playAudio() index
+  u32 value = 0;
+  // SHADER: the file's contents
+  std::vector<char> bytes = {};
+  std::string error = {};
+  // completes once READY or FAILED; failed loads complete with their exception
+  JobHandle done = nullptr;
+};
+
+typedef std::shared_ptr<Asset> AssetHandle;
+
+/**
+ * co_await asset; within a Jobs::Task. Rethrows the load's exception, if it failed.
+ */
+inline JobAwaiter operator co_await(const AssetHandle& asset) {
+  return JobAwaiter{asset->done};
+}
+
+/**
+ * Loads textures, audio and shaders without blocking the thread asking for them.
+ *
+ * Each load is a Jobs::Task coroutine: file reads and decoding run on a Jobs worker,
+ * then the load hops to the main thread (co_await MainThread()) for whatever must happen
+ * there, ie. the GPU upload. Main-thread steps run in Update(), called once per frame
+ * with a time budget, so a loading screen keeps animating while hundreds of assets
+ * stream in. Loading the same file twice returns the same asset.
+ *
+ *   Jobs::Task Level(Assets& assets) {
+ *     auto atlas = assets.LoadTexture("atlas.png");
+ *     auto music = assets.LoadAudioFile("music.wav");
+ *     co_await atlas;  // decoded, and uploaded by uploadTexture
+ *     co_await music;
+ *   }
+ *
+ * From Lua, after Bind(); each Load* returns a handle right away:
+ *   local h = LoadTexture(path)           -- also LoadAudioFile(path), LoadShader(path)
+ *   local state, value = AssetStatus(h)   -- "loading" | "ready" | "failed", value or error
+ *   local done, total = LoadingProgress()
+ *
+ * Load*() and Get() may be called from any thread.
+ */
+class Assets {
+ public:
+  // resumes the awaiting coroutine within the next Update()
+  struct MainThreadAwaiter {
+    Assets* assets;
+
+    bool await_ready() const {
+      return false;
+    }
+    void await_suspend(std::coroutine_handle<> coroutine);
+    void await_resume() const {
+    }
+  };
+
+  explicit Assets(Jobs& jobs);
+  ~Assets();
+
+  AssetHandle LoadTexture(const std::string& path);
+  AssetHandle LoadAudioFile(const std::string& path);
+  AssetHandle LoadShader(const std::string& path);
+
+  /**
+   * @return - nullptr if there's no such asset.
+   */
+  AssetHandle Get(u32 id);
+  u32 Count();
+  /**
+   * Assets no longer LOADING.
+   */
+  u32 Finished() const;
+
+  /**
+   * co_await assets.MainThread(); to continue on the thread calling Update().
+   */
+  MainThreadAwaiter MainThread();
+
+  /**
+   * Run main-thread steps of pending loads, until none are left or budgetMs has passed.
+   * Main thread only.
+   */
+  void Update(f64 budgetMs = 2);
+
+  /**
+   * Run Update() (and jobs) until asset is no longer LOADING. Main thread only.
+   *
+   * @return - false if it FAILED.
+   */
+  bool Wait(const AssetHandle& asset);
+  /**
+   * Wait() for every asset. Main thread only; call before shutting down whatever
+   * uploadTexture and addAudio feed, since pending loads still call them.
+   */
+  void WaitAll();
+
+  /**
+   * Expose LoadTexture, LoadAudioFile, LoadShader, AssetStatus, LoadingProgress to Lua.
+   */
+  void Bind(lua_State* L);
+
+  /**
+   * Main thread. Upload a decoded texture; the return value becomes the asset's value.
+   * Required for LoadTexture().
+   */
+  std::function<u32(const Vulkan::DecodedImage& image)> uploadTexture = nullptr;
+  /**
+   * Main thread. Register a decoded source, taking ownership of it; the return value becomes
+   * the asset's value. If it throws, the source is destroyed. Required for LoadAudioFile().
+   */
+  std::function<u32(cm_Source* source, const std::string& path)> addAudio = nullptr;
+
+ private:
+  /**
+   * The asset for path, or a new one, whose load (task) is spawned before any other
+   * thread can see it.
+   */
+  AssetHandle Find(
+      Asset::Type type, const std::string& path, Jobs::Task (Assets::*task)(AssetHandle));
+  void Ready(const AssetHandle& asset);
+  void Fail(const AssetHandle& asset, const char* error);
+
+  Jobs::Task TextureTask(AssetHandle asset);
+  Jobs::Task AudioTask(AssetHandle asset);
+  Jobs::Task ShaderTask(AssetHandle asset);
+
+  Jobs& jobs;
+
+  std::mutex mutex;
+  // by id
+  std::vector<AssetHandle> assets = {};
+  // type and path -> id
+  std::unordered_map<std::string, u32> byPath = {};
+  std::atomic<u32> finished = 0;
+
+  std::mutex mainMutex;
+  std::deque<std::coroutine_handle<>> mainQueue = {};
+};
+
+}  // namespace mks
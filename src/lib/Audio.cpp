@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <mutex>
+
 #include "Logger.hpp"
 #include "cmixer.h"
 
@@ -66,6 +68,7 @@ void Audio::init() {
 }
 
 void Audio::shutdown() {
+  std::lock_guard<std::mutex> lock(sourcesMutex);
   for (const auto& src : audioSources) {
     cm_destroy_source(src);
   }
@@ -73,15 +76,26 @@ void Audio::shutdown() {
 }
 
 void Audio::loadAudioFile(const char* path) {
+  addAudioSource(decodeAudioFile(path), path);
+}
+
+cm_Source* Audio::decodeAudioFile(const char* path) {
   cm_Source* src = cm_new_source_from_file(path);
   if (!src) {
     throw mks::Logger::Errorf("Error: failed to load audio file '%s'\n", cm_get_error());
   }
+  return src;
+}
+
+unsigned int Audio::addAudioSource(cm_Source* src, const char* path) {
+  std::lock_guard<std::mutex> lock(sourcesMutex);
   audioSources.push_back(src);
   mks::Logger::Infof("Audio file loaded. idx: %u, path: %s", audioSources.size() - 1, path);
+  return audioSources.size() - 1;
 }
 
 void Audio::playAudio(const int id, const bool loop, const double gain) const {
+  std::lock_guard<std::mutex> lock(sourcesMutex);
   if (cm_get_state(audioSources[id]) == CM_STATE_PLAYING) {
     cm_stop(audioSources[id]);
   }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include <vector>
 
 extern "C" {
@@ -20,11 +21,24 @@ class Audio {
 
   void init();
   void loadAudioFile(const char* path);
+  /**
+   * Decode a file into a new source, without registering it.
+   * Safe to call from worker threads (ie. to decode many files in parallel).
+   */
+  static cm_Source* decodeAudioFile(const char* path);
+  /**
+   * Register a decoded source. May be called while another thread calls playAudio().
+   *
+   * @return - Index to pass to playAudio().
+   */
+  unsigned int addAudioSource(cm_Source* src, const char* path);
   void playAudio(const int id, const bool loop, const double gain) const;
   void shutdown();
 
  private:
   unsigned int dev;
+  // sources may be registered (ie. as they finish loading) while others play
+  mutable std::mutex sourcesMutex;
   std::vector<cm_Source*> audioSources;
 };
 
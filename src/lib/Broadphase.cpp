@@ -0,0 +1,280 @@
+#include "Broadphase.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Base.hpp"
+
+namespace {
+
+const u32 MIN_BUCKETS = 64;
+
+u64 PairKey(u32 a, u32 b) {
+  return a < b ? (static_cast<u64>(a) << 32) | b : (static_cast<u64>(b) << 32) | a;
+}
+
+// outermost cell index; exact as an f32, and well within s32
+const s32 CELL_LIMIT = 1 << 30;
+
+// floor(), without the libm call; clamped first, since casting a float outside of s32
+// (or NaN) is undefined. Far cells share the outermost, which only costs precision.
+s32 CellOf(f32 v, f32 inverseCellSize) {
+  const f32 scaled = v * inverseCellSize;
+  if (!(scaled > -CELL_LIMIT)) {
+    // NaN too
+    return -CELL_LIMIT;
+  }
+  if (scaled >= CELL_LIMIT) {
+    return CELL_LIMIT;
+  }
+  const s32 truncated = static_cast<s32>(scaled);
+  return truncated - (scaled < truncated);
+}
+
+// by position; at the same position, min edges first, so touching boxes overlap
+template <typename E>
+bool EndpointLess(const E& a, const E& b) {
+  return a.value < b.value || (a.value == b.value && (a.proxyEdge & 1) < (b.proxyEdge & 1));
+}
+
+}  // namespace
+
+namespace mks {
+
+Broadphase::Broadphase() {
+}
+
+Broadphase::~Broadphase() {
+}
+
+void Broadphase::SetMode(Mode mode, f32 cellSize) {
+  this->mode = mode;
+  // drop the other structure entirely; it would go stale
+  cells.clear();
+  bucketStart.clear();
+  buckets.clear();
+  endpoints.clear();
+  if (Mode::SPATIAL_HASH == mode) {
+    this->cellSize = cellSize;
+    inverseCellSize = 1 / cellSize;
+    cells.resize(Count());
+    for (u32 p = 0; p < Count(); p++) {
+      cells[p] = CellsOf(p);
+    }
+    rebucket = true;
+  } else {
+    for (u32 p = 0; p < Count(); p++) {
+      if (IsCollider(p)) {
+        endpoints.push_back({0, p << 1});
+        endpoints.push_back({0, p << 1 | 1});
+      }
+    }
+    unsorted = true;
+  }
+}
+
+Broadphase::Mode Broadphase::GetMode() const {
+  return mode;
+}
+
+u32 Broadphase::Add(f32 x, f32 y, f32 halfW, f32 halfH) {
+  const u32 id = Count();
+  bounds.push_back({x - halfW, y - halfH, x + halfW, y + halfH});
+  this->halfW.push_back(halfW);
+  this->halfH.push_back(halfH);
+  if (Mode::SPATIAL_HASH == mode) {
+    cells.push_back(CellsOf(id));
+    rebucket = true;
+  } else if (IsCollider(id)) {
+    // appended out of order; FindPairs() sorts everything once
+    endpoints.push_back({0, id << 1});
+    endpoints.push_back({0, id << 1 | 1});
+    unsorted = true;
+  }
+  return id;
+}
+
+u32 Broadphase::Count() const {
+  return bounds.size();
+}
+
+void Broadphase::Move(u32 proxy, f32 x, f32 y) {
+  bounds[proxy] = {x - halfW[proxy], y - halfH[proxy], x + halfW[proxy], y + halfH[proxy]};
+  moved = true;
+  if (Mode::SPATIAL_HASH != mode || !IsCollider(proxy)) {
+    return;
+  }
+  const CellRange moved = CellsOf(proxy);
+  if (moved == cells[proxy]) {
+    // the common case for slow movers: still within the same cells
+    return;
+  }
+  cells[proxy] = moved;
+  rebucket = true;
+}
+
+void Broadphase::MoveAll(const void* positions, u32 stride) {
+  auto position = static_cast<const u8*>(positions);
+  for (u32 p = 0; p < Count(); p++, position += stride) {
+    f32 xy[2];
+    memcpy(xy, position, sizeof(xy));
+    Move(p, xy[0], xy[1]);
+  }
+}
+
+void Broadphase::FindPairs(std::vector<u64>& pairs) {
+  pairs.clear();
+  if (Mode::SPATIAL_HASH == mode) {
+    FindHashPairs(pairs);
+  } else {
+    FindSweepPairs(pairs);
+  }
+}
+
+bool Broadphase::IsCollider(u32 proxy) const {
+  return 0 != halfW[proxy] && 0 != halfH[proxy];
+}
+
+Broadphase::CellRange Broadphase::CellsOf(u32 proxy) const {
+  const auto& b = bounds[proxy];
+  return {
+      CellOf(b.minX, inverseCellSize),
+      CellOf(b.minY, inverseCellSize),
+      CellOf(b.maxX, inverseCellSize),
+      CellOf(b.maxY, inverseCellSize)};
+}
+
+u32 Broadphase::Bucket(s32 cx, s32 cy) const {
+  // large primes; spreads neighboring cells across the table
+  u32 h = static_cast<u32>(cx) * 73856093u ^ static_cast<u32>(cy) * 19349663u;
+  h ^= h >> 16;
+  return h & (bucketStart.size() - 2);
+}
+
+void Broadphase::Rebucket() {
+  u32 size = MIN_BUCKETS;
+  while (size < Count()) {
+    size *= 2;
+  }
+  // counting sort of proxies into every bucket they touch; one flat array, so the
+  // pair scan streams through memory, rather than chasing a list per bucket
+  bucketStart.assign(size + 1, 0);
+  u32 total = 0;
+  for (u32 p = 0; p < Count(); p++) {
+    if (!IsCollider(p)) {
+      continue;
+    }
+    const auto& c = cells[p];
+    for (s32 cy = c.y0; cy <= c.y1; cy++) {
+      for (s32 cx = c.x0; cx <= c.x1; cx++) {
+        bucketStart[Bucket(cx, cy)]++;
+        total++;
+      }
+    }
+  }
+  for (u32 b = 1; b < bucketStart.size(); b++) {
+    bucketStart[b] += bucketStart[b - 1];
+  }
+  // filled back to front, which leaves bucketStart[b] at the start of bucket b
+  buckets.resize(total);
+  for (u32 p = 0; p < Count(); p++) {
+    if (!IsCollider(p)) {
+      continue;
+    }
+    const auto& c = cells[p];
+    for (s32 cy = c.y0; cy <= c.y1; cy++) {
+      for (s32 cx = c.x0; cx <= c.x1; cx++) {
+        buckets[--bucketStart[Bucket(cx, cy)]] = {bounds[p], p};
+      }
+    }
+  }
+  rebucket = false;
+  moved = false;
+}
+
+void Broadphase::FindHashPairs(std::vector<u64>& pairs) {
+  if (rebucket) {
+    Rebucket();
+  } else if (moved) {
+    // same buckets, new bounds
+    for (auto& entry : buckets) {
+      entry.bounds = bounds[entry.proxy];
+    }
+    moved = false;
+  }
+  for (u32 b = 0; b + 1 < bucketStart.size(); b++) {
+    const u32 end = bucketStart[b + 1];
+    for (u32 i = bucketStart[b]; i < end; i++) {
+      const auto& p = buckets[i];
+      for (u32 j = i + 1; j < end; j++) {
+        const auto& q = buckets[j];
+        if (p.proxy == q.proxy || p.bounds.minX > q.bounds.maxX || q.bounds.minX > p.bounds.maxX ||
+            p.bounds.minY > q.bounds.maxY || q.bounds.minY > p.bounds.maxY) {
+          continue;
+        }
+        // a pair sharing several cells is only reported by the bucket holding the
+        // min corner of their intersection
+        const s32 cx = CellOf(Max(p.bounds.minX, q.bounds.minX), inverseCellSize);
+        const s32 cy = CellOf(Max(p.bounds.minY, q.bounds.minY), inverseCellSize);
+        if (Bucket(cx, cy) == b) {
+          pairs.push_back(PairKey(p.proxy, q.proxy));
+        }
+      }
+    }
+  }
+  // distinct cells can share a bucket, and so list the same two proxies twice
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
+
+f32 Broadphase::EdgeValue(u32 proxyEdge) const {
+  const auto& b = bounds[proxyEdge >> 1];
+  return proxyEdge & 1 ? b.maxX : b.minX;
+}
+
+void Broadphase::FindSweepPairs(std::vector<u64>& pairs) {
+  for (auto& e : endpoints) {
+    e.value = EdgeValue(e.proxyEdge);
+  }
+  if (unsorted) {
+    std::sort(endpoints.begin(), endpoints.end(), EndpointLess<Endpoint>);
+    unsorted = false;
+  } else {
+    // insertion sort; after small moves each endpoint only shifts a few places
+    for (u32 i = 1; i < endpoints.size(); i++) {
+      const Endpoint e = endpoints[i];
+      u32 j = i;
+      for (; j > 0 && EndpointLess(e, endpoints[j - 1]); j--) {
+        endpoints[j] = endpoints[j - 1];
+      }
+      endpoints[j] = e;
+    }
+  }
+
+  // every proxy whose interval is open when another opens overlaps it along x
+  open.clear();
+  openSlot.resize(Count());
+  for (const auto& e : endpoints) {
+    const u32 p = e.proxyEdge >> 1;
+    if (e.proxyEdge & 1) {
+      const u32 slot = openSlot[p];
+      open[slot] = open.back();
+      openSlot[open[slot].proxy] = slot;
+      open.pop_back();
+      continue;
+    }
+    const f32 minY = bounds[p].minY;
+    const f32 maxY = bounds[p].maxY;
+    for (const auto& q : open) {
+      if (minY <= q.maxY && q.minY <= maxY) {
+        pairs.push_back(PairKey(p, q.proxy));
+      }
+    }
+    openSlot[p] = open.size();
+    open.push_back({minY, maxY, p});
+  }
+  std::sort(pairs.begin(), pairs.end());
+}
+
+}  // namespace mks
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * Finds the pairs of axis-aligned boxes which overlap, without testing all N^2 of them.
+ *
+ * Boxes (proxies) keep their size; only their centers move. Both structures are kept
+ * up to date incrementally as proxies move, so a frame where little moved is cheap:
+ *
+ *   SPATIAL_HASH     - Uniform grid of cellSize, hashed into buckets, so the world
+ *                      is unbounded. Buckets are only rebuilt when some proxy moved
+ *                      into a different range of cells. Best for many similar-sized boxes.
+ *   SWEEP_AND_PRUNE  - Box edges sorted along x. Order barely changes between
+ *                      frames, so an insertion sort keeps it sorted in ~O(N). Needs
+ *                      no tuning, but degrades when many boxes share the same x range.
+ *
+ * Proxies with zero width or height never overlap anything.
+ */
+class Broadphase {
+ public:
+  enum class Mode : u8 {
+    SPATIAL_HASH = 0,
+    SWEEP_AND_PRUNE = 1,
+  };
+
+  Broadphase();
+  ~Broadphase();
+
+  /**
+   * Switch structures; the new one is rebuilt from the current proxies.
+   *
+   * @param cellSize - SPATIAL_HASH only. Roughly the size of a typical proxy.
+   */
+  void SetMode(Mode mode, f32 cellSize = 0.05f);
+  Mode GetMode() const;
+
+  /**
+   * @return - proxy id, in [0, Count()).
+   */
+  u32 Add(f32 x, f32 y, f32 halfW, f32 halfH);
+  u32 Count() const;
+  void Move(u32 proxy, f32 x, f32 y);
+
+  /**
+   * Move every proxy to the x, y pair of f32s at positions + proxy * stride
+   * (ie. pos in an array of instances).
+   */
+  void MoveAll(const void* positions, u32 stride);
+
+  /**
+   * @param pairs - Replaced with the overlapping pairs as (a << 32 | b) keys, a < b, sorted.
+   */
+  void FindPairs(std::vector<u64>& pairs);
+
+ private:
+  struct Bounds {
+    f32 minX, minY, maxX, maxY;
+  };
+
+  struct CellRange {
+    s32 x0, y0, x1, y1;
+
+    bool operator==(const CellRange& other) const {
+      return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+    }
+  };
+
+  // one edge of a proxy along x; proxy << 1 | (1 if max edge)
+  struct Endpoint {
+    f32 value;
+    u32 proxyEdge;
+  };
+
+  // bounds are copied in, so the pair scan reads buckets sequentially
+  struct BucketEntry {
+    Bounds bounds;
+    u32 proxy;
+  };
+
+  // copied in, so the sweep's inner loop doesn't gather from the proxy arrays
+  struct OpenInterval {
+    f32 minY;
+    f32 maxY;
+    u32 proxy;
+  };
+
+  bool IsCollider(u32 proxy) const;
+
+  CellRange CellsOf(u32 proxy) const;
+  u32 Bucket(s32 cx, s32 cy) const;
+  void Rebucket();
+  void FindHashPairs(std::vector<u64>& pairs);
+
+  f32 EdgeValue(u32 proxyEdge) const;
+  void FindSweepPairs(std::vector<u64>& pairs);
+
+  Mode mode = Mode::SPATIAL_HASH;
+
+  // proxies; bounds are kept together, since every overlap test reads all four
+  std::vector<Bounds> bounds = {};
+  std::vector<f32> halfW = {};
+  std::vector<f32> halfH = {};
+
+  // SPATIAL_HASH
+  f32 cellSize = 0.05f;
+  f32 inverseCellSize = 1 / 0.05f;
+  // cells each proxy touches; kept up to date by Move()
+  std::vector<CellRange> cells = {};
+  // set when any proxy's cells changed since the buckets were built
+  bool rebucket = false;
+  // set when any proxy moved since the buckets' bounds were refreshed
+  bool moved = false;
+  // a power of 2 buckets, each listing the proxies in every cell hashing to it;
+  // bucket b is buckets[bucketStart[b], bucketStart[b + 1])
+  std::vector<u32> bucketStart = {};
+  std::vector<BucketEntry> buckets = {};
+
+  // SWEEP_AND_PRUNE; stays sorted from one FindPairs() to the next
+  std::vector<Endpoint> endpoints = {};
+  // set when endpoints were added since the last sort, in no particular order
+  bool unsorted = false;
+  // proxies whose min edge has been passed, but not their max edge
+  std::vector<OpenInterval> open = {};
+  // index of each open proxy within open
+  std::vector<u32> openSlot = {};
+};
+
+}  // namespace mks
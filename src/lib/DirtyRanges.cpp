@@ -0,0 +1,62 @@
+#include "DirtyRanges.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "Base.hpp"
+
+namespace mks {
+
+void DirtyRanges::Mark(u32 slot) {
+  if (slot >= flags.size()) {
+    flags.resize(slot + 1, false);
+  }
+  if (!flags[slot]) {
+    flags[slot] = true;
+    slots.push_back(slot);
+  }
+}
+
+void DirtyRanges::MarkRange(u32 first, u32 count) {
+  for (u32 i = 0; i < count; i++) {
+    Mark(first + i);
+  }
+}
+
+bool DirtyRanges::IsDirty() const {
+  return !slots.empty();
+}
+
+u32 DirtyRanges::DirtyCount() const {
+  return slots.size();
+}
+
+std::vector<ByteRange> DirtyRanges::Coalesce(u32 stride, u32 maxGap) {
+  std::vector<ByteRange> ranges;
+  if (slots.empty()) {
+    return ranges;
+  }
+  std::sort(slots.begin(), slots.end());
+
+  u32 first = slots[0];
+  u32 last = slots[0];
+  for (size_t i = 1; i < slots.size(); i++) {
+    if (slots[i] - last - 1 <= maxGap) {
+      last = slots[i];
+      continue;
+    }
+    ranges.push_back({(u64)first * stride, (u64)(last - first + 1) * stride});
+    first = last = slots[i];
+  }
+  ranges.push_back({(u64)first * stride, (u64)(last - first + 1) * stride});
+  return ranges;
+}
+
+void DirtyRanges::Clear() {
+  for (const u32 slot : slots) {
+    flags[slot] = false;
+  }
+  slots.clear();
+}
+
+}  // namespace mks
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * A contiguous span of bytes within a buffer.
+ */
+struct ByteRange {
+  u64 offset = 0;
+  u64 size = 0;
+};
+
+/**
+ * Tracks which fixed-size slots of an array (ie. instances in a VBO) were modified,
+ * so only those bytes need to be re-uploaded.
+ */
+class DirtyRanges {
+ public:
+  /**
+   * Clean slots between two dirty ones are uploaded anyway if the gap is
+   * at most this many slots; one larger copy beats many tiny ones.
+   */
+  static const u32 DEFAULT_MAX_GAP = 2;
+
+  void Mark(u32 slot);
+  void MarkRange(u32 first, u32 count);
+  bool IsDirty() const;
+  u32 DirtyCount() const;
+
+  /**
+   * Sort dirty slots, and merge neighbors into as few byte ranges as possible.
+   *
+   * @param stride - Bytes per slot.
+   * @param maxGap - Merge ranges separated by this many clean slots, or fewer.
+   */
+  std::vector<ByteRange> Coalesce(u32 stride, u32 maxGap = DEFAULT_MAX_GAP);
+
+  void Clear();
+
+ private:
+  // one flag per slot, so a slot marked many times per frame is only listed once
+  std::vector<bool> flags = {};
+  std::vector<u32> slots = {};
+};
+
+}  // namespace mks
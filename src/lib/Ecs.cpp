@@ -0,0 +1,70 @@
+#include "Ecs.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace mks {
+
+thread_local Registry::Access Registry::access = {};
+
+Registry::Registry() {
+}
+
+Registry::~Registry() {
+}
+
+Entity Registry::Create() {
+  if (!freeIndices.empty()) {
+    const u32 index = freeIndices.back();
+    freeIndices.pop_back();
+    alive[index] = 1;
+    return {index, generations[index]};
+  }
+  const u32 index = generations.size();
+  generations.push_back(0);
+  alive.push_back(1);
+  return {index, 0};
+}
+
+void Registry::Destroy(Entity entity) {
+  if (!IsAlive(entity)) {
+    return;
+  }
+  for (auto& pool : pools) {
+    if (pool) {
+      pool->Remove(entity.index);
+    }
+  }
+  alive[entity.index] = 0;
+  // outstanding handles to this index are now stale
+  generations[entity.index]++;
+  freeIndices.push_back(entity.index);
+}
+
+bool Registry::IsAlive(Entity entity) const {
+  return entity.index < generations.size() && alive[entity.index] &&
+         generations[entity.index] == entity.generation;
+}
+
+u32 Registry::AliveCount() const {
+  return generations.size() - freeIndices.size();
+}
+
+void Registry::CheckAccess(u32 id) const {
+  const auto declared = [id](const std::vector<u32>* ids) {
+    return std::find(ids->begin(), ids->end(), id) != ids->end();
+  };
+  if (!declared(access.reads) && !declared(access.writes)) {
+    throw Logger::Errorf("system used component %u, which it didn't declare.", id);
+  }
+  if (id >= pools.size() || !pools[id]) {
+    // Engine::AddSystem() creates them
+    throw Logger::Errorf("no pool for component %u; create it before systems run.", id);
+  }
+}
+
+}  // namespace mks
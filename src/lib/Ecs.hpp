@@ -0,0 +1,244 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * Handle to an entity. The generation changes each time an index is reused, so a
+ * handle kept past Destroy() is detectably stale, instead of aliasing a new entity.
+ */
+struct Entity {
+  u32 index = ~0u;
+  u32 generation = 0;
+
+  bool operator==(const Entity& other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const Entity& other) const {
+    return !(*this == other);
+  }
+};
+
+/**
+ * Sparse set of one component type: components are packed contiguously (dense),
+ * and found by entity index through the sparse array, in O(1) either way.
+ * Removal swaps the last component into the gap, so the dense array never has holes.
+ */
+class ComponentPoolBase {
+ public:
+  static constexpr u32 NONE = ~0u;
+
+  virtual ~ComponentPoolBase() {
+  }
+
+  bool Has(u32 entity) const {
+    return entity < sparse.size() && NONE != sparse[entity];
+  }
+
+  u32 Size() const {
+    return dense.size();
+  }
+
+  /**
+   * Entity index of each component, in dense order.
+   */
+  const std::vector<u32>& Entities() const {
+    return dense;
+  }
+
+  virtual void Remove(u32 entity) = 0;
+
+ protected:
+  // entity index -> dense index, or NONE
+  std::vector<u32> sparse = {};
+  // dense index -> entity index
+  std::vector<u32> dense = {};
+};
+
+template <typename T>
+class ComponentPool : public ComponentPoolBase {
+ public:
+  T& Add(u32 entity, const T& component) {
+    if (Has(entity)) {
+      return components[sparse[entity]] = component;
+    }
+    if (entity >= sparse.size()) {
+      sparse.resize(entity + 1, NONE);
+    }
+    sparse[entity] = dense.size();
+    dense.push_back(entity);
+    components.push_back(component);
+    return components.back();
+  }
+
+  T& Get(u32 entity) {
+    return components[sparse[entity]];
+  }
+
+  void Remove(u32 entity) override {
+    if (!Has(entity)) {
+      return;
+    }
+    const u32 slot = sparse[entity];
+    const u32 last = dense.back();
+    components[slot] = std::move(components.back());
+    dense[slot] = last;
+    sparse[last] = slot;
+    components.pop_back();
+    dense.pop_back();
+    sparse[entity] = NONE;
+  }
+
+  /**
+   * Components, in dense order; parallel to Entities().
+   */
+  std::vector<T>& Components() {
+    return components;
+  }
+
+ private:
+  std::vector<T> components = {};
+};
+
+/**
+ * Entities, and one ComponentPool per component type.
+ *
+ * Each<A, B>(fn) walks the smallest pool among A and B, and skips entities missing the
+ * others; so iterating a rare component is cheap, however many entities exist.
+ * Don't add or remove the iterated components from within fn.
+ */
+class Registry {
+ public:
+  /**
+   * Component ids the calling thread's running system declared (see Scheduler). While
+   * set, Pool() throws on any other id, and on a declared pool not created up front,
+   * rather than touching (or resizing) pools another system may be using.
+   * Both nullptr, outside of systems.
+   */
+  struct Access {
+    const std::vector<u32>* reads = nullptr;
+    const std::vector<u32>* writes = nullptr;
+  };
+  static thread_local Access access;
+
+  Registry();
+  ~Registry();
+
+  Entity Create();
+  /**
+   * Remove all of the entity's components, and retire its handle.
+   */
+  void Destroy(Entity entity);
+  bool IsAlive(Entity entity) const;
+  u32 AliveCount() const;
+
+  /**
+   * @return - nullptr if the entity is stale; nothing is added.
+   */
+  template <typename T>
+  T* Add(Entity entity, const T& component = {}) {
+    return IsAlive(entity) ? &Pool<T>().Add(entity.index, component) : nullptr;
+  }
+
+  /**
+   * @return - nullptr if the entity is stale, or has no T.
+   */
+  template <typename T>
+  T* Get(Entity entity) {
+    auto& pool = Pool<T>();
+    return IsAlive(entity) && pool.Has(entity.index) ? &pool.Get(entity.index) : nullptr;
+  }
+
+  template <typename T>
+  bool Has(Entity entity) {
+    return IsAlive(entity) && Pool<T>().Has(entity.index);
+  }
+
+  template <typename T>
+  void Remove(Entity entity) {
+    if (IsAlive(entity)) {
+      Pool<T>().Remove(entity.index);
+    }
+  }
+
+  template <typename T>
+  ComponentPool<T>& Pool() {
+    const u32 id = ComponentId<T>();
+    if (nullptr != access.reads) {
+      CheckAccess(id);
+    }
+    if (id >= pools.size()) {
+      pools.resize(id + 1);
+    }
+    if (!pools[id]) {
+      pools[id] = std::make_unique<ComponentPool<T>>();
+    }
+    return *static_cast<ComponentPool<T>*>(pools[id].get());
+  }
+
+  /**
+   * Call fn(entity, first&, rest&...) for every entity which has all of the components.
+   */
+  template <typename First, typename... Rest, typename F>
+  void Each(F&& fn) {
+    auto& first = Pool<First>();
+    if constexpr (0 == sizeof...(Rest)) {
+      // one component; a straight walk over the dense arrays
+      auto& components = first.Components();
+      const auto& entities = first.Entities();
+      for (u32 i = 0; i < entities.size(); i++) {
+        fn(Entity{entities[i], generations[entities[i]]}, components[i]);
+      }
+    } else {
+      std::tuple<ComponentPool<Rest>&...> rest{Pool<Rest>()...};
+      const ComponentPoolBase* smallest = &first;
+      for (const ComponentPoolBase* pool :
+           {static_cast<ComponentPoolBase*>(&std::get<ComponentPool<Rest>&>(rest))...}) {
+        if (pool->Size() < smallest->Size()) {
+          smallest = pool;
+        }
+      }
+      for (const u32 e : smallest->Entities()) {
+        if (first.Has(e) && (std::get<ComponentPool<Rest>&>(rest).Has(e) && ...)) {
+          fn(Entity{e, generations[e]},
+             first.Get(e),
+             std::get<ComponentPool<Rest>&>(rest).Get(e)...);
+        }
+      }
+    }
+  }
+
+  /**
+   * Small dense id per component type, in order of first use; stable for the process.
+   */
+  template <typename T>
+  static u32 ComponentId() {
+    static const u32 id = NextComponentId();
+    return id;
+  }
+
+ private:
+  void CheckAccess(u32 id) const;
+
+  static u32 NextComponentId() {
+    // first uses may race, ie. from systems running on several threads
+    static std::atomic<u32> next = 0;
+    return next++;
+  }
+
+  // by component id
+  std::vector<std::unique_ptr<ComponentPoolBase>> pools = {};
+  // by entity index
+  std::vector<u32> generations = {};
+  std::vector<u8> alive = {};
+  // destroyed entity indices, to be reused
+  std::vector<u32> freeIndices = {};
+};
+
+}  // namespace mks
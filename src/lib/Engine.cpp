@@ -2,7 +2,10 @@
 
 #include <memory>
 
+#include "../components/Components.hpp"
+#include "Ecs.hpp"
 #include "Logger.hpp"
+#include "Scheduler.hpp"
 #include "Vulkan.hpp"
 
 namespace mks {
@@ -18,16 +21,53 @@ std::unique_ptr<Engine> Engine::Init() {
 
 Engine::Engine() {
   mks::Logger::Infof("New Engine");
+  AddSystem(
+      "integrate",
+      Reads<RigidBody2D>{},
+      Writes<Transform>{},
+      [this](f32 deltaTime) {
+        registry.Each<Transform, RigidBody2D>(
+            [deltaTime](Entity, Transform& transform, const RigidBody2D& body) {
+              transform.x += body.vx * deltaTime;
+              transform.y += body.vy * deltaTime;
+            });
+      });
 }
 
 Engine::~Engine() {
   mks::Logger::Infof("Engine deleted");
 }
 
-std::unique_ptr<Behavior> Engine::GetObject(char* name) {
-  mks::Logger::Infof("Engine.GetObject()");
-  auto b = std::make_unique<Behavior>();
-  return b;
+Behavior Engine::GetObject(const char* name) {
+  auto it = names.find(name);
+  if (it != names.end() && registry.IsAlive(it->second)) {
+    return Behavior{&registry, it->second};
+  }
+  const Entity entity = registry.Create();
+  names[name] = entity;
+  return Behavior{&registry, entity};
+}
+
+void Engine::Run() {
+  jobs.Start();
+}
+
+void Engine::Update(f32 deltaTime) {
+  systems.Run(jobs, deltaTime);
+}
+
+void Engine::Draw() {
+  drawList.clear();
+  registry.Each<Transform, Renderer>(
+      [this](Entity, const Transform& transform, const Renderer& renderer) {
+        drawList.push_back(
+            {transform.x,
+             transform.y,
+             transform.rotation,
+             transform.scaleX,
+             transform.scaleY,
+             renderer.texId});
+      });
 }
 
 }  // namespace mks
\ No newline at end of file
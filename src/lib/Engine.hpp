@@ -1,11 +1,30 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../components/Behavior.hpp"
+#include "Base.hpp"
+#include "Ecs.hpp"
+#include "Jobs.hpp"
+#include "Scheduler.hpp"
 
 namespace mks {
 
+/**
+ * One drawable, as gathered by Engine::Draw() for upload.
+ */
+struct DrawInstance {
+  f32 x;
+  f32 y;
+  f32 rotation;
+  f32 scaleX;
+  f32 scaleY;
+  u32 texId;
+};
+
 class Engine {
  public:
   static std::unique_ptr<Engine> Init();
@@ -14,21 +33,57 @@ class Engine {
 
   // void Log(char*);
   // void Info(char*);
-  std::unique_ptr<Behavior> GetObject(char* name);
+  /**
+   * Find the named object, or create it (as an entity with no components).
+   */
+  Behavior GetObject(const char* name);
+  /**
+   * Register a system for Update(), declaring which components it reads and writes;
+   * ie. AddSystem("integrate", Reads<RigidBody2D>{}, Writes<Transform>{}, fn).
+   * See Scheduler for how systems are ordered.
+   */
+  template <typename... R, typename... W>
+  Scheduler::SystemId AddSystem(
+      const std::string& name,
+      Reads<R...> reads,
+      Writes<W...> writes,
+      Scheduler::SystemFn fn,
+      bool mainThread = false) {
+    // pools are created on first use; do it now, rather than racing from within systems
+    (registry.Pool<R>(), ...);
+    (registry.Pool<W>(), ...);
+    return systems.Add(name, reads, writes, std::move(fn), mainThread);
+  }
   void Start(void* cb){};
-  void Run(){};
-  void Update(){};
+  /**
+   * Start the worker threads systems run on; until then, Update() runs them serially.
+   */
+  void Run();
+  /**
+   * Run every system once. The engine's own, added first:
+   *   integrate - Integrate every RigidBody2D into its Transform.
+   */
+  void Update(f32 deltaTime);
   void FinalUpdate(){};
-  void Draw(){};
+  /**
+   * Gather every entity with a Transform and a Renderer into drawList.
+   */
+  void Draw();
   void DrawGUI(){};
   void Stop(){};
   void Shutdown(){};
-  void Bind(std::unique_ptr<Behavior> obj){};
+  void Bind(Behavior obj){};
   void TriggerSync(char* event, ...){};
-  void TriggerObjectSync(char* event, std::unique_ptr<Behavior> obj, ...){};
+  void TriggerObjectSync(char* event, Behavior obj, ...){};
   void Trigger(char* event, void* cb){};
 
+  Registry registry = {};
+  Scheduler systems = {};
+  Jobs jobs = {};
+  std::vector<DrawInstance> drawList = {};
+
  private:
+  std::unordered_map<std::string, Entity> names = {};
 };
 
-}  // namespace mks
\ No newline at end of file
+}  // namespace mks
@@ -0,0 +1,179 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace {
+
+// a slice short enough that oversleeping it rarely overshoots a deadline
+const std::chrono::milliseconds SLEEP_SLICE(1);
+// older samples are weighted as if there were only this many, so the estimate tracks
+// changes in timer resolution (ie. power state) instead of averaging them away
+const u64 MAX_SLEEP_SAMPLES = 1000;
+
+f64 ToMs(const mks::FramePacer::Clock::duration d) {
+  return std::chrono::duration<f64, std::milli>(d).count();
+}
+
+}  // namespace
+
+namespace mks {
+
+void FrameTimeStats::Add(const f64 ms) {
+  count++;
+  const f64 delta = ms - mean;
+  mean += delta / count;
+  m2 += delta * (ms - mean);
+  if (1 == count) {
+    min = ms;
+    max = ms;
+  } else {
+    min = Min(min, ms);
+    max = Max(max, ms);
+  }
+}
+
+f64 FrameTimeStats::Variance() const {
+  return count > 1 ? m2 / (count - 1) : 0;
+}
+
+f64 FrameTimeStats::StdDev() const {
+  return std::sqrt(Variance());
+}
+
+void FrameTimeStats::Reset() {
+  count = 0;
+  mean = 0;
+  min = 0;
+  max = 0;
+  m2 = 0;
+}
+
+void FrameTimeStats::Log(const char* label) const {
+  Logger::Infof(
+      "%.60s: frames: %llu, avg: %.3fms, stddev: %.3fms, min: %.3fms, max: %.3fms",
+      label,
+      (unsigned long long)count,
+      mean,
+      StdDev(),
+      min,
+      max);
+}
+
+FramePacer::FramePacer() {
+}
+
+FramePacer::~FramePacer() {
+}
+
+void FramePacer::Start(const f64 intervalMs) {
+  this->intervalMs = intervalMs;
+  interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<f64, std::milli>(intervalMs));
+  stats.Reset();
+  missedCount = 0;
+  lastTick = Clock::now();
+  deadline = lastTick + interval;
+}
+
+void FramePacer::Resync() {
+  lastTick = Clock::now();
+  deadline = lastTick + interval;
+}
+
+FramePacer::Clock::time_point FramePacer::Deadline() const {
+  return deadline;
+}
+
+bool FramePacer::IsDue(const Clock::time_point now) const {
+  return now >= deadline;
+}
+
+f32 FramePacer::Tick(const Clock::time_point now) {
+  const auto elapsed = now - lastTick;
+  lastTick = now;
+  stats.Add(ToMs(elapsed));
+
+  deadline += interval;
+  if (now >= deadline) {
+    // more than a whole interval behind; running back-to-back frames to catch up
+    // would only trade one long frame for a burst of short ones
+    missedCount++;
+    deadline = now + interval;
+  }
+
+  return std::chrono::duration<f32>(elapsed).count();
+}
+
+void FramePacer::SleepUntil(const Clock::time_point deadline) {
+  // sleep in slices while we're sure to wake before the deadline
+  while (ToMs(deadline - Clock::now()) > sleepEstimateMs) {
+    const auto begin = Clock::now();
+    std::this_thread::sleep_for(SLEEP_SLICE);
+    const f64 observed = ToMs(Clock::now() - begin);
+
+    // estimate = mean + one standard deviation of observed sleeps (moving averages)
+    sleepCount = Min(sleepCount + 1, MAX_SLEEP_SAMPLES);
+    const f64 alpha = 1.0 / sleepCount;
+    const f64 delta = observed - sleepMeanMs;
+    sleepMeanMs += alpha * delta;
+    sleepVariance = (1 - alpha) * (sleepVariance + alpha * delta * delta);
+    sleepEstimateMs = sleepMeanMs + std::sqrt(sleepVariance);
+  }
+
+  // spin out the remainder; the OS can't wake us this precisely
+  while (Clock::now() < deadline) {
+  }
+}
+
+FixedTimestep::FixedTimestep() {
+}
+
+FixedTimestep::~FixedTimestep() {
+}
+
+void FixedTimestep::Start(
+    const f64 stepHz, const u32 maxSteps, const FramePacer::Clock::time_point now) {
+  this->maxSteps = maxSteps;
+  // integer clock ticks, so the accumulator never drifts through rounding
+  step = std::chrono::duration_cast<FramePacer::Clock::duration>(
+      std::chrono::duration<f64>(1.0 / stepHz));
+  stepSeconds = std::chrono::duration<f32>(step).count();
+  accumulator = {};
+  stepCount = 0;
+  droppedCount = 0;
+  last = now;
+}
+
+u32 FixedTimestep::Accumulate(const FramePacer::Clock::time_point now) {
+  accumulator += now - last;
+  last = now;
+
+  u64 steps = accumulator / step;
+  accumulator -= steps * step;
+  if (steps > maxSteps) {
+    droppedCount += steps - maxSteps;
+    steps = maxSteps;
+  }
+  stepCount += steps;
+  return static_cast<u32>(steps);
+}
+
+void FixedTimestep::Resync() {
+  last = FramePacer::Clock::now();
+}
+
+f32 FixedTimestep::Alpha() const {
+  return std::chrono::duration<f32>(accumulator) / std::chrono::duration<f32>(step);
+}
+
+FramePacer::Clock::time_point FixedTimestep::NextStep() const {
+  return last + (step - accumulator);
+}
+
+}  // namespace mks
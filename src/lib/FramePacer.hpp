@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * Running mean, variance, and bounds of frame intervals (Welford's method).
+ */
+struct FrameTimeStats {
+  u64 count = 0;
+  f64 mean = 0;
+  f64 min = 0;
+  f64 max = 0;
+
+  void Add(const f64 ms);
+  f64 Variance() const;
+  f64 StdDev() const;
+  void Reset();
+  void Log(const char* label) const;
+
+ private:
+  f64 m2 = 0;
+};
+
+/**
+ * Paces a loop to a fixed interval, against absolute deadlines.
+ *
+ * Each deadline is the previous one plus the interval (not "now" plus the interval),
+ * so lateness in one frame doesn't push every frame after it; the long-term rate is exact.
+ * When the loop falls more than a whole interval behind, the schedule is resynced
+ * instead of bursting to catch up.
+ *
+ * Waiting is hybrid: the OS sleeps in short slices while the deadline is comfortably far,
+ * then spins for the remainder. How far is "comfortable" is learned from how long
+ * those sleeps actually take on this machine, so coarse timers spin longer.
+ */
+class FramePacer {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  FramePacer();
+  ~FramePacer();
+
+  /**
+   * Begin a new schedule; the first deadline is one interval from now.
+   */
+  void Start(const f64 intervalMs);
+  /**
+   * Drop missed deadlines (ie. after the window was minimized), without recording an interval.
+   */
+  void Resync();
+
+  Clock::time_point Deadline() const;
+  bool IsDue(const Clock::time_point now) const;
+
+  /**
+   * Consume the current deadline, and schedule the next.
+   *
+   * @return - seconds since the previous Tick() (or Start()).
+   */
+  f32 Tick(const Clock::time_point now);
+
+  /**
+   * Block until the deadline; sleep while it is far, then spin.
+   */
+  void SleepUntil(const Clock::time_point deadline);
+
+  f64 intervalMs = 0;
+  // intervals between consecutive ticks
+  FrameTimeStats stats = {};
+  // ticks which were more than a whole interval late
+  u32 missedCount = 0;
+
+ private:
+  Clock::duration interval = {};
+  Clock::time_point deadline = {};
+  Clock::time_point lastTick = {};
+
+  // observed duration of one sleep slice; starts pessimistic, and adapts
+  f64 sleepEstimateMs = 5.0;
+  f64 sleepMeanMs = 1.0;
+  f64 sleepVariance = 0;
+  u64 sleepCount = 1;
+};
+
+/**
+ * Fixed-timestep accumulator, for deterministic simulation at any render rate.
+ *
+ * Real time is accumulated, and consumed in whole steps; the simulation only ever sees
+ * the constant step, so replays with the same inputs produce the same results.
+ * The fraction of a step left over is the interpolation alpha between the previous
+ * and current simulation states.
+ */
+class FixedTimestep {
+ public:
+  FixedTimestep();
+  ~FixedTimestep();
+
+  /**
+   * @param maxSteps - Cap on steps per Accumulate(); when a frame took longer than this
+   *                   many steps, the excess time is dropped (the simulation slows down)
+   *                   rather than spiraling further behind with ever longer catch-ups.
+   */
+  void Start(
+      const f64 stepHz,
+      const u32 maxSteps,
+      const FramePacer::Clock::time_point now = FramePacer::Clock::now());
+
+  /**
+   * Add the real time elapsed since the last call.
+   *
+   * @return - whole steps to simulate now, at most maxSteps.
+   */
+  u32 Accumulate(const FramePacer::Clock::time_point now);
+  /**
+   * Discard real time elapsed since the last call (ie. while paused), keeping any partial step.
+   */
+  void Resync();
+
+  /**
+   * Progress toward the next step, in [0, 1); blend previous and current states by this.
+   */
+  f32 Alpha() const;
+
+  /**
+   * When the next step will be due, given no further frames.
+   */
+  FramePacer::Clock::time_point NextStep() const;
+
+  f32 stepSeconds = 0;
+  u32 maxSteps = 0;
+  // lifetime count of steps ever simulated, and of steps dropped by the clamp
+  u64 stepCount = 0;
+  u64 droppedCount = 0;
+
+ private:
+  FramePacer::Clock::duration step = {};
+  FramePacer::Clock::duration accumulator = {};
+  FramePacer::Clock::time_point last = {};
+};
+
+}  // namespace mks
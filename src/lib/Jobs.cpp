@@ -0,0 +1,309 @@
+#include "Jobs.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace mks {
+
+namespace {
+
+// the pool (if any) the current thread works for, and its queue within it
+thread_local Jobs* currentJobs = nullptr;
+thread_local u32 currentWorker = 0;
+
+}  // namespace
+
+JobState::JobState(Jobs* jobs, u32 count) : jobs(jobs), remaining(count), done(0 == count) {
+}
+
+bool JobState::IsDone() const {
+  return done;
+}
+
+void JobState::OnDone(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!done) {
+      continuations.push_back(std::move(fn));
+      return;
+    }
+  }
+  fn();
+}
+
+void JobState::Complete(std::exception_ptr thrown) {
+  if (thrown) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error) {
+      error = thrown;
+    }
+  }
+  if (1 != remaining.fetch_sub(1)) {
+    return;
+  }
+  std::vector<std::function<void()>> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    ready.swap(continuations);
+  }
+  for (auto& fn : ready) {
+    fn();
+  }
+}
+
+std::exception_ptr JobState::Error() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return error;
+}
+
+void JobAwaiter::await_suspend(std::coroutine_handle<> coroutine) {
+  // this awaiter lives in the coroutine's frame, which may be gone as soon as it's resumed
+  JobHandle state = handle;
+  Jobs* jobs = state->jobs;
+  state->OnDone([jobs, coroutine] { jobs->Push([coroutine] { coroutine.resume(); }); });
+}
+
+void JobAwaiter::await_resume() const {
+  if (handle) {
+    if (auto error = handle->Error()) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+Jobs::Task::Task(Task&& other) noexcept : handle(other.handle) {
+  other.handle = nullptr;
+}
+
+Jobs::Task::~Task() {
+  // never spawned
+  if (handle) {
+    handle.destroy();
+  }
+}
+
+Jobs::Jobs() {
+  queues.push_back(std::make_unique<WorkQueue>());
+}
+
+Jobs::~Jobs() {
+  Stop();
+}
+
+void Jobs::Start(u32 threadCount) {
+  if (!threads.empty()) {
+    return;
+  }
+  if (0 == threadCount) {
+    const u32 hw = std::thread::hardware_concurrency();
+    threadCount = hw > 1 ? hw - 1 : 0;
+  }
+  stopping = false;
+  // the external queue (and anything already in it) stays last
+  auto external = std::move(queues.back());
+  queues.clear();
+  for (u32 i = 0; i < threadCount; i++) {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+  queues.push_back(std::move(external));
+  for (u32 i = 0; i < threadCount; i++) {
+    threads.emplace_back(&Jobs::WorkerLoop, this, i);
+  }
+  Logger::Debugf("jobs: %u workers", threadCount);
+}
+
+void Jobs::Stop() {
+  stopping = true;
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+  }
+  wake.notify_all();
+  for (auto& t : threads) {
+    t.join();
+  }
+  threads.clear();
+}
+
+u32 Jobs::WorkerCount() const {
+  return threads.size();
+}
+
+u32 Jobs::CurrentWorker() const {
+  return this == currentJobs ? currentWorker : WorkerCount();
+}
+
+void Jobs::Push(Job job) {
+  auto& queue = this == currentJobs ? *queues[currentWorker] : *queues.back();
+  // counted first, so queued never underflows when the job is popped right away
+  queued++;
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  if (sleepers > 0) {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+  }
+}
+
+bool Jobs::Pop(Job& job) {
+  const u32 count = queues.size();
+  const u32 own = this == currentJobs ? currentWorker : count - 1;
+  {
+    auto& queue = *queues[own];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+      queued--;
+      return true;
+    }
+  }
+  if (0 == queued) {
+    return false;
+  }
+  for (u32 i = 1; i < count; i++) {
+    auto& victim = *queues[(own + i) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Jobs::WorkerLoop(u32 worker) {
+  currentJobs = this;
+  currentWorker = worker;
+  Job job;
+  while (true) {
+    if (Pop(job)) {
+      job();
+      job = nullptr;
+      continue;
+    }
+    // queued work is finished before stopping
+    if (stopping && 0 == queued) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepers++;
+    wake.wait(lock, [this] { return stopping || queued > 0; });
+    sleepers--;
+  }
+}
+
+JobHandle Jobs::Submit(std::function<void()> fn, const std::vector<JobHandle>& deps) {
+  auto state = std::make_shared<JobState>(this);
+  auto job = [fn = std::move(fn), state, deps]() {
+    // a failed dependency fails its dependents, without running them
+    for (const auto& dep : deps) {
+      if (dep && dep->Error()) {
+        state->Complete(dep->Error());
+        return;
+      }
+    }
+    try {
+      fn();
+    } catch (...) {
+      state->Complete(std::current_exception());
+      return;
+    }
+    state->Complete();
+  };
+
+  // queued by whichever dependency completes last
+  auto gate = std::make_shared<std::atomic<u32>>(deps.size() + 1);
+  auto shared = std::make_shared<Job>(std::move(job));
+  auto arrive = [this, gate, shared] {
+    if (1 == gate->fetch_sub(1)) {
+      Push(std::move(*shared));
+    }
+  };
+  for (const auto& dep : deps) {
+    if (dep) {
+      dep->OnDone(arrive);
+    } else {
+      arrive();
+    }
+  }
+  arrive();
+  return state;
+}
+
+JobHandle Jobs::ParallelFor(u32 begin, u32 end, u32 grain, std::function<void(u32, u32)> fn) {
+  const u32 count = end > begin ? end - begin : 0;
+  if (0 == grain) {
+    const u32 chunks = 4 * (WorkerCount() + 1);
+    grain = Max(1u, (count + chunks - 1) / chunks);
+  }
+  const u32 chunkCount = (count + grain - 1) / grain;
+  auto state = std::make_shared<JobState>(this, chunkCount);
+  auto shared = std::make_shared<std::function<void(u32, u32)>>(std::move(fn));
+  for (u32 chunk = 0; chunk < chunkCount; chunk++) {
+    const u32 chunkBegin = begin + chunk * grain;
+    const u32 chunkEnd = Min(end, chunkBegin + grain);
+    Push([state, shared, chunkBegin, chunkEnd] {
+      try {
+        (*shared)(chunkBegin, chunkEnd);
+      } catch (...) {
+        state->Complete(std::current_exception());
+        return;
+      }
+      state->Complete();
+    });
+  }
+  return state;
+}
+
+JobHandle Jobs::Spawn(Task task) {
+  auto state = std::make_shared<JobState>(this);
+  auto coroutine = task.handle;
+  task.handle = nullptr;
+  coroutine.promise().state = state;
+  Push([coroutine] { coroutine.resume(); });
+  return state;
+}
+
+void Jobs::Wait(const JobHandle& handle) {
+  if (!handle) {
+    return;
+  }
+  Job job;
+  while (!handle->IsDone()) {
+    if (Pop(job)) {
+      job();
+      job = nullptr;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  if (auto error = handle->Error()) {
+    std::rethrow_exception(error);
+  }
+}
+
+bool Jobs::RunOne() {
+  Job job;
+  if (!Pop(job)) {
+    return false;
+  }
+  job();
+  return true;
+}
+
+}  // namespace mks
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Base.hpp"
+
+namespace mks {
+
+class Jobs;
+
+/**
+ * Completion state shared by a job (or a group of them, ie. ParallelFor chunks) and
+ * everyone waiting on it.
+ */
+class JobState {
+ public:
+  explicit JobState(Jobs* jobs, u32 count = 1);
+
+  bool IsDone() const;
+
+  /**
+   * Call fn once the job has completed: right away if it already has, or else from the
+   * thread completing it.
+   */
+  void OnDone(std::function<void()> fn);
+
+  /**
+   * One of count units finished; the last one runs the continuations.
+   */
+  void Complete(std::exception_ptr thrown = nullptr);
+
+  std::exception_ptr Error() const;
+
+ private:
+  friend class Jobs;
+  friend struct JobAwaiter;
+
+  Jobs* jobs;
+  std::atomic<u32> remaining;
+  std::atomic<bool> done = false;
+  mutable std::mutex mutex;
+  std::vector<std::function<void()>> continuations = {};
+  std::exception_ptr error = nullptr;
+};
+
+typedef std::shared_ptr<JobState> JobHandle;
+
+/**
+ * co_await handle; within a Jobs::Task. Rethrows the job's exception, if it threw.
+ */
+struct JobAwaiter {
+  JobHandle handle;
+
+  bool await_ready() const {
+    return !handle || handle->IsDone();
+  }
+  void await_suspend(std::coroutine_handle<> coroutine);
+  void await_resume() const;
+};
+
+inline JobAwaiter operator co_await(JobHandle handle) {
+  return JobAwaiter{std::move(handle)};
+}
+
+/**
+ * Fixed pool of worker threads, each with its own deque of jobs. A worker pushes and pops
+ * its own deque at the back (so nested work stays hot in its cache), and when that's empty
+ * steals from the front of another's, where the oldest and usually largest jobs are.
+ *
+ * Jobs report completion through a JobHandle. A job may depend on other handles; it is
+ * only queued once they have all completed, so nothing sits blocked on a worker. Waiting
+ * is never a plain block either: Wait() runs other jobs until the handle completes, and a
+ * Jobs::Task coroutine can co_await a handle, suspending until it completes and then
+ * resuming as a job on whichever worker completed it.
+ *
+ *   Jobs::Task Load(Jobs& jobs, Asset* a) {
+ *     co_await jobs.Submit([a] { a->Read(); });
+ *     co_await jobs.ParallelFor(0, a->Mips(), 1, [a](u32 i0, u32 i1) { ... });
+ *   }
+ *   jobs.Wait(jobs.Spawn(Load(jobs, asset)));
+ */
+class Jobs {
+ public:
+  /**
+   * A coroutine run as jobs; see Spawn().
+   */
+  class Task {
+   public:
+    struct promise_type {
+      JobHandle state;
+
+      Task get_return_object() {
+        return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+      std::suspend_always initial_suspend() noexcept {
+        return {};
+      }
+      // the frame frees itself once the body has run
+      std::suspend_never final_suspend() noexcept {
+        return {};
+      }
+      void return_void() {
+        state->Complete();
+      }
+      void unhandled_exception() {
+        state->Complete(std::current_exception());
+      }
+    };
+
+    Task(Task&& other) noexcept;
+    ~Task();
+
+   private:
+    friend class Jobs;
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {
+    }
+    std::coroutine_handle<promise_type> handle;
+  };
+
+  Jobs();
+  ~Jobs();
+
+  /**
+   * @param threadCount - Workers to spawn. 0 picks one per hardware thread, minus the caller.
+   */
+  void Start(u32 threadCount = 0);
+  void Stop();
+  u32 WorkerCount() const;
+
+  /**
+   * The worker running the calling thread, in [0, WorkerCount()); WorkerCount() for
+   * threads outside the pool.
+   */
+  u32 CurrentWorker() const;
+
+  /**
+   * Queue fn to run once every dependency has completed.
+   */
+  JobHandle Submit(std::function<void()> fn, const std::vector<JobHandle>& deps = {});
+
+  /**
+   * Split [begin, end) into chunks of about grain indices, and run fn(chunkBegin, chunkEnd)
+   * on each, concurrently. 0 grain picks about 4 chunks per worker.
+   */
+  JobHandle ParallelFor(u32 begin, u32 end, u32 grain, std::function<void(u32, u32)> fn);
+
+  /**
+   * Start running a Task coroutine; the handle completes when its body returns.
+   */
+  JobHandle Spawn(Task task);
+
+  /**
+   * Run jobs on this thread until handle has completed. Rethrows the first exception
+   * thrown by its job(s).
+   */
+  void Wait(const JobHandle& handle);
+
+  /**
+   * Run one queued job, if there is one; for threads outside the pool that want to help.
+   */
+  bool RunOne();
+
+ private:
+  typedef std::function<void()> Job;
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs = {};
+  };
+
+  friend class JobState;
+  friend struct JobAwaiter;
+
+  void Push(Job job);
+  bool Pop(Job& job);
+  void WorkerLoop(u32 worker);
+
+  std::vector<std::thread> threads = {};
+  // one per worker, plus the last one, shared by threads outside the pool
+  std::vector<std::unique_ptr<WorkQueue>> queues = {};
+  // jobs in all queues; workers sleep when there are none
+  std::atomic<u32> queued = 0;
+  std::atomic<u32> sleepers = 0;
+  std::atomic<bool> stopping = false;
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+};
+
+}  // namespace mks
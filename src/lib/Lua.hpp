@@ -4,8 +4,19 @@ extern "C" {
 #include <lauxlib.h>
 #include <lua.h>
 #include <lualib.h>
+#if MKS_LUAJIT == 1
+#include <luajit.h>
+#endif
 }
 
+#if MKS_LUAJIT == 1
+// LuaJIT implements the Lua 5.1 C API; shim the few 5.4 calls we use.
+#ifndef LUA_OK
+#define LUA_OK 0
+#endif
+#define lua_newuserdatauv(L, size, nuvalue) lua_newuserdata(L, size)
+#endif
+
 #include <string>
 
 namespace mks {
@@ -18,4 +29,16 @@ class Lua {
   std::string GetError();
   bool ReloadScript(const char* file);
 };
+
+/**
+ * The native object a C function was bound with, as upvalue 1 (light userdata); ie.
+ * lua_pushlightuserdata(L, this); lua_pushcclosure(L, fn, 1);
+ *
+ * NOTICE: bound functions run inside lua_pcall, and luaL_error() longjmps out of them,
+ * so they must not hold any locals with destructors at that point.
+ */
+template <class T>
+T* UpvalueSelf(lua_State* L) {
+  return static_cast<T*>(lua_touserdata(L, lua_upvalueindex(1)));
+}
 }  // namespace mks
\ No newline at end of file
@@ -0,0 +1,434 @@
+#include "LuaStructView.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Base.hpp"
+#include "DirtyRanges.hpp"
+#include "Logger.hpp"
+#include "Lua.hpp"
+
+namespace {
+
+struct Element {
+  mks::LuaStructView* view;
+  u32 index;
+};
+
+// these run inside lua_pcall; see the NOTICE on mks::UpvalueSelf()
+
+// each view registers its own metatables, so one view's methods can't be handed another
+// view's userdata (or any other kind); see Bind()
+
+// upvalue typeName: the view's metatable name
+mks::LuaStructView* CheckView(lua_State* L, int arg, int typeName) {
+  const char* name = lua_tostring(L, lua_upvalueindex(typeName));
+  return *static_cast<mks::LuaStructView**>(luaL_checkudata(L, arg, name));
+}
+
+/**
+ * luaL_checkudata(), against the element metatable held in upvalue meta rather than
+ * looked up in the registry by name; field access is the hot path.
+ */
+Element* CheckElement(lua_State* L, int arg, int meta) {
+  void* e = lua_touserdata(L, arg);
+  if (nullptr == e || !lua_getmetatable(L, arg) ||
+      !lua_rawequal(L, -1, lua_upvalueindex(meta))) {
+    luaL_argerror(L, arg, "struct view element expected");
+  }
+  lua_pop(L, 1);
+  return static_cast<Element*>(e);
+}
+
+void PushField(lua_State* L, const u8* element, const mks::LuaField& field) {
+  if (mks::LuaField::Type::F32 == field.type) {
+    f32 value;
+    memcpy(&value, element + field.offset, sizeof(value));
+    lua_pushnumber(L, value);
+  } else {
+    u32 value;
+    memcpy(&value, element + field.offset, sizeof(value));
+    lua_pushinteger(L, value);
+  }
+}
+
+/**
+ * Raises a Lua error rather than storing 0 for nil, non-numbers, or (for U32 fields)
+ * fractions and values out of range.
+ */
+void WriteField(lua_State* L, int arg, u8* element, const mks::LuaField& field) {
+  if (mks::LuaField::Type::F32 == field.type) {
+    const f32 value = static_cast<f32>(luaL_checknumber(L, arg));
+    memcpy(element + field.offset, &value, sizeof(value));
+  } else {
+    const lua_Integer v = luaL_checkinteger(L, arg);
+    if (v < 0 || v > static_cast<lua_Integer>(UINT32_MAX)) {
+      char text[96];
+      snprintf(
+          text,
+          sizeof(text),
+          "%s: %lld out of range for u32",
+          field.name,
+          static_cast<long long>(v));
+      luaL_error(L, "%s", text);
+    }
+    const u32 value = static_cast<u32>(v);
+    memcpy(element + field.offset, &value, sizeof(value));
+  }
+}
+
+// upvalue 1: table of field name -> 1-based field index; upvalue 2: element metatable
+int ElementIndex(lua_State* L) {
+  auto e = CheckElement(L, 1, 2);
+  lua_pushvalue(L, 2);
+  lua_rawget(L, lua_upvalueindex(1));
+  if (LUA_TNUMBER != lua_type(L, -1)) {
+    lua_pushnil(L);
+    return 1;
+  }
+  const auto& field = e->view->Fields()[lua_tointeger(L, -1) - 1];
+  PushField(L, e->view->At(L, e->index), field);
+  return 1;
+}
+
+int ElementNewIndex(lua_State* L) {
+  auto e = CheckElement(L, 1, 2);
+  lua_pushvalue(L, 2);
+  lua_rawget(L, lua_upvalueindex(1));
+  if (LUA_TNUMBER != lua_type(L, -1)) {
+    return luaL_error(L, "no such field: %s", lua_tostring(L, 2));
+  }
+  const auto& field = e->view->Fields()[lua_tointeger(L, -1) - 1];
+  WriteField(L, 3, e->view->At(L, e->index), field);
+  e->view->MarkDirty(e->index, 1);
+  return 0;
+}
+
+/**
+ * (first, count) starting at stack slot arg; checked before narrowing, so negative or
+ * huge values can't wrap into range (nor into the error message).
+ */
+void CheckRange(lua_State* L, mks::LuaStructView* view, int arg, u32& first, u32& count) {
+  const lua_Integer f = luaL_checkinteger(L, arg);
+  const lua_Integer n = luaL_checkinteger(L, arg + 1);
+  const lua_Integer total = view->Count();
+  if (f < 0 || n < 0 || f > total || n > total - f) {
+    // lua_pushfstring() has no 64-bit integer format in LuaJIT
+    char text[96];
+    snprintf(
+        text,
+        sizeof(text),
+        "range [%lld, +%lld) out of range [0, %lld)",
+        static_cast<long long>(f),
+        static_cast<long long>(n),
+        static_cast<long long>(total));
+    luaL_error(L, "%s", text);
+  }
+  first = static_cast<u32>(f);
+  count = static_cast<u32>(n);
+}
+
+// upvalue 1: view type name
+int ViewLen(lua_State* L) {
+  lua_pushinteger(L, CheckView(L, 1, 1)->Count());
+  return 1;
+}
+
+// upvalue 1: view type name; upvalue 2: element metatable
+int ViewAt(lua_State* L) {
+  auto view = CheckView(L, 1, 1);
+  const lua_Integer i = luaL_checkinteger(L, 2);
+  if (i < 0 || i >= static_cast<lua_Integer>(view->Count())) {
+    char text[64];
+    snprintf(
+        text,
+        sizeof(text),
+        "index %lld out of range [0, %u)",
+        static_cast<long long>(i),
+        view->Count());
+    luaL_error(L, "%s", text);
+  }
+  const u32 index = static_cast<u32>(i);
+  auto e = static_cast<Element*>(lua_newuserdatauv(L, sizeof(Element), 0));
+  e->view = view;
+  e->index = index;
+  lua_pushvalue(L, lua_upvalueindex(2));
+  lua_setmetatable(L, -2);
+  return 1;
+}
+
+/**
+ * (first, count, packed) starting at stack slot arg.
+ */
+int Write(lua_State* L, mks::LuaStructView* view, int arg) {
+  u32 first, count;
+  CheckRange(L, view, arg, first, count);
+  luaL_checktype(L, arg + 2, LUA_TTABLE);
+  if (0 == count) {
+    return 0;
+  }
+  const auto& fields = view->Fields();
+  u8* element = view->At(L, first);
+  lua_Integer k = 1;
+  for (u32 i = 0; i < count; i++, element += view->Stride()) {
+    for (const auto& field : fields) {
+      lua_rawgeti(L, arg + 2, k);
+      // checked here, so the error names the entry rather than a stack slot
+      if (LUA_TNUMBER != lua_type(L, -1)) {
+        luaL_error(
+            L,
+            "packed[%d] (%s): number expected, got %s",
+            (int)k,
+            field.name,
+            luaL_typename(L, -1));
+      }
+      WriteField(L, lua_gettop(L), element, field);
+      lua_pop(L, 1);
+      k++;
+    }
+  }
+  view->MarkDirty(first, count);
+  return 0;
+}
+
+// upvalue 1: view type name
+int ViewWrite(lua_State* L) {
+  return Write(L, CheckView(L, 1, 1), 2);
+}
+
+// upvalue 1: view type name
+int ViewRead(lua_State* L) {
+  auto view = CheckView(L, 1, 1);
+  u32 first, count;
+  CheckRange(L, view, 2, first, count);
+  const auto& fields = view->Fields();
+  if (lua_istable(L, 4)) {
+    lua_pushvalue(L, 4);
+  } else {
+    lua_createtable(L, count * fields.size(), 0);
+  }
+  if (0 == count) {
+    return 1;
+  }
+  const u8* element = view->At(L, first);
+  lua_Integer k = 1;
+  for (u32 i = 0; i < count; i++, element += view->Stride()) {
+    for (const auto& field : fields) {
+      PushField(L, element, field);
+      lua_rawseti(L, -2, k++);
+    }
+  }
+  return 1;
+}
+
+// upvalue 1: the view, as light userdata
+int GlobalWrite(lua_State* L) {
+  return Write(L, mks::UpvalueSelf<mks::LuaStructView>(L), 1);
+}
+
+#if MKS_LUAJIT == 1
+// called from Lua through the FFI; plain C signatures
+
+u8* FfiData(void* view) {
+  return static_cast<mks::LuaStructView*>(view)->Data();
+}
+
+u32 FfiCount(void* view) {
+  return static_cast<mks::LuaStructView*>(view)->Count();
+}
+
+void FfiMarkDirty(void* view, u32 first, u32 count) {
+  static_cast<mks::LuaStructView*>(view)->MarkDirty(first, count);
+}
+
+/**
+ * Replace view:at() with FFI element refs, which the JIT compiles down to plain
+ * loads and stores into the native struct (plus one call to mark it dirty).
+ */
+const char* FFI_PRELUDE = R"lua(
+local name, view, stride, fields, dataFn, countFn, markFn = ...
+local ffi = require("ffi")
+
+-- declare the native struct, padded so every offset matches exactly
+table.sort(fields, function(a, b) return a.offset < b.offset end)
+local decl, at = {}, 0
+for i, f in ipairs(fields) do
+  if f.offset > at then
+    decl[#decl + 1] = string.format("uint8_t _pad%d[%d];", i, f.offset - at)
+  end
+  decl[#decl + 1] = string.format("%s %s;", f.type, f.name)
+  at = f.offset + 4
+end
+if stride > at then
+  decl[#decl + 1] = string.format("uint8_t _padEnd[%d];", stride - at)
+end
+local T = "mks_" .. name
+ffi.cdef("typedef struct { " .. table.concat(decl, " ") .. " } " .. T .. ";")
+ffi.cdef("typedef struct { void* view; uint32_t id; } " .. T .. "_ref;")
+assert(ffi.sizeof(T) == stride, T .. " does not match the native stride")
+
+local ptr = ffi.typeof(T .. "*")
+local data = ffi.cast("uint8_t* (*)(void*)", dataFn)
+local count = ffi.cast("uint32_t (*)(void*)", countFn)
+local mark = ffi.cast("void (*)(void*, uint32_t, uint32_t)", markFn)
+-- re-resolved on every access, since the host may reallocate the array
+local Ref = ffi.metatype(T .. "_ref", {
+  __index = function(r, k)
+    return ffi.cast(ptr, data(r.view))[r.id][k]
+  end,
+  __newindex = function(r, k, v)
+    ffi.cast(ptr, data(r.view))[r.id][k] = v
+    mark(r.view, r.id, 1)
+  end,
+})
+
+local handle = ffi.cast("void*", view)
+getmetatable(_G[name]).__index.at = function(_, id)
+  if id < 0 or id >= count(handle) then
+    error(string.format("index %d out of range [0, %d)", id, count(handle)))
+  end
+  return Ref(handle, id)
+end
+)lua";
+#endif
+
+}  // namespace
+
+namespace mks {
+
+LuaStructView::LuaStructView() {
+}
+
+LuaStructView::~LuaStructView() {
+}
+
+void LuaStructView::Bind(
+    lua_State* L,
+    const char* name,
+    void* array,
+    u32 stride,
+    const std::vector<LuaField>& fields,
+    DirtyRanges* dirty,
+    Resolve resolve) {
+  this->array = array;
+  this->stride = stride;
+  this->fields = fields;
+  this->dirty = dirty;
+  this->resolve = resolve;
+
+  // field name -> 1-based index; interned strings make this a cheap lookup
+  lua_createtable(L, 0, fields.size());
+  for (u32 i = 0; i < fields.size(); i++) {
+    lua_pushinteger(L, i + 1);
+    lua_setfield(L, -2, fields[i].name);
+  }
+  const int fieldIndex = lua_gettop(L);
+
+  // named per view, in the registry, for luaL_checkudata()
+  const std::string viewType = std::string("mks.LuaStructView.") + name;
+  const std::string elementType = viewType + ".element";
+  lua_pushstring(L, viewType.c_str());
+  const int viewTypeName = lua_gettop(L);
+
+  luaL_newmetatable(L, elementType.c_str());
+  const int elementMeta = lua_gettop(L);
+  lua_pushvalue(L, fieldIndex);
+  lua_pushvalue(L, elementMeta);
+  lua_pushcclosure(L, ElementIndex, 2);
+  lua_setfield(L, -2, "__index");
+  lua_pushvalue(L, fieldIndex);
+  lua_pushvalue(L, elementMeta);
+  lua_pushcclosure(L, ElementNewIndex, 2);
+  lua_setfield(L, -2, "__newindex");
+
+  auto ud = static_cast<LuaStructView**>(lua_newuserdatauv(L, sizeof(LuaStructView*), 0));
+  *ud = this;
+  luaL_newmetatable(L, viewType.c_str());
+  lua_createtable(L, 0, 3);
+  lua_pushvalue(L, viewTypeName);
+  lua_pushvalue(L, elementMeta);
+  lua_pushcclosure(L, ViewAt, 2);
+  lua_setfield(L, -2, "at");
+  lua_pushvalue(L, viewTypeName);
+  lua_pushcclosure(L, ViewWrite, 1);
+  lua_setfield(L, -2, "write");
+  lua_pushvalue(L, viewTypeName);
+  lua_pushcclosure(L, ViewRead, 1);
+  lua_setfield(L, -2, "read");
+  lua_setfield(L, -2, "__index");
+  lua_pushvalue(L, viewTypeName);
+  lua_pushcclosure(L, ViewLen, 1);
+  lua_setfield(L, -2, "__len");
+  lua_setmetatable(L, -2);
+  lua_setglobal(L, name);
+
+  // field index, view type name, element metatable
+  lua_pop(L, 3);
+
+#if MKS_LUAJIT == 1
+  if (LUA_OK != luaL_loadbuffer(L, FFI_PRELUDE, strlen(FFI_PRELUDE), "LuaStructView")) {
+    throw Logger::Errorf("LuaStructView FFI prelude: %.160s", lua_tostring(L, -1));
+  }
+  lua_pushstring(L, name);
+  lua_pushlightuserdata(L, this);
+  lua_pushinteger(L, stride);
+  lua_createtable(L, fields.size(), 0);
+  for (u32 i = 0; i < fields.size(); i++) {
+    lua_createtable(L, 0, 3);
+    lua_pushstring(L, fields[i].name);
+    lua_setfield(L, -2, "name");
+    lua_pushinteger(L, fields[i].offset);
+    lua_setfield(L, -2, "offset");
+    lua_pushstring(L, LuaField::Type::F32 == fields[i].type ? "float" : "uint32_t");
+    lua_setfield(L, -2, "type");
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_pushlightuserdata(L, reinterpret_cast<void*>(&FfiData));
+  lua_pushlightuserdata(L, reinterpret_cast<void*>(&FfiCount));
+  lua_pushlightuserdata(L, reinterpret_cast<void*>(&FfiMarkDirty));
+  if (LUA_OK != lua_pcall(L, 7, 0, 0)) {
+    throw Logger::Errorf("LuaStructView FFI prelude: %.160s", lua_tostring(L, -1));
+  }
+#endif
+}
+
+void LuaStructView::BindWrite(lua_State* L, const char* name) {
+  lua_pushlightuserdata(L, this);
+  lua_pushcclosure(L, GlobalWrite, 1);
+  lua_setglobal(L, name);
+}
+
+u8* LuaStructView::At(lua_State* L, u32 index) const {
+  const Span span = resolve(array);
+  if (index >= span.count) {
+    luaL_error(L, "index %d out of range [0, %d)", (int)index, (int)span.count);
+  }
+  return span.data + static_cast<size_t>(index) * stride;
+}
+
+u8* LuaStructView::Data() const {
+  return resolve(array).data;
+}
+
+u32 LuaStructView::Stride() const {
+  return stride;
+}
+
+u32 LuaStructView::Count() const {
+  return resolve(array).count;
+}
+
+const std::vector<LuaField>& LuaStructView::Fields() const {
+  return fields;
+}
+
+void LuaStructView::MarkDirty(u32 first, u32 count) const {
+  if (dirty) {
+    dirty->MarkRange(first, count);
+  }
+}
+
+}  // namespace mks
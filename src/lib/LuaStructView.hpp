@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+
+#include "Base.hpp"
+#include "DirtyRanges.hpp"
+#include "Lua.hpp"
+
+namespace mks {
+
+/**
+ * One scalar within a native struct, as seen from Lua (ie. "posX" at offsetof(pos)).
+ */
+struct LuaField {
+  enum class Type : u8 {
+    F32 = 0,
+    U32 = 1,
+  };
+
+  const char* name;
+  u32 offset;
+  Type type;
+};
+
+/**
+ * Lua-visible view over a native array of structs (ie. the instance VBO source),
+ * so scripts read and write fields in place, instead of marshalling every field
+ * through the Lua stack on every call.
+ *
+ * From Lua, where `view` is the global name given to Bind():
+ *   #view                             -- element count
+ *   local e = view:at(id)             -- element proxy (0-based id); keep it around.
+ *   e.posX = e.posX + 1               -- reads and writes go straight to native memory
+ *   view:write(first, count, packed)  -- packed: count * #fields numbers, in field order
+ *   view:read(first, count, packed)   -- the reverse; fills and returns packed
+ *
+ * Writes mark elements dirty. The host may resize the array; every access re-resolves it.
+ *
+ * Built with MKS_LUAJIT, view:at() instead returns FFI refs over a cdef of the same
+ * struct, so JIT-compiled scripts access fields without leaving the trace.
+ */
+class LuaStructView {
+ public:
+  struct Span {
+    u8* data;
+    u32 count;
+  };
+  typedef Span (*Resolve)(void* array);
+
+  LuaStructView();
+  ~LuaStructView();
+
+  template <typename T>
+  void Bind(
+      lua_State* L,
+      const char* name,
+      std::vector<T>& array,
+      const std::vector<LuaField>& fields,
+      DirtyRanges* dirty) {
+    Bind(L, name, &array, sizeof(T), fields, dirty, [](void* a) {
+      auto v = static_cast<std::vector<T>*>(a);
+      return Span{reinterpret_cast<u8*>(v->data()), static_cast<u32>(v->size())};
+    });
+  }
+
+  /**
+   * Expose view:write() as a plain global function too (ie. WriteInstances).
+   */
+  void BindWrite(lua_State* L, const char* name);
+
+  /**
+   * Resolve the element, or raise a Lua error if it's out of range.
+   */
+  u8* At(lua_State* L, u32 index) const;
+  u8* Data() const;
+  u32 Count() const;
+  u32 Stride() const;
+  const std::vector<LuaField>& Fields() const;
+  void MarkDirty(u32 first, u32 count) const;
+
+ private:
+  void Bind(
+      lua_State* L,
+      const char* name,
+      void* array,
+      u32 stride,
+      const std::vector<LuaField>& fields,
+      DirtyRanges* dirty,
+      Resolve resolve);
+
+  void* array = nullptr;
+  u32 stride = 0;
+  std::vector<LuaField> fields = {};
+  DirtyRanges* dirty = nullptr;
+  Resolve resolve = nullptr;
+};
+
+}  // namespace mks
@@ -0,0 +1,208 @@
+#include "Physics2D.hpp"
+
+#include <vector>
+
+#include "Base.hpp"
+#include "Broadphase.hpp"
+#include "Lua.hpp"
+
+namespace {
+
+mks::Contact FromKey(u64 key) {
+  return {static_cast<u32>(key >> 32), static_cast<u32>(key)};
+}
+
+u32 CheckBody(lua_State* L, mks::Physics2D* self, int arg) {
+  const lua_Integer body = luaL_checkinteger(L, arg);
+  if (body < 0 || body >= self->Count()) {
+    luaL_error(L, "no such body: %d", (int)body);
+  }
+  return static_cast<u32>(body);
+}
+
+// bound with the Physics2D as upvalue 1; see mks::UpvalueSelf()
+
+int PhysicsAdd(lua_State* L) {
+  const u32 id = mks::UpvalueSelf<mks::Physics2D>(L)->Add(
+      static_cast<u32>(luaL_checkinteger(L, 1)),
+      static_cast<f32>(luaL_checknumber(L, 2)),
+      static_cast<f32>(luaL_checknumber(L, 3)),
+      static_cast<f32>(luaL_optnumber(L, 4, 0)),
+      static_cast<f32>(luaL_optnumber(L, 5, 0)));
+  lua_pushinteger(L, id);
+  return 1;
+}
+
+int PhysicsPosition(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Physics2D>(L);
+  const u32 body = CheckBody(L, self, 1);
+  lua_pushnumber(L, self->x[body]);
+  lua_pushnumber(L, self->y[body]);
+  return 2;
+}
+
+int PhysicsVelocity(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Physics2D>(L);
+  const u32 body = CheckBody(L, self, 1);
+  lua_pushnumber(L, self->vx[body]);
+  lua_pushnumber(L, self->vy[body]);
+  return 2;
+}
+
+int PhysicsSetVelocity(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Physics2D>(L);
+  self->SetVelocity(
+      CheckBody(L, self, 1),
+      static_cast<f32>(luaL_checknumber(L, 2)),
+      static_cast<f32>(luaL_checknumber(L, 3)));
+  return 0;
+}
+
+int PhysicsTeleport(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Physics2D>(L);
+  self->Teleport(
+      CheckBody(L, self, 1),
+      static_cast<f32>(luaL_checknumber(L, 2)),
+      static_cast<f32>(luaL_checknumber(L, 3)));
+  return 0;
+}
+
+int PhysicsSetActive(lua_State* L) {
+  auto self = mks::UpvalueSelf<mks::Physics2D>(L);
+  self->SetActive(CheckBody(L, self, 1), lua_toboolean(L, 2));
+  return 0;
+}
+
+void PushPacked(lua_State* L, const std::vector<mks::Contact>& contacts) {
+  lua_createtable(L, contacts.size() * 2, 0);
+  lua_Integer k = 1;
+  for (const auto& c : contacts) {
+    lua_pushinteger(L, c.a);
+    lua_rawseti(L, -2, k++);
+    lua_pushinteger(L, c.b);
+    lua_rawseti(L, -2, k++);
+  }
+}
+
+}  // namespace
+
+namespace mks {
+
+Physics2D::Physics2D() {
+}
+
+Physics2D::~Physics2D() {
+}
+
+u32 Physics2D::Add(u32 instance, f32 x, f32 y, f32 width, f32 height) {
+  const u32 id = Count();
+  this->x.push_back(x);
+  this->y.push_back(y);
+  prevX.push_back(x);
+  prevY.push_back(y);
+  drawnX.push_back(x);
+  drawnY.push_back(y);
+  vx.push_back(0);
+  vy.push_back(0);
+  halfW.push_back(width / 2);
+  halfH.push_back(height / 2);
+  this->instance.push_back(instance);
+  active.push_back(1);
+  teleported.push_back(1);
+  // one proxy per body, colliders or not, so the ids line up
+  broadphase.Add(x, y, width / 2, height / 2);
+  return id;
+}
+
+u32 Physics2D::Count() const {
+  return x.size();
+}
+
+void Physics2D::SetVelocity(u32 body, f32 vx, f32 vy) {
+  this->vx[body] = vx;
+  this->vy[body] = vy;
+}
+
+void Physics2D::SetActive(u32 body, bool active) {
+  this->active[body] = active;
+}
+
+void Physics2D::Teleport(u32 body, f32 x, f32 y) {
+  this->x[body] = prevX[body] = x;
+  this->y[body] = prevY[body] = y;
+  teleported[body] = 1;
+  broadphase.Move(body, x, y);
+}
+
+void Physics2D::Step(f32 dt) {
+  const u32 n = Count();
+  for (u32 i = 0; i < n; i++) {
+    prevX[i] = x[i];
+    prevY[i] = y[i];
+  }
+  // separate pass, so the compiler can vectorize it
+  for (u32 i = 0; i < n; i++) {
+    const f32 step = active[i] ? dt : 0;
+    x[i] += vx[i] * step;
+    y[i] += vy[i] * step;
+  }
+  for (u32 i = 0; i < n; i++) {
+    if (x[i] != prevX[i] || y[i] != prevY[i]) {
+      broadphase.Move(i, x[i], y[i]);
+    }
+  }
+
+  lastPairs.swap(pairs);
+  broadphase.FindPairs(pairs);
+
+  // both lists are sorted; one merge sorts every pair into enter, stay, or exit
+  entered.clear();
+  stayed.clear();
+  exited.clear();
+  u32 i = 0, j = 0;
+  while (i < pairs.size() || j < lastPairs.size()) {
+    if (j == lastPairs.size() || (i < pairs.size() && pairs[i] < lastPairs[j])) {
+      entered.push_back(FromKey(pairs[i++]));
+    } else if (i == pairs.size() || lastPairs[j] < pairs[i]) {
+      exited.push_back(FromKey(lastPairs[j++]));
+    } else {
+      stayed.push_back(FromKey(pairs[i++]));
+      j++;
+    }
+  }
+}
+
+void Physics2D::Bind(lua_State* L, const char* name) {
+  const luaL_Reg functions[] = {
+      {"add", PhysicsAdd},
+      {"position", PhysicsPosition},
+      {"velocity", PhysicsVelocity},
+      {"setVelocity", PhysicsSetVelocity},
+      {"teleport", PhysicsTeleport},
+      {"setActive", PhysicsSetActive},
+  };
+  lua_createtable(L, 0, ArrayCount(functions));
+  for (const auto& fn : functions) {
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, fn.func, 1);
+    lua_setfield(L, -2, fn.name);
+  }
+  lua_setglobal(L, name);
+}
+
+bool Physics2D::DispatchContacts(lua_State* L, const char* fn) const {
+  if (entered.empty() && stayed.empty() && exited.empty()) {
+    return true;
+  }
+  lua_getglobal(L, fn);
+  if (!lua_isfunction(L, -1)) {
+    lua_pop(L, 1);
+    return true;
+  }
+  PushPacked(L, entered);
+  PushPacked(L, stayed);
+  PushPacked(L, exited);
+  return LUA_OK == lua_pcall(L, 3, 0, 0);
+}
+
+}  // namespace mks
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+
+#include "Base.hpp"
+#include "Broadphase.hpp"
+#include "Lua.hpp"
+
+namespace mks {
+
+/**
+ * Two bodies whose colliders overlap; always a < b.
+ */
+struct Contact {
+  u32 a;
+  u32 b;
+};
+
+/**
+ * Native 2D rigidbodies with axis-aligned box colliders, stored as parallel arrays
+ * (SoA), so integration and overlap tests stream through memory instead of chasing
+ * one Lua table per body.
+ *
+ * Each Step() integrates velocities, finds overlapping pairs with a Broadphase, and
+ * diffs them against the previous step into enter / stay / exit contact lists.
+ * Scripts keep the game rules, and hear about contacts in one batched callback:
+ *
+ *   function OnContacts(entered, stayed, exited)  -- each packed {a1, b1, a2, b2, ...}
+ *
+ * From Lua, where `physics` is the global name given to Bind():
+ *   local id = physics.add(instance, x, y, width, height)  -- 0-size for no collider
+ *   physics.setVelocity(id, vx, vy)    local vx, vy = physics.velocity(id)
+ *   physics.teleport(id, x, y)         local x, y = physics.position(id)
+ *   physics.setActive(id, false)       -- stop integrating; still collides
+ */
+class Physics2D {
+ public:
+  Physics2D();
+  ~Physics2D();
+
+  /**
+   * @param instance - Instance slot Interpolate() reports the body's drawn position for.
+   * @return - body id, in [0, Count()).
+   */
+  u32 Add(u32 instance, f32 x, f32 y, f32 width, f32 height);
+  u32 Count() const;
+
+  void SetVelocity(u32 body, f32 vx, f32 vy);
+  void SetActive(u32 body, bool active);
+  /**
+   * Move without sweeping through anything in between, and without interpolation.
+   */
+  void Teleport(u32 body, f32 x, f32 y);
+
+  /**
+   * Integrate one fixed step, then refresh the contact lists.
+   */
+  void Step(f32 dt);
+
+  /**
+   * Report the drawn position of every body whose drawn position changed since it was
+   * last reported, blended between its last two fixed steps, as write(instance, x, y).
+   * A body which stops is reported once more, at the position it stopped at.
+   *
+   * @param alpha - progress toward the next fixed step [0, 1)
+   */
+  template <typename F>
+  void Interpolate(f32 alpha, F&& write) {
+    const u32 n = Count();
+    for (u32 i = 0; i < n; i++) {
+      const f32 drawX = prevX[i] + (x[i] - prevX[i]) * alpha;
+      const f32 drawY = prevY[i] + (y[i] - prevY[i]) * alpha;
+      if (drawX != drawnX[i] || drawY != drawnY[i] || teleported[i]) {
+        teleported[i] = 0;
+        drawnX[i] = drawX;
+        drawnY[i] = drawY;
+        write(instance[i], drawX, drawY);
+      }
+    }
+  }
+
+  /**
+   * Expose the body functions to Lua as a global table.
+   */
+  void Bind(lua_State* L, const char* name);
+
+  /**
+   * Call the global Lua function fn(entered, stayed, exited) once, if there were
+   * any contacts this step and fn is defined.
+   *
+   * @return - false if fn raised an error; it's left on the Lua stack.
+   */
+  bool DispatchContacts(lua_State* L, const char* fn) const;
+
+  // defaults to a spatial hash; switch with broadphase.SetMode()
+  Broadphase broadphase = {};
+
+  // contact events from the last Step()
+  std::vector<Contact> entered = {};
+  std::vector<Contact> stayed = {};
+  std::vector<Contact> exited = {};
+
+  // SoA body state; indexed by body id
+  std::vector<f32> x = {};
+  std::vector<f32> y = {};
+  // position before the last step, for interpolation
+  std::vector<f32> prevX = {};
+  std::vector<f32> prevY = {};
+  // position last reported by Interpolate()
+  std::vector<f32> drawnX = {};
+  std::vector<f32> drawnY = {};
+  std::vector<f32> vx = {};
+  std::vector<f32> vy = {};
+  // collider half extents; 0 for bodies without a collider
+  std::vector<f32> halfW = {};
+  std::vector<f32> halfH = {};
+  std::vector<u32> instance = {};
+  std::vector<u8> active = {};
+  std::vector<u8> teleported = {};
+
+ private:
+  // sorted (a << 32 | b) keys of overlapping pairs, this step and the last
+  std::vector<u64> pairs = {};
+  std::vector<u64> lastPairs = {};
+};
+
+}  // namespace mks
@@ -0,0 +1,244 @@
+#include "Scheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace mks {
+
+Scheduler::Scheduler() {
+}
+
+Scheduler::~Scheduler() {
+}
+
+Scheduler::SystemId Scheduler::Add(
+    const std::string& name,
+    const std::vector<u32>& reads,
+    const std::vector<u32>& writes,
+    SystemFn fn,
+    bool mainThread) {
+  const SystemId id = systems.size();
+  systems.emplace_back();
+  auto& system = systems.back();
+  system.name = name;
+  system.fn = std::move(fn);
+  system.reads = reads;
+  system.writes = writes;
+  system.mainThread = mainThread;
+  dirty = true;
+  return id;
+}
+
+u32 Scheduler::Count() const {
+  return systems.size();
+}
+
+const std::vector<Scheduler::SystemId>& Scheduler::Dependencies(SystemId id) {
+  if (id >= systems.size()) {
+    throw Logger::Errorf("unknown system %u.", id);
+  }
+  Build();
+  return systems[id].dependencies;
+}
+
+void Scheduler::Build() {
+  if (!dirty) {
+    return;
+  }
+  dirty = false;
+
+  // per component: the last system to write it, and the systems reading it since;
+  // enough for the same ordering as all-pairs conflict edges, with far fewer of them
+  const SystemId NONE = ~0u;
+  std::vector<SystemId> lastWriter;
+  std::vector<std::vector<SystemId>> readersSince;
+  auto grow = [&](u32 component) {
+    if (component >= lastWriter.size()) {
+      lastWriter.resize(component + 1, NONE);
+      readersSince.resize(component + 1);
+    }
+  };
+
+  for (auto& system : systems) {
+    system.dependencies.clear();
+    system.dependents.clear();
+  }
+  for (SystemId id = 0; id < systems.size(); id++) {
+    auto& system = systems[id];
+    auto& deps = system.dependencies;
+    for (const u32 c : system.reads) {
+      grow(c);
+      if (NONE != lastWriter[c]) {
+        deps.push_back(lastWriter[c]);
+      }
+    }
+    for (const u32 c : system.writes) {
+      grow(c);
+      if (NONE != lastWriter[c]) {
+        deps.push_back(lastWriter[c]);
+      }
+      deps.insert(deps.end(), readersSince[c].begin(), readersSince[c].end());
+    }
+    std::sort(deps.begin(), deps.end());
+    deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+    deps.erase(std::remove(deps.begin(), deps.end(), id), deps.end());
+    for (const SystemId dep : deps) {
+      systems[dep].dependents.push_back(id);
+    }
+
+    for (const u32 c : system.reads) {
+      readersSince[c].push_back(id);
+    }
+    for (const u32 c : system.writes) {
+      lastWriter[c] = id;
+      readersSince[c].clear();
+    }
+  }
+}
+
+void Scheduler::Schedule(Jobs& jobs, SystemId id, f32 deltaTime) {
+  if (systems[id].mainThread) {
+    std::lock_guard<std::mutex> lock(mainMutex);
+    mainReady.push_back(id);
+    return;
+  }
+  // Execute() catches what the system throws, so the handle never carries an error
+  jobs.Submit([this, &jobs, id, deltaTime] { Execute(jobs, id, deltaTime); });
+}
+
+bool Scheduler::PopMain(SystemId& id) {
+  std::lock_guard<std::mutex> lock(mainMutex);
+  if (mainReady.empty()) {
+    return false;
+  }
+  id = mainReady.back();
+  mainReady.pop_back();
+  return true;
+}
+
+void Scheduler::Run(Jobs& jobs, f32 deltaTime) {
+  Build();
+  start = std::chrono::high_resolution_clock::now();
+  if (systems.empty()) {
+    wallMs = 0;
+    return;
+  }
+
+  workerCount = jobs.WorkerCount() + 1;
+  failed = false;
+  error = nullptr;
+  remaining = systems.size();
+  for (auto& system : systems) {
+    system.pending = system.dependencies.size();
+  }
+  for (SystemId id = 0; id < systems.size(); id++) {
+    if (0 == systems[id].dependencies.size()) {
+      Schedule(jobs, id, deltaTime);
+    }
+  }
+
+  // the caller takes main-thread systems, and helps with the rest meanwhile
+  SystemId id;
+  while (remaining > 0) {
+    if (PopMain(id)) {
+      Execute(jobs, id, deltaTime);
+    } else if (!jobs.RunOne()) {
+      // systems are short, and the frame waits on them; don't sleep
+      std::this_thread::yield();
+    }
+  }
+
+  wallMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+               .count();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void Scheduler::Execute(Jobs& jobs, SystemId id, f32 deltaTime) {
+  auto& system = systems[id];
+  auto& timing = system.timing;
+  const auto begin = std::chrono::high_resolution_clock::now();
+  if (!failed) {
+    // the Registry rejects components the system didn't declare
+    Registry::access = {&system.reads, &system.writes};
+    try {
+      system.fn(deltaTime);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      failed = true;
+    }
+    Registry::access = {};
+  }
+  const auto end = std::chrono::high_resolution_clock::now();
+  timing.worker = jobs.CurrentWorker();
+  timing.startMs = std::chrono::duration<f64, std::milli>(begin - start).count();
+  timing.lastMs = std::chrono::duration<f64, std::milli>(end - begin).count();
+  timing.avgMs = 0 == timing.avgMs ? timing.lastMs : timing.avgMs * 0.9 + timing.lastMs * 0.1;
+
+  for (const SystemId dependent : system.dependents) {
+    if (1 == systems[dependent].pending.fetch_sub(1)) {
+      Schedule(jobs, dependent, deltaTime);
+    }
+  }
+  remaining--;
+}
+
+const Scheduler::Timing& Scheduler::GetTiming(SystemId id) const {
+  if (id >= systems.size()) {
+    throw Logger::Errorf("unknown system %u.", id);
+  }
+  return systems[id].timing;
+}
+
+f64 Scheduler::LastWallMs() const {
+  return wallMs;
+}
+
+void Scheduler::LogTimings() const {
+  // longest chain of dependencies; no schedule can finish the frame faster
+  std::vector<f64> finishMs(systems.size(), 0);
+  f64 criticalMs = 0;
+  f64 busyMs = 0;
+  for (SystemId id = 0; id < systems.size(); id++) {
+    f64 readyMs = 0;
+    for (const SystemId dep : systems[id].dependencies) {
+      readyMs = Max(readyMs, finishMs[dep]);
+    }
+    finishMs[id] = readyMs + systems[id].timing.lastMs;
+    criticalMs = Max(criticalMs, finishMs[id]);
+    busyMs += systems[id].timing.lastMs;
+  }
+  Logger::Infof(
+      "systems: %u on %u threads, %.3fms wall, %.3fms serial, %.3fms critical path",
+      static_cast<u32>(systems.size()),
+      workerCount,
+      wallMs,
+      busyMs,
+      criticalMs);
+  for (const auto& system : systems) {
+    const auto& timing = system.timing;
+    Logger::Infof(
+        "  %8.3fms %8.3fms (avg %8.3fms)  [%s%u] %.160s",
+        timing.startMs,
+        timing.lastMs,
+        timing.avgMs,
+        system.mainThread ? "main " : "w",
+        timing.worker,
+        system.name.c_str());
+  }
+}
+
+}  // namespace mks
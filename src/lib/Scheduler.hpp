@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Base.hpp"
+#include "Ecs.hpp"
+#include "Jobs.hpp"
+
+namespace mks {
+
+/**
+ * Component types a system only reads, or also writes; ie. Reads<RigidBody2D>{}.
+ */
+template <typename... T>
+struct Reads {};
+template <typename... T>
+struct Writes {};
+
+/**
+ * Runs the engine's systems once per frame, concurrently where their component access
+ * allows it.
+ *
+ * Each system declares the components it reads and writes. A system runs after every
+ * earlier-added system it conflicts with (one of them writes a component the other
+ * touches), so the result is the same as running them all in order of Add(); systems
+ * which don't conflict run in parallel. The dependency graph is rebuilt only when
+ * systems are added.
+ *
+ * Ready systems are submitted to Jobs, so they go onto the deque of the worker which
+ * readied them (LIFO, so a dependent tends to run on the thread whose cache holds its
+ * inputs), and idle workers steal from the other end of someone else's deque. The
+ * caller of Run() takes main-thread systems, and otherwise helps with any queued job.
+ *
+ * Systems must not touch undeclared components (the Registry throws if they do), nor
+ * create or destroy entities.
+ */
+class Scheduler {
+ public:
+  typedef u32 SystemId;
+  typedef std::function<void(f32 deltaTime)> SystemFn;
+
+  /**
+   * Timings of one system; lastMs is the most recent frame, avgMs a running average.
+   */
+  struct Timing {
+    f64 startMs = 0;
+    f64 lastMs = 0;
+    f64 avgMs = 0;
+    u32 worker = 0;
+  };
+
+  Scheduler();
+  ~Scheduler();
+
+  /**
+   * @param reads, writes - Component ids, from Registry::ComponentId<T>().
+   * @param mainThread - Only run on the thread which called Run() (ie. for Lua or SDL calls).
+   */
+  SystemId Add(
+      const std::string& name,
+      const std::vector<u32>& reads,
+      const std::vector<u32>& writes,
+      SystemFn fn,
+      bool mainThread = false);
+
+  template <typename... R, typename... W>
+  SystemId Add(
+      const std::string& name, Reads<R...>, Writes<W...>, SystemFn fn, bool mainThread = false) {
+    return Add(
+        name,
+        {Registry::ComponentId<R>()...},
+        {Registry::ComponentId<W>()...},
+        std::move(fn),
+        mainThread);
+  }
+
+  u32 Count() const;
+
+  /**
+   * Systems which must complete before this one starts.
+   */
+  const std::vector<SystemId>& Dependencies(SystemId id);
+
+  /**
+   * Run every system once, and block until all have completed.
+   * Rethrows the first exception thrown by any system; systems not yet started are skipped.
+   */
+  void Run(Jobs& jobs, f32 deltaTime);
+
+  const Timing& GetTiming(SystemId id) const;
+  f64 LastWallMs() const;
+
+  /**
+   * Print each system's timings from the last Run(), and the frame's critical path.
+   */
+  void LogTimings() const;
+
+ private:
+  struct System {
+    std::string name;
+    SystemFn fn;
+    std::vector<u32> reads = {};
+    std::vector<u32> writes = {};
+    bool mainThread = false;
+    // rebuilt by Build()
+    std::vector<SystemId> dependencies = {};
+    std::vector<SystemId> dependents = {};
+    // dependencies not yet completed, this frame
+    std::atomic<u32> pending = 0;
+    Timing timing = {};
+  };
+
+  void Build();
+  void Schedule(Jobs& jobs, SystemId id, f32 deltaTime);
+  bool PopMain(SystemId& id);
+  void Execute(Jobs& jobs, SystemId id, f32 deltaTime);
+
+  // deque; System holds an atomic, so it can't be moved
+  std::deque<System> systems = {};
+  bool dirty = false;
+
+  // ready main-thread systems, run by the caller of Run()
+  std::mutex mainMutex;
+  std::deque<SystemId> mainReady = {};
+  std::atomic<u32> remaining = 0;
+  std::atomic<bool> failed = false;
+  std::mutex errorMutex;
+  std::exception_ptr error = nullptr;
+  std::chrono::high_resolution_clock::time_point start = {};
+  f64 wallMs = 0;
+  u32 workerCount = 0;
+};
+
+}  // namespace mks
@@ -0,0 +1,179 @@
+#include "TaskGraph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace mks {
+
+TaskGraph::TaskGraph() {
+}
+
+TaskGraph::~TaskGraph() {
+}
+
+TaskGraph::TaskId TaskGraph::Add(
+    const std::string& name,
+    std::function<void()> fn,
+    const std::vector<TaskId>& deps,
+    bool mainThread) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const TaskId id = tasks.size();
+  tasks.push_back({});
+  auto& task = tasks.back();
+  task.name = name;
+  task.fn = std::move(fn);
+  task.mainThread = mainThread;
+  for (const TaskId dep : deps) {
+    if (dep >= id) {
+      throw Logger::Errorf("task %s depends on unknown task %u.", name.c_str(), dep);
+    }
+    if (!tasks[dep].done) {
+      tasks[dep].dependents.push_back(id);
+      task.pendingDeps++;
+    }
+  }
+  if (running && 0 == task.pendingDeps) {
+    Schedule(id);
+  }
+  return id;
+}
+
+void TaskGraph::Schedule(TaskId id) {
+  if (tasks[id].mainThread) {
+    mainReady.push_back(id);
+    changed.notify_all();
+    return;
+  }
+  inFlight++;
+  jobs->Submit([this, id] { Execute(id); });
+}
+
+void TaskGraph::Run(Jobs& jobs) {
+  std::unique_lock<std::mutex> lock(mutex);
+  start = std::chrono::high_resolution_clock::now();
+  running = true;
+  error = nullptr;
+  this->jobs = &jobs;
+  workerCount = jobs.WorkerCount() + 1;
+  for (TaskId id = 0; id < tasks.size(); id++) {
+    if (!tasks[id].done && 0 == tasks[id].pendingDeps) {
+      Schedule(id);
+    }
+  }
+
+  // the caller takes main-thread tasks, and helps with queued jobs meanwhile
+  auto finished = [this] { return (error || completed == tasks.size()) && 0 == inFlight; };
+  while (!finished()) {
+    if (!error && !mainReady.empty()) {
+      const TaskId id = mainReady.front();
+      mainReady.pop_front();
+      lock.unlock();
+      Execute(id);
+      lock.lock();
+      continue;
+    }
+    lock.unlock();
+    const bool ran = jobs.RunOne();
+    lock.lock();
+    if (!ran) {
+      // tasks may run long; rather than spin, check back for jobs now and then
+      changed.wait_for(lock, std::chrono::milliseconds(1), [&] {
+        return finished() || (!error && !mainReady.empty());
+      });
+    }
+  }
+
+  running = false;
+  this->jobs = nullptr;
+  // never started, after an error; the next Run() schedules them again
+  mainReady.clear();
+  wallMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+               .count();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void TaskGraph::Execute(TaskId id) {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto& task = tasks[id];
+  const bool isJob = !task.mainThread;
+  if (error) {
+    // no further tasks are started after one throws
+    inFlight -= isJob;
+    changed.notify_all();
+    return;
+  }
+  task.worker = jobs->CurrentWorker();
+  task.startMs = std::chrono::duration<f64, std::milli>(
+                     std::chrono::high_resolution_clock::now() - start)
+                     .count();
+
+  lock.unlock();
+  std::exception_ptr thrown = nullptr;
+  try {
+    task.fn();
+  } catch (...) {
+    thrown = std::current_exception();
+  }
+  lock.lock();
+
+  task.endMs = std::chrono::duration<f64, std::milli>(
+                   std::chrono::high_resolution_clock::now() - start)
+                   .count();
+  task.done = true;
+  completed++;
+  if (thrown && !error) {
+    error = thrown;
+  }
+  for (const TaskId dependent : task.dependents) {
+    if (0 == --tasks[dependent].pendingDeps) {
+      Schedule(dependent);
+    }
+  }
+  inFlight -= isJob;
+  changed.notify_all();
+}
+
+void TaskGraph::LogTimeline() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<TaskId> order(tasks.size());
+  for (TaskId id = 0; id < tasks.size(); id++) {
+    order[id] = id;
+  }
+  std::sort(order.begin(), order.end(), [this](TaskId a, TaskId b) {
+    return tasks[a].startMs < tasks[b].startMs;
+  });
+
+  f64 busyMs = 0;
+  for (const auto& task : tasks) {
+    busyMs += task.endMs - task.startMs;
+  }
+  Logger::Infof(
+      "task timeline: %u tasks, %u threads, %.2fms wall, %.2fms serial",
+      static_cast<u32>(tasks.size()),
+      workerCount,
+      wallMs,
+      busyMs);
+  for (const TaskId id : order) {
+    const auto& task = tasks[id];
+    Logger::Infof(
+        "  %8.2fms - %8.2fms %8.2fms  [%s%u] %.160s",
+        task.startMs,
+        task.endMs,
+        task.endMs - task.startMs,
+        task.mainThread ? "main " : "w",
+        task.worker,
+        task.name.c_str());
+  }
+}
+
+}  // namespace mks
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Base.hpp"
+#include "Jobs.hpp"
+
+namespace mks {
+
+/**
+ * Directed acyclic graph of tasks, each submitted to Jobs as soon as its dependencies
+ * have completed. Main-thread tasks are run by the caller of Run(), which otherwise
+ * helps with queued jobs. Records a per-task timeline.
+ */
+class TaskGraph {
+ public:
+  typedef u32 TaskId;
+
+  TaskGraph();
+  ~TaskGraph();
+
+  /**
+   * May also be called from within a running task (ie. to fan out work which
+   * is only known once that task has run); dependencies must already exist.
+   *
+   * @param mainThread - Only run on the thread which called Run() (ie. for SDL/window calls).
+   */
+  TaskId Add(
+      const std::string& name,
+      std::function<void()> fn,
+      const std::vector<TaskId>& deps = {},
+      bool mainThread = false);
+
+  /**
+   * Block until every task has completed.
+   * Rethrows the first exception thrown by any task; no further tasks are started after it.
+   */
+  void Run(Jobs& jobs);
+
+  /**
+   * Print when each task ran, relative to the start of Run().
+   */
+  void LogTimeline() const;
+
+ private:
+  struct Task {
+    std::string name;
+    std::function<void()> fn;
+    std::vector<TaskId> dependents = {};
+    u32 pendingDeps = 0;
+    bool mainThread = false;
+    bool done = false;
+    u32 worker = 0;
+    f64 startMs = 0;
+    f64 endMs = 0;
+  };
+
+  void Schedule(TaskId id);
+  void Execute(TaskId id);
+
+  // deque; references stay valid as tasks are appended during Run()
+  std::deque<Task> tasks = {};
+  std::deque<TaskId> mainReady = {};
+  // submitted to jobs and not yet finished (or skipped); Run() waits for these to drain
+  u32 inFlight = 0;
+  u32 completed = 0;
+  bool running = false;
+  Jobs* jobs = nullptr;
+  std::exception_ptr error = nullptr;
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+  std::chrono::high_resolution_clock::time_point start = {};
+  f64 wallMs = 0;
+  u32 workerCount = 0;
+};
+
+}  // namespace mks
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * Lock-free single-producer, single-consumer handoff of the latest value.
+ *
+ * The producer fills the back slot and publishes it, never waiting on the consumer;
+ * the consumer picks up the newest published slot, never waiting on the producer.
+ * Values published in between are skipped (we only ever want the latest snapshot).
+ * The third slot is what lets both sides proceed without blocking: it holds the
+ * most recently published value, ready to be swapped in by either side.
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  /**
+   * Producer only. The slot to fill. Holds stale data from some earlier publish.
+   */
+  T& Write() {
+    return slots[back];
+  }
+
+  /**
+   * Producer only. Make the back slot the latest value.
+   */
+  void Publish() {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  /**
+   * Consumer only. Swap in the latest published value, if there is one newer than Read().
+   *
+   * @return - true if Read() changed.
+   */
+  bool Update() {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  /**
+   * Consumer only. The value as of the last Update(); stable until the next one.
+   */
+  const T& Read() const {
+    return slots[front];
+  }
+
+ private:
+  static const u8 INDEX = 0x3;
+  // set on the middle index when it holds a value the consumer hasn't seen
+  static const u8 FRESH = 0x4;
+
+  std::array<T, 3> slots = {};
+  u8 back = 0;
+  std::atomic<u8> middle = 1;
+  u8 front = 2;
+};
+
+}  // namespace mks
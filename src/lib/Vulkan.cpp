@@ -2,7 +2,12 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -12,6 +17,53 @@
 #include "Logger.hpp"
 #include "Shader.hpp"
 
+namespace {
+
+/**
+ * Prefixed to the driver's pipeline cache blob on disk. The driver validates its own
+ * header too, but some drivers crash on stale data, so we never hand them any.
+ */
+struct PipelineCacheFileHeader {
+  char magic[4];
+  u32 version;
+  u32 vendorID;
+  u32 deviceID;
+  u32 driverVersion;
+  u8 pipelineCacheUUID[VK_UUID_SIZE];
+  u64 dataSize;
+  u64 checksum;
+};
+
+const char PIPELINE_CACHE_MAGIC[4] = {'M', 'K', 'S', 'P'};
+const u32 PIPELINE_CACHE_VERSION = 1;
+
+// FNV-1a; catches truncated or corrupted files
+u64 Checksum(const char* data, size_t size) {
+  u64 hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<u8>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+const char* PresentModeName(VkPresentModeKHR mode) {
+  switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+      return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return "FIFO_RELAXED";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+}  // namespace
+
 namespace mks {
 
 std::vector<const char*> Vulkan::requiredValidationLayers{};
@@ -331,6 +383,7 @@ void Vulkan::LocateQueueFamilies() {
   // debug: list all queue families found on the current physical device
   Logger::Debugf("device queue families:");
   bool same = false;
+  bool transferCompute = false;
   for (uint32_t i = 0; i < queueFamilies.size(); i++) {
     const auto& queueFamily = queueFamilies[i];
 
@@ -366,6 +419,13 @@ void Vulkan::LocateQueueFamilies() {
       }
     }
 
+    // a family without GRAPHICS can copy while the graphics queue renders; prefer one
+    // without COMPUTE, too (ie. the GPU's copy engine)
+    if (transfer && !graphics && (!pdqs.transfer.index.has_value() || (transferCompute && !compute))) {
+      pdqs.transfer.index = i;
+      transferCompute = compute;
+    }
+
     Logger::Debugf(
         "  %u: flags:%s%s%s%s%s%s%s",
         i,
@@ -378,7 +438,12 @@ void Vulkan::LocateQueueFamilies() {
         optical ? " OPTICAL" : "");
   }
 
-  Logger::Debugf("  selected: graphics: %u, present: %u", pdqs.graphics.index, pdqs.present.index);
+  Logger::Debugf(
+      "  selected: graphics: %u, present: %u, transfer: %s",
+      pdqs.graphics.index.value_or(0),
+      pdqs.present.index.value_or(0),
+      pdqs.transfer.index.has_value() ? std::to_string(pdqs.transfer.index.value()).c_str()
+                                      : "none (graphics)");
 }
 
 const bool Vulkan::CheckPhysicalDeviceExtensions() {
@@ -552,6 +617,18 @@ void Vulkan::UseLogicalDevice() {
     createInfo.pQueuePriorities = &queuePriority;
     queueCreateInfos.push_back(createInfo);
   }
+  // a present-capable transfer family shares its one queue with present
+  const bool ownTransferQueue = pdqs.transfer.index.has_value() &&
+                                pdqs.transfer.index.value() != pdqs.present.index.value();
+  const float transferPriority = 1.0f;
+  if (ownTransferQueue) {
+    VkDeviceQueueCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    createInfo.queueFamilyIndex = pdqs.transfer.index.value();
+    createInfo.queueCount = 1;
+    createInfo.pQueuePriorities = &transferPriority;
+    queueCreateInfos.push_back(createInfo);
+  }
 
   // Structure describing the fine-grained features that can be supported by an implementation
   // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceFeatures.html
@@ -560,6 +637,39 @@ void Vulkan::UseLogicalDevice() {
   // used with texture images
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  // frame pacing and transfers use timeline semaphores; core in Vulkan 1.2, but still an
+  // optional feature there
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  VkPhysicalDeviceVulkan12Features supported12{};
+  supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+  if (properties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceFeatures2 supported{};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+  }
+  if (!supported12.timelineSemaphore) {
+    throw Logger::Errorf("timeline semaphores not supported by physical device.");
+  }
+  // the bindless texture table
+  if (!supported12.shaderSampledImageArrayNonUniformIndexing ||
+      !supported12.descriptorBindingPartiallyBound || !supported12.runtimeDescriptorArray ||
+      !supported12.descriptorBindingSampledImageUpdateAfterBind) {
+    throw Logger::Errorf("descriptor indexing not supported by physical device.");
+  }
+  if (framesInFlight < 1 || framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+    throw Logger::Errorf(
+        "framesInFlight must be 1 to %u, not %u.", MAX_FRAMES_IN_FLIGHT, framesInFlight);
+  }
+  VkPhysicalDeviceVulkan12Features features12{};
+  features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+  features12.timelineSemaphore = VK_TRUE;
+  features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  features12.descriptorBindingPartiallyBound = VK_TRUE;
+  features12.runtimeDescriptorArray = VK_TRUE;
+  features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
   // Structure specifying parameters of a newly created [logical] device
   // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkDeviceCreateInfo.html
   VkDeviceCreateInfo createInfo{};
@@ -567,7 +677,7 @@ void Vulkan::UseLogicalDevice() {
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
   // NULL or a pointer to a structure extending this structure.
-  createInfo.pNext = NULL;
+  createInfo.pNext = &features12;
 
   // reserved for future use.
   createInfo.flags = static_cast<uint32_t>(0);
@@ -611,6 +721,141 @@ void Vulkan::UseLogicalDevice() {
   if (!same) {
     vkGetDeviceQueue(logicalDevice, pdqs.present.index.value(), 0, &pdqs.present.queue);
   }
+  if (ownTransferQueue) {
+    vkGetDeviceQueue(logicalDevice, pdqs.transfer.index.value(), 0, &pdqs.transfer.queue);
+  } else if (pdqs.transfer.index.has_value()) {
+    pdqs.transfer.queue = pdqs.present.queue;
+  } else {
+    // no transfer family; uploads are submitted to the graphics queue instead
+    pdqs.transfer.index = pdqs.graphics.index;
+    pdqs.transfer.queue = pdqs.graphics.queue;
+  }
+
+  allocator.Init(physicalDevice, logicalDevice);
+
+  CreatePipelineCache();
+}
+
+void Vulkan::CreatePipelineCache() {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  std::vector<char> data;
+  std::ifstream file{pipelineCacheFile, std::ios::ate | std::ios::binary};
+  if (file.is_open()) {
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    PipelineCacheFileHeader header{};
+    file.seekg(0);
+    if (fileSize >= sizeof(header) && file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      const char* reason = nullptr;
+      if (0 != memcmp(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic)) ||
+          PIPELINE_CACHE_VERSION != header.version) {
+        reason = "unrecognized format";
+      } else if (
+          header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+          0 != memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE)) {
+        reason = "different device";
+      } else if (header.driverVersion != properties.driverVersion) {
+        reason = "different driver version";
+      } else if (header.dataSize != fileSize - sizeof(header)) {
+        reason = "truncated";
+      } else {
+        data.resize(header.dataSize);
+        file.read(data.data(), data.size());
+        if (!file || Checksum(data.data(), data.size()) != header.checksum) {
+          reason = "checksum mismatch";
+          data.clear();
+        }
+      }
+      if (reason) {
+        Logger::Debugf("pipeline cache: ignoring %s; %s.", pipelineCacheFile.c_str(), reason);
+      }
+    }
+    file.close();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(logicalDevice, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+    // not fatal; the driver may still reject data which passed our checks
+    Logger::Debugf("pipeline cache: driver rejected cache data; starting cold.");
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    data.clear();
+    if (vkCreatePipelineCache(logicalDevice, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+      throw Logger::Errorf("vkCreatePipelineCache failed.");
+    }
+  }
+  pipelineCacheWarm = !data.empty();
+
+  Logger::Debugf(
+      "pipeline cache: %s, %llu bytes, loaded in %.3fms",
+      pipelineCacheWarm ? "warm" : "cold",
+      (unsigned long long)data.size(),
+      std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+          .count());
+}
+
+void Vulkan::SavePipelineCache() {
+  if (!pipelineCache) {
+    return;
+  }
+
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, nullptr) != VK_SUCCESS) {
+    Logger::Debugf("pipeline cache: vkGetPipelineCacheData failed; not saved.");
+    return;
+  }
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, data.data()) !=
+      VK_SUCCESS) {
+    Logger::Debugf("pipeline cache: vkGetPipelineCacheData failed; not saved.");
+    return;
+  }
+  data.resize(dataSize);
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  PipelineCacheFileHeader header{};
+  memcpy(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic));
+  header.version = PIPELINE_CACHE_VERSION;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  header.driverVersion = properties.driverVersion;
+  memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  header.dataSize = data.size();
+  header.checksum = Checksum(data.data(), data.size());
+
+  // write aside, then rename; so a crash mid-write never leaves a corrupt cache behind
+  const std::string tmpFile = pipelineCacheFile + ".tmp";
+  {
+    std::ofstream file{tmpFile, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+      Logger::Debugf("pipeline cache: failed to open %s; not saved.", tmpFile.c_str());
+      return;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(data.data(), data.size());
+    if (!file) {
+      Logger::Debugf("pipeline cache: failed to write %s; not saved.", tmpFile.c_str());
+      return;
+    }
+  }
+  std::remove(pipelineCacheFile.c_str());
+  if (0 != std::rename(tmpFile.c_str(), pipelineCacheFile.c_str())) {
+    Logger::Debugf("pipeline cache: failed to replace %s.", pipelineCacheFile.c_str());
+    return;
+  }
+  Logger::Debugf(
+      "pipeline cache: saved %llu bytes to %s",
+      (unsigned long long)data.size(),
+      pipelineCacheFile.c_str());
 }
 
 void Vulkan::CreateSwapChain() {
@@ -630,17 +875,18 @@ void Vulkan::CreateSwapChain() {
         "VK_FORMAT_B8G8R8A8_SRGB, colorSpace: VK_COLOR_SPACE_SRGB_NONLINEAR_KHR");
   }
 
-  bool found2 = false;
-  VkPresentModeKHR mode;
+  // FIFO is the only mode every driver must support
+  VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
   for (const auto& availablePresentMode : swapChainSupport.presentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+    if (availablePresentMode == presentMode) {
       mode = availablePresentMode;
-      found2 = true;
       break;
     }
   }
-  if (!found2) {
-    mode = VK_PRESENT_MODE_FIFO_KHR;
+  if (mode != presentMode) {
+    Logger::Debugf("present mode %s unsupported; using FIFO.", PresentModeName(presentMode));
+  } else {
+    Logger::Debugf("present mode: %s", PresentModeName(mode));
   }
 
   // TODO: Need support for macOS retina displays which means the surface resolution will be
@@ -687,12 +933,15 @@ void Vulkan::CreateSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = mode;
   createInfo.clipped = VK_TRUE;
-  // TODO: accept this as param
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // when recreating, the driver may reuse the old swap chain's resources, and frames
+  // still in flight may finish presenting to it
+  createInfo.oldSwapchain = swapChain;
 
-  if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+  VkSwapchainKHR newSwapChain = VK_NULL_HANDLE;
+  if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &newSwapChain) != VK_SUCCESS) {
     throw Logger::Errorf("vkCreateSwapchainKHR failed.");
   }
+  swapChain = newSwapChain;
 
   uint32_t receivedImageCount;
   if (vkGetSwapchainImagesKHR(logicalDevice, swapChain, &receivedImageCount, nullptr) !=
@@ -821,16 +1070,28 @@ void Vulkan::CreateDescriptorSetLayout() {
   uboLayoutBinding.pImmutableSamplers = nullptr;
   uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
+  // the bindless texture table; the vertex shader reads texture sizes, too
   VkDescriptorSetLayoutBinding samplerLayoutBinding{};
   samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorCount = 1;
+  samplerLayoutBinding.descriptorCount = MAX_TEXTURES;
   samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
   samplerLayoutBinding.pImmutableSamplers = nullptr;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
   std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  // slots past the last texture are never written; writing a slot after the set was bound
+  // leaves already-recorded command buffers valid
+  std::array<VkDescriptorBindingFlags, 2> bindingFlags = {
+      0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT};
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
   VkDescriptorSetLayoutCreateInfo layoutInfo{};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &bindingFlagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
   layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
   layoutInfo.pBindings = bindings.data();
 
@@ -850,15 +1111,35 @@ void Vulkan::CreateGraphicsPipeline(
     std::vector<u32> locations,
     std::vector<u32> formats,
     std::vector<u32> offsets) {
+  Shader s = {};
+  // TODO: Make shaders configurable via input
+  CreateGraphicsPipeline(
+      s.readFile(frag_shader),
+      s.readFile(vert_shader),
+      vertexSize,
+      instanceSize,
+      attrCount,
+      bindings,
+      locations,
+      formats,
+      offsets);
+}
+
+void Vulkan::CreateGraphicsPipeline(
+    const std::vector<char>& shader1,
+    const std::vector<char>& shader2,
+    u32 vertexSize,
+    u32 instanceSize,
+    u8 attrCount,
+    std::vector<u32> bindings,
+    std::vector<u32> locations,
+    std::vector<u32> formats,
+    std::vector<u32> offsets) {
   // NOTICE: pipeline state is immutable; you will make many of these instances
 
   vertexBuffers.resize(2);  // TODO: hard-code as std::array<,2>
-  vertexBufferMemories.resize(2);
-
-  Shader s = {};
-  // TODO: Make shaders configurable via input
-  auto shader1 = s.readFile(frag_shader);
-  auto shader2 = s.readFile(vert_shader);
+  vertexBufferAllocations.resize(2);
+  vertexBufferCapacities.resize(2);
 
   VkShaderModule vertShaderModule, fragShaderModule;
   CreateShaderModule(shader1, &fragShaderModule);
@@ -977,6 +1258,11 @@ void Vulkan::CreateGraphicsPipeline(
   colorBlending.blendConstants[2] = 1.0f;
   colorBlending.blendConstants[3] = 1.0f;
 
+  // replacing a pipeline (ie. reloaded shaders); frames in flight may still use the old one
+  if (graphicsPipeline) {
+    RetirePipeline(graphicsPipeline, pipelineLayout);
+  }
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = 1;
@@ -1005,15 +1291,22 @@ void Vulkan::CreateGraphicsPipeline(
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
   pipelineInfo.basePipelineIndex = -1;
 
+  auto start = std::chrono::high_resolution_clock::now();
   if (vkCreateGraphicsPipelines(
           logicalDevice,
-          VK_NULL_HANDLE,
+          pipelineCache,
           1,
           &pipelineInfo,
           nullptr,
           &graphicsPipeline) != VK_SUCCESS) {
     throw Logger::Errorf("vkCreateGraphicsPipelines failed.");
   }
+  // compare across runs to see what the cache saves (delete the cache file for a cold start)
+  Logger::Debugf(
+      "vkCreateGraphicsPipelines: %.3fms (%s pipeline cache)",
+      std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+          .count(),
+      pipelineCacheWarm ? "warm" : "cold");
 
   DestroyShaderModule(&vertShaderModule);
   DestroyShaderModule(&fragShaderModule);
@@ -1051,10 +1344,17 @@ void Vulkan::CreateCommandPool() {
   if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw Logger::Errorf("vkCreateCommandPool failed.");
   }
+
+  transfers.Init(
+      logicalDevice,
+      &allocator,
+      pdqs.transfer.queue,
+      pdqs.transfer.index.value(),
+      pdqs.graphics.index.value());
 }
 
 void Vulkan::CreateCommandBuffers() {
-  commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  commandBuffers.resize(framesInFlight);
 
   VkCommandBufferAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1065,6 +1365,29 @@ void Vulkan::CreateCommandBuffers() {
   if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
     throw Logger::Errorf("vkAllocateCommandBuffers failed.");
   }
+
+  // per-frame staging space; uploads are recorded into the command buffers above
+  stagingRing.Init(logicalDevice, &allocator, framesInFlight);
+
+  // cached draw commands; one per frame in flight, because each binds its own
+  // descriptor set, and may only be re-recorded once that frame's fence has signaled
+  drawCommandBuffers.resize(framesInFlight);
+  drawCommandKeys.resize(framesInFlight);
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  allocInfo.commandBufferCount = static_cast<uint32_t>(drawCommandBuffers.size());
+  if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, drawCommandBuffers.data()) !=
+      VK_SUCCESS) {
+    throw Logger::Errorf("vkAllocateCommandBuffers secondary failed.");
+  }
+
+  // draw parameters which change often (ie. instanceCount) are read from here at
+  // execution time, so they don't invalidate the cached commands
+  CreateBuffer(
+      sizeof(VkDrawIndexedIndirectCommand) * framesInFlight,
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      indirectBuffer,
+      indirectBufferAllocation);
 }
 
 void Vulkan::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
@@ -1077,6 +1400,13 @@ void Vulkan::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
     throw Logger::Errorf("vkBeginCommandBuffer failed.");
   }
 
+  // NOTICE: transfers are not allowed inside a render pass
+  transferWait = transfers.RecordAcquires(commandBuffer);
+  stagingRing.Record(currentFrame, commandBuffer);
+
+  const bool threaded = !recordContexts.empty() && drawBatches.size() > 1;
+  const bool cached = !threaded && cacheCommandBuffers && indirectBuffer && drawBatches.empty();
+
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassInfo.renderPass = renderPass;
@@ -1086,7 +1416,74 @@ void Vulkan::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
   VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
   renderPassInfo.clearValueCount = 1;
   renderPassInfo.pClearValues = &clearColor;
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(
+      commandBuffer,
+      &renderPassInfo,
+      (threaded || cached) ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                           : VK_SUBPASS_CONTENTS_INLINE);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  if (threaded) {
+    RecordDrawBatchesThreaded(commandBuffer);
+    commandCacheStats.misses++;
+    commandCacheStats.recordMs +=
+        std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+            .count();
+  } else if (cached) {
+    // host write is made visible to the indirect read by vkQueueSubmit
+    VkDrawIndexedIndirectCommand draw{};
+    draw.indexCount = drawIndexCount;
+    draw.instanceCount = instanceCount;
+    static_cast<VkDrawIndexedIndirectCommand*>(indirectBufferAllocation.mapped)[currentFrame] =
+        draw;
+
+    const DrawCommandKey key = GetDrawCommandKey();
+    if (!drawCommandKeys[currentFrame].valid || !(drawCommandKeys[currentFrame] == key)) {
+      RecordDrawCommandBuffer(drawCommandBuffers[currentFrame]);
+      drawCommandKeys[currentFrame] = key;
+      commandCacheStats.misses++;
+      commandCacheStats.recordMs +=
+          std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+              .count();
+    } else {
+      commandCacheStats.hits++;
+    }
+    vkCmdExecuteCommands(commandBuffer, 1, &drawCommandBuffers[currentFrame]);
+  } else {
+    RecordDrawCommands(commandBuffer, false);
+    commandCacheStats.misses++;
+    commandCacheStats.recordMs +=
+        std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start)
+            .count();
+  }
+
+  vkCmdEndRenderPass(commandBuffer);
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw Logger::Errorf("vkEndCommandBuffer failed.");
+  }
+}
+
+void Vulkan::RecordDrawCommands(VkCommandBuffer commandBuffer, bool indirect) {
+  RecordDrawState(commandBuffer);
+
+  if (indirect) {
+    vkCmdDrawIndexedIndirect(
+        commandBuffer,
+        indirectBuffer,
+        sizeof(VkDrawIndexedIndirectCommand) * currentFrame,
+        1,
+        sizeof(VkDrawIndexedIndirectCommand));
+  } else if (!drawBatches.empty()) {
+    for (const auto& batch : drawBatches) {
+      vkCmdDrawIndexed(commandBuffer, drawIndexCount, batch.instanceCount, 0, 0, batch.firstInstance);
+    }
+  } else {
+    vkCmdDrawIndexed(commandBuffer, drawIndexCount, instanceCount, 0, 0, 0);
+  }
+}
+
+void Vulkan::RecordDrawState(VkCommandBuffer commandBuffer) {
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
   std::vector<VkDeviceSize> offsets(vertexBuffers.size());
@@ -1124,25 +1521,199 @@ void Vulkan::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
       &descriptorSets[currentFrame],
       0,
       nullptr);
+}
 
-  vkCmdDrawIndexed(commandBuffer, drawIndexCount, instanceCount, 0, 0, 0);
+bool Vulkan::BeginSecondaryCommandBuffer(
+    VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags) {
+  // framebuffer is left unspecified, so one recording is valid for every swap chain image
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = VK_NULL_HANDLE;
 
-  vkCmdEndRenderPass(commandBuffer);
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | flags;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  return vkBeginCommandBuffer(commandBuffer, &beginInfo) == VK_SUCCESS;
+}
+
+void Vulkan::RecordDrawCommandBuffer(VkCommandBuffer commandBuffer) {
+  // NOTICE: implicitly resets; pool was created with RESET_COMMAND_BUFFER_BIT
+  if (!BeginSecondaryCommandBuffer(commandBuffer, 0)) {
+    throw Logger::Errorf("vkBeginCommandBuffer secondary failed.");
+  }
+
+  RecordDrawCommands(commandBuffer, true);
 
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-    throw Logger::Errorf("vkEndCommandBuffer failed.");
+    throw Logger::Errorf("vkEndCommandBuffer secondary failed.");
+  }
+}
+
+void Vulkan::EnableThreadedRecording(Jobs& jobs) {
+  if (!recordContexts.empty()) {
+    return;
+  }
+  recordJobs = &jobs;
+  // one per worker, and one for threads outside the pool
+  const u32 workers = jobs.WorkerCount() + 1;
+
+  // NOTICE: a command pool (and its buffers) may only be used by one thread at a time,
+  // so every (frame in flight, worker) pair gets its own.
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = pdqs.graphics.index.value();
+
+  recordContexts.resize(framesInFlight);
+  for (auto& frame : recordContexts) {
+    frame.resize(workers);
+    for (auto& ctx : frame) {
+      if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &ctx.pool) != VK_SUCCESS) {
+        throw Logger::Errorf("vkCreateCommandPool for recording thread failed.");
+      }
+    }
   }
 }
 
+void Vulkan::RecordDrawBatchesThreaded(VkCommandBuffer commandBuffer) {
+  auto& contexts = recordContexts[currentFrame];
+  const u32 batchCount = drawBatches.size();
+  const u32 jobCount = Min(batchCount, static_cast<u32>(contexts.size()));
+
+  // this frame's fence has signaled, so its pools are no longer in use by the GPU.
+  // resetting the pool is cheaper than resetting each buffer.
+  for (auto& ctx : contexts) {
+    vkResetCommandPool(logicalDevice, ctx.pool, 0);
+    ctx.used = 0;
+  }
+
+  std::vector<VkCommandBuffer> recorded(jobCount);
+  std::atomic<bool> failed = false;
+  auto record = [&](u32 job) {
+    const u32 worker = recordJobs->CurrentWorker();
+    // pool workers each have their own context; every other thread shares the last
+    std::unique_lock<std::mutex> external(externalRecordMutex, std::defer_lock);
+    if (worker == recordJobs->WorkerCount()) {
+      external.lock();
+    }
+    auto& ctx = contexts[worker];
+    if (ctx.used == ctx.buffers.size()) {
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandPool = ctx.pool;
+      allocInfo.commandBufferCount = 1;
+      VkCommandBuffer cb;
+      if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &cb) != VK_SUCCESS) {
+        failed = true;
+        return;
+      }
+      ctx.buffers.push_back(cb);
+    }
+    VkCommandBuffer cb = ctx.buffers[ctx.used++];
+
+    if (!BeginSecondaryCommandBuffer(cb, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) {
+      failed = true;
+      return;
+    }
+    // state is not inherited by secondaries; every one binds its own
+    RecordDrawState(cb);
+    // contiguous, disjoint slices of the batch list
+    const u32 first = (u64)batchCount * job / jobCount;
+    const u32 last = (u64)batchCount * (job + 1) / jobCount;
+    for (u32 i = first; i < last; i++) {
+      const auto& batch = drawBatches[i];
+      vkCmdDrawIndexed(cb, drawIndexCount, batch.instanceCount, 0, 0, batch.firstInstance);
+    }
+    if (vkEndCommandBuffer(cb) != VK_SUCCESS) {
+      failed = true;
+      return;
+    }
+    recorded[job] = cb;
+  };
+  // the caller records too, while it waits
+  recordJobs->Wait(recordJobs->ParallelFor(0, jobCount, 1, [&](u32 begin, u32 end) {
+    for (u32 job = begin; job < end; job++) {
+      record(job);
+    }
+  }));
+
+  if (failed) {
+    throw Logger::Errorf("threaded command recording failed.");
+  }
+
+  // stitch, in batch order
+  vkCmdExecuteCommands(commandBuffer, jobCount, recorded.data());
+}
+
+Vulkan::DrawCommandKey Vulkan::GetDrawCommandKey() const {
+  DrawCommandKey key{};
+  key.valid = true;
+  key.renderPass = renderPass;
+  key.pipeline = graphicsPipeline;
+  key.vertexBuffers = vertexBuffers;
+  key.indexBuffer = indexBuffer;
+  key.descriptorSet = descriptorSets[currentFrame];
+  key.viewport = {viewportX, viewportY, viewportWidth, viewportHeight};
+  key.extent = {swapChainExtent.width, swapChainExtent.height};
+  return key;
+}
+
+bool Vulkan::DrawCommandKey::operator==(const DrawCommandKey& other) const {
+  return renderPass == other.renderPass && pipeline == other.pipeline &&
+         vertexBuffers == other.vertexBuffers && indexBuffer == other.indexBuffer &&
+         descriptorSet == other.descriptorSet && viewport == other.viewport &&
+         extent == other.extent;
+}
+
+void Vulkan::InvalidateCommandBuffers() {
+  for (auto& key : drawCommandKeys) {
+    key.valid = false;
+  }
+}
+
+void Vulkan::LogCommandCacheStats() const {
+  const u64 frames = commandCacheStats.hits + commandCacheStats.misses;
+  if (0 == frames) {
+    return;
+  }
+  const f64 avgRecordMs =
+      commandCacheStats.misses > 0 ? commandCacheStats.recordMs / commandCacheStats.misses : 0;
+  Logger::Debugf(
+      "command cache: hits: %llu, misses: %llu, avg record: %.4fms",
+      (unsigned long long)commandCacheStats.hits,
+      (unsigned long long)commandCacheStats.misses,
+      avgRecordMs);
+  Logger::Debugf(
+      "command cache: est. CPU saved: %.4fms/frame",
+      avgRecordMs * commandCacheStats.hits / frames);
+}
+
 void Vulkan::CreateSyncObjects() {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  imageAvailableSemaphores.resize(framesInFlight);
+  renderFinishedSemaphores.resize(framesInFlight);
 
   VkSemaphoreCreateInfo semaphoreInfo{};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  for (uint8_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // one timeline for all frames in flight, instead of a fence each; the CPU can query
+  // how far the GPU has come without waiting (see CompletedFrames())
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = frameNumber;
+  VkSemaphoreCreateInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  timelineInfo.pNext = &typeInfo;
+  if (vkCreateSemaphore(logicalDevice, &timelineInfo, nullptr, &frameTimeline) != VK_SUCCESS) {
+    throw Logger::Errorf("vkCreateSemaphore frameTimeline failed.");
+  }
+
+  for (uint8_t i = 0; i < framesInFlight; i++) {
     if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
         VK_SUCCESS) {
       throw Logger::Errorf("vkCreateSemaphore imageAvailableSemaphore failed.");
@@ -1151,15 +1722,29 @@ void Vulkan::CreateSyncObjects() {
         VK_SUCCESS) {
       throw Logger::Errorf("vkCreateSemaphore renderFinishedSemaphore failed.");
     }
+  }
+}
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    // begin in signaled state; makes loop logic easy on first pass
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+u64 Vulkan::CompletedFrames() const {
+  u64 value = 0;
+  if (!frameTimeline) {
+    // before CreateSyncObjects(); nothing was drawn yet
+    return value;
+  }
+  if (vkGetSemaphoreCounterValue(logicalDevice, frameTimeline, &value) != VK_SUCCESS) {
+    throw Logger::Errorf("vkGetSemaphoreCounterValue frameTimeline failed.");
+  }
+  return value;
+}
 
-    if (vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-      throw Logger::Errorf("vkCreateFence inFlightFence failed.");
-    }
+void Vulkan::AwaitCompletedFrames(u64 count) {
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &frameTimeline;
+  waitInfo.pValues = &count;
+  if (vkWaitSemaphores(logicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+    throw Logger::Errorf("vkWaitSemaphores frameTimeline failed.");
   }
 }
 
@@ -1168,7 +1753,8 @@ void Vulkan::CreateBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer& buffer,
-    VkDeviceMemory& bufferMemory) {
+    VulkanAllocation& bufferAllocation,
+    AllocationStrategy strategy) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -1182,19 +1768,22 @@ void Vulkan::CreateBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(logicalDevice, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+  // NOTICE: The maximum number of simultaneous memory allocations is limited by
+  // maxMemoryAllocationCount, so we sub-allocate from large blocks instead.
+  bufferAllocation = allocator.Allocate(memRequirements, properties, ResourceKind::Buffer, strategy);
 
-  // TODO: The maximum number of simultaneous memory allocations is limited by the
-  // maxMemoryAllocationCount So when objects on screen become too numerous, create a custom
-  // allocator
-  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw Logger::Errorf("failed to allocate buffer memory!");
+  if (vkBindBufferMemory(logicalDevice, buffer, bufferAllocation.memory, bufferAllocation.offset) !=
+      VK_SUCCESS) {
+    throw Logger::Errorf("failed to bind buffer memory!");
   }
+}
 
-  vkBindBufferMemory(logicalDevice, buffer, bufferMemory, 0);
+void Vulkan::DestroyBuffer(VkBuffer& buffer, VulkanAllocation& bufferAllocation) {
+  if (buffer) {
+    vkDestroyBuffer(logicalDevice, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+  }
+  allocator.Free(bufferAllocation);
 }
 
 VkCommandBuffer Vulkan::BeginSingleTimeCommands() {
@@ -1213,10 +1802,46 @@ VkCommandBuffer Vulkan::BeginSingleTimeCommands() {
 
   vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
+  // the commands may touch a resource the transfer queue has just released
+  transferWait = transfers.RecordAcquires(commandBuffer);
+
+  // WAR: frames in flight may still be reading what these commands overwrite
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
   return commandBuffer;
 }
 
 void Vulkan::EndSingleTimeCommands(VkCommandBuffer commandBuffer) {
+  // nothing waits for this submit; later submits see its writes through this barrier
+  VkMemoryBarrier written{};
+  written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  written.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  written.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                          VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                          VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0,
+      1,
+      &written,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
   vkEndCommandBuffer(commandBuffer);
 
   VkSubmitInfo submitInfo{};
@@ -1224,10 +1849,26 @@ void Vulkan::EndSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(pdqs.graphics.queue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(pdqs.graphics.queue);
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  if (transferWait.value > 0) {
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &transferWait.value;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &transferWait.semaphore;
+    submitInfo.pWaitDstStageMask = &transferWait.stages;
+  }
+
+  if (vkQueueSubmit(pdqs.graphics.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw Logger::Errorf("vkQueueSubmit single time commands failed.");
+  }
+  transferWait = {};
 
-  vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+  // the current frame's timeline signal comes after this submit, so covers it, too
+  Retire([this, commandBuffer] {
+    vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+  });
 }
 
 void Vulkan::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -1240,198 +1881,270 @@ void Vulkan::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize siz
   EndSingleTimeCommands(commandBuffer);
 }
 
-void Vulkan::TransitionImageLayout(
-    VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-
-  VkPipelineStageFlags sourceStage;
-  VkPipelineStageFlags destinationStage;
-
-  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (
-      oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-      newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  } else {
-    throw Logger::Errorf("unsupported layout transition!");
-  }
-
-  vkCmdPipelineBarrier(
-      commandBuffer,
-      sourceStage,
-      destinationStage,
-      0,
-      0,
-      nullptr,
-      0,
-      nullptr,
-      1,
-      &barrier);
-
-  EndSingleTimeCommands(commandBuffer);
-}
-
-void Vulkan::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-  VkBufferImageCopy region{};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
-
-  vkCmdCopyBufferToImage(
-      commandBuffer,
-      buffer,
-      image,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      1,
-      &region);
-
-  EndSingleTimeCommands(commandBuffer);
-}
-
 void Vulkan::CreateVertexBuffer(u8 idx, u64 size, const void* indata) {
   VkDeviceSize bufferSize = size;
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
   CreateBuffer(
       bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      stagingBuffer,
-      stagingBufferMemory);
+      // TRANSFER_SRC so contents can be carried over when the buffer grows
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      vertexBuffers[idx],
+      vertexBufferAllocations[idx]);
+  vertexBufferCapacities[idx] = bufferSize;
 
-  void* data;
-  vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indata, (size_t)bufferSize);
-  vkUnmapMemory(logicalDevice, stagingBufferMemory);
+  if (nullptr == indata) {
+    return;
+  }
+  transfers.UploadBuffer(vertexBuffers[idx], indata, bufferSize);
+}
+
+void Vulkan::ReserveVertexBuffer(u8 idx, u64 size) {
+  const VkDeviceSize oldCapacity = vertexBufferCapacities[idx];
+  if (size <= oldCapacity) {
+    return;
+  }
+  // grow geometrically, so N appends cost O(log N) reallocations
+  VkDeviceSize capacity = Max(oldCapacity, (VkDeviceSize)1);
+  while (capacity < size) {
+    capacity *= 2;
+  }
 
+  VkBuffer oldBuffer = vertexBuffers[idx];
+  VulkanAllocation oldAllocation = vertexBufferAllocations[idx];
   CreateBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      capacity,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
       vertexBuffers[idx],
-      vertexBufferMemories[idx]);
+      vertexBufferAllocations[idx]);
+  vertexBufferCapacities[idx] = capacity;
+
+  Logger::Debugf(
+      "vertex buffer %u grew from %llu to %llu bytes.",
+      idx,
+      (unsigned long long)oldCapacity,
+      (unsigned long long)capacity);
 
-  CopyBuffer(stagingBuffer, vertexBuffers[idx], bufferSize);
+  if (VK_NULL_HANDLE == oldBuffer) {
+    return;
+  }
 
-  vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-  vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+  // carry over old contents; ordered after copies already staged into the old buffer,
+  // and before any staged into the new one
+  OpenStagingPartition();
+  VkBufferCopy copyRegion{};
+  copyRegion.size = oldCapacity;
+  if (!stagingRing.StageBufferCopy(currentFrame, oldBuffer, vertexBuffers[idx], copyRegion)) {
+    CopyBuffer(oldBuffer, vertexBuffers[idx], oldCapacity);
+  }
+
+  // frames in flight (and this frame's copy) still read the old buffer; it is
+  // destroyed once this frame has finished. rebinding is implicit, since
+  // RecordCommandBuffer() binds vertexBuffers[] every frame.
+  RetireBuffer(oldBuffer, oldAllocation);
 }
 
-void Vulkan::UpdateVertexBuffer(u8 idx, u64 size, const void* indata) {
-  VkDeviceSize bufferSize = size;
+void Vulkan::DestroyRetired(bool all) {
+  if (all) {
+    deletionQueue.Flush();
+  } else if (deletionQueue.Size() > 0) {
+    deletionQueue.Collect(CompletedFrames());
+  }
+}
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  CreateBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      stagingBuffer,
-      stagingBufferMemory);
+void Vulkan::Retire(VulkanDeletionQueue::Destroyer destroy) {
+  deletionQueue.Push(frameNumber, std::move(destroy));
+}
 
-  void* data;
-  vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indata, (size_t)bufferSize);
-  vkUnmapMemory(logicalDevice, stagingBufferMemory);
+void Vulkan::Retire(VulkanDeletionQueue::Destroyer destroy, u64 lastFrame) {
+  deletionQueue.Push(lastFrame, std::move(destroy));
+}
 
-  CopyBuffer(stagingBuffer, vertexBuffers[idx], bufferSize);
+void Vulkan::RetireBuffer(VkBuffer& buffer, VulkanAllocation& allocation) {
+  VkBuffer retired = buffer;
+  VulkanAllocation retiredAllocation = allocation;
+  buffer = VK_NULL_HANDLE;
+  allocation = {};
+  Retire([this, retired, retiredAllocation]() mutable {
+    DestroyBuffer(retired, retiredAllocation);
+  });
+}
 
-  vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-  vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+void Vulkan::RetireImage(VkImage& image, VulkanAllocation& allocation) {
+  VkImage retired = image;
+  VulkanAllocation retiredAllocation = allocation;
+  image = VK_NULL_HANDLE;
+  allocation = {};
+  Retire([this, retired, retiredAllocation]() mutable {
+    vkDestroyImage(logicalDevice, retired, nullptr);
+    allocator.Free(retiredAllocation);
+  });
 }
 
-uint32_t Vulkan::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+void Vulkan::RetireImageView(VkImageView& view) {
+  if (!view) {
+    return;
+  }
+  VkImageView retired = view;
+  view = VK_NULL_HANDLE;
+  Retire([this, retired] { vkDestroyImageView(logicalDevice, retired, nullptr); });
+}
+
+void Vulkan::RetireSampler(VkSampler& sampler) {
+  if (!sampler) {
+    return;
+  }
+  VkSampler retired = sampler;
+  sampler = VK_NULL_HANDLE;
+  Retire([this, retired] { vkDestroySampler(logicalDevice, retired, nullptr); });
+}
 
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) &&
-        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
+void Vulkan::RetirePipeline(VkPipeline& pipeline, VkPipelineLayout& layout) {
+  VkPipeline retired = pipeline;
+  VkPipelineLayout retiredLayout = layout;
+  pipeline = VK_NULL_HANDLE;
+  layout = VK_NULL_HANDLE;
+  Retire([this, retired, retiredLayout] {
+    if (retired) {
+      vkDestroyPipeline(logicalDevice, retired, nullptr);
     }
+    if (retiredLayout) {
+      vkDestroyPipelineLayout(logicalDevice, retiredLayout, nullptr);
+    }
+  });
+}
+
+void Vulkan::OpenStagingPartition() {
+  if (frameTimeline && !stagingRing.IsOpen(currentFrame)) {
+    // called outside of AwaitNextFrame() -> DrawFrame(); the partition may still be
+    // in use by the GPU. this is the same wait AwaitNextFrame() would do.
+    AwaitFrameSlot();
+    stagingRing.Open(currentFrame);
   }
+}
 
-  throw Logger::Errorf("failed to find suitable memory type!");
+void Vulkan::UpdateVertexBuffer(u8 idx, u64 size, const void* indata) {
+  UpdateVertexBufferRanges(idx, indata, {{0, size}});
 }
 
-void Vulkan::CreateIndexBuffer(u64 size, const void* indata) {
-  VkDeviceSize bufferSize = size;
+void Vulkan::UpdateVertexBufferRanges(
+    u8 idx, const void* indata, const std::vector<ByteRange>& ranges) {
+  u64 end = 0;
+  for (const auto& range : ranges) {
+    end = Max(end, range.offset + range.size);
+  }
+  ReserveVertexBuffer(idx, end);
+
+  OpenStagingPartition();
+
+  // fast path: copies are recorded into this frame's command buffer; no CPU stall
+  size_t i = 0;
+  for (; i < ranges.size(); i++) {
+    if (!stagingRing.Stage(
+            currentFrame,
+            vertexBuffers[idx],
+            ranges[i].offset,
+            static_cast<const u8*>(indata) + ranges[i].offset,
+            ranges[i].size)) {
+      break;
+    }
+  }
+  if (i == ranges.size()) {
+    return;
+  }
+
+  // slow path: remaining ranges are too large for the ring
+  VkDeviceSize bufferSize = 0;
+  for (size_t j = i; j < ranges.size(); j++) {
+    bufferSize += ranges[j].size;
+  }
 
   VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
+  VulkanAllocation stagingBufferAllocation;
   CreateBuffer(
       bufferSize,
       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
       stagingBuffer,
-      stagingBufferMemory);
+      stagingBufferAllocation,
+      AllocationStrategy::Linear);
+
+  std::vector<VkBufferCopy> copyRegions(ranges.size() - i);
+  VkDeviceSize srcOffset = 0;
+  for (size_t j = i; j < ranges.size(); j++) {
+    memcpy(
+        static_cast<u8*>(stagingBufferAllocation.mapped) + srcOffset,
+        static_cast<const u8*>(indata) + ranges[j].offset,
+        (size_t)ranges[j].size);
+    copyRegions[j - i].srcOffset = srcOffset;
+    copyRegions[j - i].dstOffset = ranges[j].offset;
+    copyRegions[j - i].size = ranges[j].size;
+    srcOffset += ranges[j].size;
+  }
+
+  if (stagingRing.IsOpen(currentFrame)) {
+    // queued behind anything already staged this frame, including by earlier updates, so
+    // older data can't land on top of newer; copied by this frame's command buffer
+    for (const auto& region : copyRegions) {
+      stagingRing.StageBufferCopy(currentFrame, stagingBuffer, vertexBuffers[idx], region);
+    }
+  } else {
+    // OpenStagingPartition() leaves it closed only before the ring exists (ie. during
+    // setup). a one-time submit runs ahead of this frame's copies, so it's only safe
+    // while there are none.
+    if (stagingRing.HasPending(currentFrame)) {
+      throw Logger::Errorf("vertex buffer %u: copies staged in a closed partition.", idx);
+    }
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+    vkCmdCopyBuffer(
+        commandBuffer,
+        stagingBuffer,
+        vertexBuffers[idx],
+        static_cast<u32>(copyRegions.size()),
+        copyRegions.data());
+    EndSingleTimeCommands(commandBuffer);
+  }
 
-  void* data;
-  vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indata, (size_t)bufferSize);
-  vkUnmapMemory(logicalDevice, stagingBufferMemory);
+  RetireBuffer(stagingBuffer, stagingBufferAllocation);
+}
+
+uint32_t Vulkan::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  return allocator.FindMemoryType(typeFilter, properties);
+}
+
+void Vulkan::CreateIndexBuffer(u64 size, const void* indata) {
+  VkDeviceSize bufferSize = size;
 
   CreateBuffer(
       bufferSize,
       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
       indexBuffer,
-      indexBufferMemory);
-
-  CopyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-  vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-  vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+      indexBufferAllocation);
+  transfers.UploadBuffer(indexBuffer, indata, bufferSize);
 }
 
 void Vulkan::CreateUniformBuffers(const unsigned int length) {
   VkDeviceSize bufferSize = length;
-  uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBufferLengths.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+  uniformBuffers.resize(framesInFlight);
+  uniformBufferLengths.resize(framesInFlight);
+  uniformBufferAllocations.resize(framesInFlight);
+  uniformBuffersMapped.resize(framesInFlight);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
     uniformBufferLengths[i] = length;
     CreateBuffer(
         bufferSize,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         uniformBuffers[i],
-        uniformBuffersMemory[i]);
+        uniformBufferAllocations[i]);
 
-    vkMapMemory(logicalDevice, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+    // host-visible blocks are persistently mapped by the allocator
+    uniformBuffersMapped[i] = uniformBufferAllocations[i].mapped;
   }
 }
 
@@ -1442,15 +2155,16 @@ void Vulkan::UpdateUniformBuffer(uint32_t frame, void* ubo) {
 void Vulkan::CreateDescriptorPool() {
   std::array<VkDescriptorPoolSize, 2> poolSizes{};
   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  poolSizes[0].descriptorCount = static_cast<uint32_t>(framesInFlight);
   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  poolSizes[1].descriptorCount = static_cast<uint32_t>(framesInFlight) * MAX_TEXTURES;
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
   poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
   poolInfo.pPoolSizes = poolSizes.data();
-  poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  poolInfo.maxSets = static_cast<uint32_t>(framesInFlight);
 
   if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
     throw Logger::Errorf("failed to create descriptor pool!");
@@ -1458,29 +2172,33 @@ void Vulkan::CreateDescriptorPool() {
 }
 
 void Vulkan::CreateDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+  std::vector<VkDescriptorSetLayout> layouts(framesInFlight, descriptorSetLayout);
   VkDescriptorSetAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   allocInfo.descriptorPool = descriptorPool;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  allocInfo.descriptorSetCount = static_cast<uint32_t>(framesInFlight);
   allocInfo.pSetLayouts = layouts.data();
 
-  descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+  descriptorSets.resize(framesInFlight);
   if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
     throw Logger::Errorf("failed to allocate descriptor sets!");
   }
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  std::vector<VkDescriptorImageInfo> imageInfos{};
+  for (const auto& texture : textures) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = texture.view;
+    imageInfo.sampler = textureSampler;
+    imageInfos.push_back(imageInfo);
+  }
+
+  for (size_t i = 0; i < framesInFlight; i++) {
     VkDescriptorBufferInfo bufferInfo{};
     bufferInfo.buffer = uniformBuffers[i];
     bufferInfo.offset = 0;
     bufferInfo.range = uniformBufferLengths[i];
 
-    VkDescriptorImageInfo imageInfo{};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = textureImageView;
-    imageInfo.sampler = textureSampler;
-
     std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
     descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1491,50 +2209,128 @@ void Vulkan::CreateDescriptorSets() {
     descriptorWrites[0].descriptorCount = 1;
     descriptorWrites[0].pBufferInfo = &bufferInfo;
 
+    // every texture so far, from slot 0; the rest of the table stays unwritten
     descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[1].dstSet = descriptorSets[i];
     descriptorWrites[1].dstBinding = 1;
     descriptorWrites[1].dstArrayElement = 0;
     descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pImageInfo = &imageInfo;
+    descriptorWrites[1].descriptorCount = static_cast<uint32_t>(imageInfos.size());
+    descriptorWrites[1].pImageInfo = imageInfos.data();
 
     vkUpdateDescriptorSets(
         logicalDevice,
-        static_cast<uint32_t>(descriptorWrites.size()),
+        imageInfos.empty() ? 1 : static_cast<uint32_t>(descriptorWrites.size()),
         descriptorWrites.data(),
         0,
         nullptr);
   }
+  staleTextureSlots.assign(framesInFlight, {});
+}
+
+void Vulkan::MarkTextureStale(u32 slot) {
+  // the sets in use by frames in flight can't be written; each is written once its frame
+  // slot comes around again
+  for (auto& slots : staleTextureSlots) {
+    slots.push_back(slot);
+  }
+}
+
+void Vulkan::UpdateTextureDescriptors() {
+  if (currentFrame >= staleTextureSlots.size() || staleTextureSlots[currentFrame].empty()) {
+    return;
+  }
+  auto& slots = staleTextureSlots[currentFrame];
+
+  std::vector<VkDescriptorImageInfo> imageInfos(slots.size());
+  std::vector<VkWriteDescriptorSet> descriptorWrites(slots.size());
+  for (u32 i = 0; i < slots.size(); i++) {
+    imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[i].imageView = textures[slots[i]].view;
+    imageInfos[i].sampler = textureSampler;
+
+    descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[i].dstSet = descriptorSets[currentFrame];
+    descriptorWrites[i].dstBinding = 1;
+    descriptorWrites[i].dstArrayElement = slots[i];
+    descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[i].descriptorCount = 1;
+    descriptorWrites[i].pImageInfo = &imageInfos[i];
+  }
+  // update-after-bind; cached draw commands which bind this set stay valid
+  vkUpdateDescriptorSets(
+      logicalDevice,
+      static_cast<uint32_t>(descriptorWrites.size()),
+      descriptorWrites.data(),
+      0,
+      nullptr);
+  slots.clear();
 }
 
 /**
  * Load an image from disk. Queue it to Vulkan -> Buffer -> Image.
  */
-void Vulkan::CreateTextureImage(const char* file) {
+Vulkan::DecodedImage Vulkan::DecodeImage(const char* file) {
   int texWidth, texHeight, texChannels;
   stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
 
   if (!pixels) {
     throw Logger::Errorf("failed to load texture image!");
   }
+  return {pixels, static_cast<u32>(texWidth), static_cast<u32>(texHeight)};
+}
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  CreateBuffer(
-      imageSize,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      stagingBuffer,
-      stagingBufferMemory);
+void Vulkan::FreeImage(DecodedImage& image) {
+  if (image.pixels) {
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+  }
+}
 
-  void* data;
-  vkMapMemory(logicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
-  vkUnmapMemory(logicalDevice, stagingBufferMemory);
+u32 Vulkan::CreateTexture(const char* file) {
+  DecodedImage image = DecodeImage(file);
+  u32 slot;
+  try {
+    slot = CreateTexture(image);
+  } catch (...) {
+    FreeImage(image);
+    throw;
+  }
+  FreeImage(image);
+  return slot;
+}
 
-  stbi_image_free(pixels);
+u32 Vulkan::CreateTexture(const DecodedImage& image) {
+  if (textures.size() >= MAX_TEXTURES) {
+    throw Logger::Errorf("texture table is full; at most %u textures.", MAX_TEXTURES);
+  }
+  const u32 slot = static_cast<u32>(textures.size());
+  textures.push_back({});
+  UploadTexture(textures[slot], image);
+  MarkTextureStale(slot);
+  return slot;
+}
+
+void Vulkan::ReplaceTexture(u32 slot, const DecodedImage& image) {
+  if (slot >= textures.size()) {
+    throw Logger::Errorf("no texture in slot %u.", slot);
+  }
+  // frames in flight may still sample the old one
+  RetireImageView(textures[slot].view);
+  RetireImage(textures[slot].image, textures[slot].allocation);
+  UploadTexture(textures[slot], image);
+  MarkTextureStale(slot);
+}
+
+u32 Vulkan::TextureCount() const {
+  return static_cast<u32>(textures.size());
+}
+
+void Vulkan::UploadTexture(Texture& texture, const DecodedImage& image) {
+  const u8* pixels = image.pixels;
+  const u32 texWidth = image.width;
+  const u32 texHeight = image.height;
+  VkDeviceSize imageSize = texWidth * texHeight * 4;
 
   CreateImage(
       texWidth,
@@ -1543,34 +2339,21 @@ void Vulkan::CreateTextureImage(const char* file) {
       VK_IMAGE_TILING_OPTIMAL,
       VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-      textureImage,
-      textureImageMemory);
-
-  TransitionImageLayout(
-      textureImage,
-      VK_FORMAT_R8G8B8A8_SRGB,
-      VK_IMAGE_LAYOUT_UNDEFINED,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  CopyBufferToImage(
-      stagingBuffer,
-      textureImage,
-      static_cast<uint32_t>(texWidth),
-      static_cast<uint32_t>(texHeight));
-  TransitionImageLayout(
-      textureImage,
-      VK_FORMAT_R8G8B8A8_SRGB,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-  vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-  vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
-}
+      texture.image,
+      texture.allocation);
+  texture.view = CreateImageView(texture.image, VK_FORMAT_R8G8B8A8_SRGB);
 
-void Vulkan::CreateTextureImageView() {
-  textureImageView = CreateImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB);
+  // the next frame acquires it; nothing waits here
+  transfers.UploadImage(texture.image, pixels, imageSize, texWidth, texHeight);
 }
 
 void Vulkan::CreateTextureSampler() {
+  // shared by every texture
+  RetireSampler(textureSampler);
+  for (u32 slot = 0; slot < textures.size(); slot++) {
+    MarkTextureStale(slot);
+  }
+
   VkPhysicalDeviceProperties properties{};
   vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
@@ -1623,7 +2406,7 @@ void Vulkan::CreateImage(
     VkImageUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkImage& image,
-    VkDeviceMemory& imageMemory) {
+    VulkanAllocation& imageAllocation) {
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -1646,22 +2429,33 @@ void Vulkan::CreateImage(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(logicalDevice, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+  imageAllocation = allocator.Allocate(memRequirements, properties, ResourceKind::Image);
 
-  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw Logger::Errorf("failed to allocate image memory!");
+  if (vkBindImageMemory(logicalDevice, image, imageAllocation.memory, imageAllocation.offset) !=
+      VK_SUCCESS) {
+    throw Logger::Errorf("failed to bind image memory!");
   }
+}
 
-  vkBindImageMemory(logicalDevice, image, imageMemory, 0);
+void Vulkan::AwaitFrameSlot() {
+  // currentFrame's resources were last used by the frame framesInFlight before this one
+  if (frameNumber >= framesInFlight) {
+    AwaitCompletedFrames(frameNumber - framesInFlight + 1);
+  }
 }
 
-void Vulkan::AwaitNextFrame() {
-  if (vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX) !=
-      VK_SUCCESS) {
-    throw Logger::Errorf("vkWaitForFences failed.");
+bool Vulkan::AwaitNextFrame() {
+  AwaitFrameSlot();
+  // this frame's staging partition is no longer in use by the GPU
+  if (!stagingRing.IsOpen(currentFrame)) {
+    stagingRing.Open(currentFrame);
+  }
+  DestroyRetired(false);
+  transfers.Collect();
+
+  // skipped while the surface was 0x0
+  if (swapChainStale && !RecreateSwapChain()) {
+    return false;
   }
 
   VkResult result = vkAcquireNextImageKHR(
@@ -1676,43 +2470,69 @@ void Vulkan::AwaitNextFrame() {
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     // If the swap chain turns out to be out of date when attempting to acquire an image,
     // then it is no longer possible to present to it.
-    // Therefore we should immediately recreate the swap chain
-    RecreateSwapChain();
-    // and try again in the next drawFrame call.
-    return;
+    // Therefore we should immediately recreate the swap chain,
+    if (!RecreateSwapChain()) {
+      return false;
+    }
+    // and try again; DrawFrame() waits on the semaphore an acquire signals.
+    result = vkAcquireNextImageKHR(
+        logicalDevice,
+        swapChain,
+        UINT64_MAX,
+        imageAvailableSemaphores[currentFrame],
+        VK_NULL_HANDLE,
+        &imageIndex);
+  }
+  if (result == VK_SUBOPTIMAL_KHR) {
+    // still presentable; recreate after this frame's present
+    framebufferResized = true;
   } else if (result != VK_SUCCESS) {
     throw Logger::Errorf("vkAcquireNextImageKHR failed.");
   }
+  return true;
 }
 
 void Vulkan::DrawFrame() {
-  // NOTICE: Fence will deadlock if waiting on an empty work queue.
-  // Therefore, we only reset the fence just prior to submitting work.
-  vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
-
   if (vkResetCommandBuffer(commandBuffers[currentFrame], 0) != VK_SUCCESS) {
     throw Logger::Errorf("vkResetCommandBuffer failed.");
   }
+  // AwaitNextFrame() has waited for this frame slot, so its descriptor set is free
+  UpdateTextureDescriptors();
 
   RecordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  // the second wait is only used when this frame acquires uploads from the transfer queue
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame], transferWait.semaphore};
+  VkPipelineStageFlags waitStages[] = {
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      transferWait.stages};
+  // binary semaphores ignore their value
+  const u64 waitValues[] = {0, transferWait.value};
+  submitInfo.waitSemaphoreCount = transferWait.value > 0 ? 2 : 1;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
+  transferWait = {};
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  // present waits on the first; the second marks this frame finished on the timeline
+  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], frameTimeline};
+  const u64 signalValues[] = {0, frameNumber + 1};
+  submitInfo.signalSemaphoreCount = 2;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  if (vkQueueSubmit(pdqs.graphics.queue, 1, &submitInfo, inFlightFences[currentFrame]) !=
-      VK_SUCCESS) {
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+  timelineInfo.signalSemaphoreValueCount = 2;
+  timelineInfo.pSignalSemaphoreValues = signalValues;
+  submitInfo.pNext = &timelineInfo;
+
+  if (vkQueueSubmit(pdqs.graphics.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
     throw Logger::Errorf("vkQueueSubmit failed.");
   }
 
@@ -1744,40 +2564,100 @@ void Vulkan::DrawFrame() {
     throw Logger::Errorf(err1);
   }
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % framesInFlight;
+  frameNumber++;
 }
 
 void Vulkan::DeviceWaitIdle() {
   vkDeviceWaitIdle(logicalDevice);
 }
 
-void Vulkan::RecreateSwapChain() {
-  // TODO: the disadvantage of this approach is that we need to stop all rendering before creating
-  // the new swap chain. It is possible to create a new swap chain while drawing commands on an
-  // image from the old swap chain are still in-flight. You need to pass the previous swap chain to
-  // the oldSwapChain field in the VkSwapchainCreateInfoKHR struct and destroy the old swap chain as
-  // soon as you've finished using it.
+bool Vulkan::RecreateSwapChain() {
+  // the new swap chain is created while frames drawn to the old one are still in flight;
+  // the old one is destroyed once they've finished, so rendering never stops to drain
+  const auto begin = std::chrono::high_resolution_clock::now();
 
-  DeviceWaitIdle();
+  // current, rather than as of device selection; a minimized window's surface is 0x0,
+  // and no swap chain can be created for it
+  if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+          physicalDevice, surface, &swapChainSupport.capabilities) != VK_SUCCESS) {
+    throw Logger::Errorf("vkGetPhysicalDeviceSurfaceCapabilitiesKHR() failed.");
+  }
+  const VkExtent2D surfaceExtent = swapChainSupport.capabilities.currentExtent;
+  if (0 == bufferWidth || 0 == bufferHeight || 0 == surfaceExtent.width ||
+      0 == surfaceExtent.height) {
+    minimized = true;
+    swapChainStale = true;
+    return false;
+  }
+  if (drainOnRecreate) {
+    DeviceWaitIdle();
+  }
 
-  CleanupSwapChain();
+  // swapChain stays valid until the new one is created; it's passed as oldSwapchain
+  VkSwapchainKHR oldSwapChain = swapChain;
+  std::vector<VkImageView> oldImageViews;
+  std::vector<VkFramebuffer> oldFramebuffers;
+  oldImageViews.swap(swapChainImageViews);
+  oldFramebuffers.swap(swapChainFramebuffers);
 
   CreateSwapChain();
   CreateImageViews();
   CreateFrameBuffers();
+
+  // the frame timeline only covers rendering, not presents to the old swap chain, which
+  // may still be queued. presents complete in order, so once framesInFlight more frames
+  // (presented to the new one) have finished, so have those.
+  Retire(
+      [this, oldSwapChain, oldImageViews, oldFramebuffers]() mutable {
+        DestroySwapChain(oldSwapChain, oldImageViews, oldFramebuffers);
+      },
+      frameNumber + framesInFlight);
+  swapChainStale = false;
+
+  const f64 ms =
+      std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - begin)
+          .count();
+  swapChainStats.recreations++;
+  swapChainStats.totalMs += ms;
+  swapChainStats.maxMs = Max(swapChainStats.maxMs, ms);
+  Logger::Debugf(
+      "swap chain recreated in %.2fms, %s.",
+      ms,
+      drainOnRecreate ? "after draining the device" : "without waiting on the GPU");
+  return true;
 }
 
-void Vulkan::CleanupSwapChain() {
-  if (instance && logicalDevice && swapChain) {
-    for (auto framebuffer : swapChainFramebuffers) {
-      vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
-    }
+void Vulkan::DestroySwapChain(
+    VkSwapchainKHR& chain,
+    std::vector<VkImageView>& imageViews,
+    std::vector<VkFramebuffer>& framebuffers) {
+  for (auto framebuffer : framebuffers) {
+    vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+  }
+  framebuffers.clear();
 
-    for (auto imageView : swapChainImageViews) {
-      vkDestroyImageView(logicalDevice, imageView, nullptr);
-    }
+  for (auto imageView : imageViews) {
+    vkDestroyImageView(logicalDevice, imageView, nullptr);
+  }
+  imageViews.clear();
+
+  if (chain) {
+    vkDestroySwapchainKHR(logicalDevice, chain, nullptr);
+    chain = VK_NULL_HANDLE;
+  }
+}
 
-    vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+void Vulkan::CleanupSwapChain() {
+  if (instance && logicalDevice) {
+    DestroySwapChain(swapChain, swapChainImageViews, swapChainFramebuffers);
+    if (swapChainStats.recreations > 0) {
+      Logger::Debugf(
+          "swap chain: %u recreations, avg %.2fms, max %.2fms",
+          swapChainStats.recreations,
+          swapChainStats.totalMs / swapChainStats.recreations,
+          swapChainStats.maxMs);
+    }
   }
 }
 
@@ -1786,39 +2666,42 @@ void Vulkan::Cleanup() {
 
   if (instance) {
     if (logicalDevice) {
+      // before the pools and allocator they may refer to
+      DestroyRetired(true);
       CleanupSwapChain();
 
-      vkDestroySampler(logicalDevice, textureSampler, nullptr);
-      vkDestroyImageView(logicalDevice, textureImageView, nullptr);
+      if (textureSampler) {
+        vkDestroySampler(logicalDevice, textureSampler, nullptr);
+      }
+      for (auto& texture : textures) {
+        vkDestroyImageView(logicalDevice, texture.view, nullptr);
+      }
 
-      vkDestroyImage(logicalDevice, textureImage, nullptr);
-      vkFreeMemory(logicalDevice, textureImageMemory, nullptr);
+      allocator.LogStats();
+      LogCommandCacheStats();
+
+      for (auto& texture : textures) {
+        vkDestroyImage(logicalDevice, texture.image, nullptr);
+        allocator.Free(texture.allocation);
+      }
+      textures.clear();
 
       if (descriptorPool) {
         vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
       }
 
-      for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroyBuffer(logicalDevice, uniformBuffers[i], nullptr);
-        vkFreeMemory(logicalDevice, uniformBuffersMemory[i], nullptr);
+      for (size_t i = 0; i < uniformBuffers.size(); i++) {
+        DestroyBuffer(uniformBuffers[i], uniformBufferAllocations[i]);
       }
 
       if (descriptorSetLayout) {
         vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
       }
 
-      if (indexBuffer) {
-        vkDestroyBuffer(logicalDevice, indexBuffer, nullptr);
-      }
-      if (indexBufferMemory) {
-        vkFreeMemory(logicalDevice, indexBufferMemory, nullptr);
-      }
+      DestroyBuffer(indexBuffer, indexBufferAllocation);
 
       for (u8 i = 0; i < vertexBuffers.size(); i++) {
-        vkDestroyBuffer(logicalDevice, vertexBuffers[i], nullptr);
-      }
-      for (u8 i = 0; i < vertexBufferMemories.size(); i++) {
-        vkFreeMemory(logicalDevice, vertexBufferMemories[i], nullptr);
+        DestroyBuffer(vertexBuffers[i], vertexBufferAllocations[i]);
       }
 
       if (graphicsPipeline) {
@@ -1831,21 +2714,38 @@ void Vulkan::Cleanup() {
         vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
       }
 
-      for (uint8_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+      for (uint8_t i = 0; i < renderFinishedSemaphores.size(); i++) {
         if (renderFinishedSemaphores[i]) {
           vkDestroySemaphore(logicalDevice, renderFinishedSemaphores[i], nullptr);
         }
         if (imageAvailableSemaphores[i]) {
           vkDestroySemaphore(logicalDevice, imageAvailableSemaphores[i], nullptr);
         }
-        if (inFlightFences[i]) {
-          vkDestroyFence(logicalDevice, inFlightFences[i], nullptr);
-        }
+      }
+      if (frameTimeline) {
+        vkDestroySemaphore(logicalDevice, frameTimeline, nullptr);
       }
       if (commandPool) {
         vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
       }
 
+      transfers.Destroy();
+      recordJobs = nullptr;
+      for (auto& frame : recordContexts) {
+        for (auto& ctx : frame) {
+          vkDestroyCommandPool(logicalDevice, ctx.pool, nullptr);
+        }
+      }
+      recordContexts.clear();
+      DestroyBuffer(indirectBuffer, indirectBufferAllocation);
+      stagingRing.Destroy();
+      SavePipelineCache();
+      if (pipelineCache) {
+        vkDestroyPipelineCache(logicalDevice, pipelineCache, nullptr);
+      }
+
+      allocator.Destroy();
+
       vkDestroyDevice(logicalDevice, nullptr);
 
       // if (enableValidationLayers) {
@@ -4,14 +4,22 @@
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <array>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "Base.hpp"
+#include "DirtyRanges.hpp"
+#include "Jobs.hpp"
+#include "VulkanAllocator.hpp"
+#include "VulkanDeletionQueue.hpp"
+#include "VulkanStagingRing.hpp"
+#include "VulkanTransferQueue.hpp"
 
 /**
  * Enables Vulkan validation layer handler
@@ -40,6 +48,8 @@ struct PhysicalDeviceQueue {
 struct PhysicalDeviceQueues {
   PhysicalDeviceQueue graphics;
   PhysicalDeviceQueue present;
+  // a family without GRAPHICS, if any; otherwise the graphics family and queue
+  PhysicalDeviceQueue transfer;
 };
 
 struct SwapChainSupportDetails {
@@ -50,7 +60,20 @@ struct SwapChainSupportDetails {
 
 class Vulkan {
  public:
-  static const int MAX_FRAMES_IN_FLIGHT = 2;
+  // upper bound for framesInFlight
+  static const u8 MAX_FRAMES_IN_FLIGHT = 3;
+  // slots in the bindless texture table; well under the update-after-bind limits that
+  // descriptor indexing guarantees
+  static const u32 MAX_TEXTURES = 1024;
+  // texId bits below the texture slot; they select a region within that texture
+  static const u32 TEXTURE_REGION_BITS = 16;
+
+  /**
+   * An instance's texId: which texture (slot) to sample, and which region of it.
+   */
+  static constexpr u32 TexId(u32 slot, u32 region) {
+    return (slot << TEXTURE_REGION_BITS) | region;
+  }
 
   Vulkan();
   ~Vulkan();
@@ -131,6 +154,17 @@ class Vulkan {
    */
   void UseLogicalDevice();
 
+  /**
+   * Load the pipeline cache from pipelineCacheFile, if it was written by this same
+   * device + driver version; otherwise start with an empty cache.
+   */
+  void CreatePipelineCache();
+
+  /**
+   * Write the pipeline cache back to pipelineCacheFile, for a faster next startup.
+   */
+  void SavePipelineCache();
+
   /**
    * Construct the swap chain.
    */
@@ -151,34 +185,158 @@ class Vulkan {
       std::vector<u32> locations,
       std::vector<u32> formats,
       std::vector<u32> offsets);
+  /**
+   * As above, from SPIR-V already read into memory (ie. on a worker thread).
+   * Touches no queue or command pool, so may run on a worker thread, too.
+   */
+  void CreateGraphicsPipeline(
+      const std::vector<char>& fragCode,
+      const std::vector<char>& vertCode,
+      u32 vertexSize,
+      u32 instanceSize,
+      u8 attrCount,
+      std::vector<u32> bindings,
+      std::vector<u32> locations,
+      std::vector<u32> formats,
+      std::vector<u32> offsets);
   void CreateDescriptorSetLayout();
   void CreateFrameBuffers();
   void CreateCommandPool();
   void CreateCommandBuffers();
   void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  /**
+   * Bind state and draw. Everything recorded here is covered by DrawCommandKey.
+   *
+   * @param indirect - Read draw parameters from indirectBuffer, rather than baking them in.
+   */
+  void RecordDrawCommands(VkCommandBuffer commandBuffer, bool indirect);
+  void RecordDrawState(VkCommandBuffer commandBuffer);
+  bool BeginSecondaryCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags);
+  void RecordDrawCommandBuffer(VkCommandBuffer commandBuffer);
+  /**
+   * Record drawBatches across worker threads, each into its own secondary command buffer,
+   * then execute them in order from the primary.
+   */
+  void RecordDrawBatchesThreaded(VkCommandBuffer commandBuffer);
+  /**
+   * Record drawBatches as jobs, whenever there is more than one batch.
+   * Call after CreateCommandPool(), and after jobs.Start(); jobs must outlive Cleanup().
+   */
+  void EnableThreadedRecording(Jobs& jobs);
+  /**
+   * Force cached draw commands to be re-recorded on next use.
+   */
+  void InvalidateCommandBuffers();
+  void LogCommandCacheStats() const;
   void CreateSyncObjects();
+  /**
+   * Create a buffer, and bind it to memory sub-allocated from the allocator.
+   *
+   * @param strategy - Use Linear for short-lived (ie. staging) buffers.
+   */
   void CreateBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer& buffer,
-      VkDeviceMemory& bufferMemory);
+      VulkanAllocation& bufferAllocation,
+      AllocationStrategy strategy = AllocationStrategy::FreeList);
+  void DestroyBuffer(VkBuffer& buffer, VulkanAllocation& bufferAllocation);
+  /**
+   * Destroy objects retired by frames the GPU has finished.
+   *
+   * @param all - Ignore frames in flight (ie. after DeviceWaitIdle).
+   */
+  void DestroyRetired(bool all);
+  /**
+   * Run destroy once every frame up to the current one has finished; for objects which
+   * this frame, earlier frames in flight, or one-time submits made so far may still use.
+   */
+  void Retire(VulkanDeletionQueue::Destroyer destroy);
+  /**
+   * Run destroy once frame lastFrame has finished.
+   */
+  void Retire(VulkanDeletionQueue::Destroyer destroy, u64 lastFrame);
+  // Retire() the object, and null the caller's handle
+  void RetireBuffer(VkBuffer& buffer, VulkanAllocation& allocation);
+  void RetireImage(VkImage& image, VulkanAllocation& allocation);
+  void RetireImageView(VkImageView& view);
+  void RetireSampler(VkSampler& sampler);
+  void RetirePipeline(VkPipeline& pipeline, VkPipelineLayout& layout);
+  /**
+   * Frames the GPU has finished, ie. the frame timeline's value. Never blocks; resources
+   * last used by frame n (a frameNumber) may be recycled once this is greater than n.
+   */
+  u64 CompletedFrames() const;
+  /**
+   * Block until CompletedFrames() >= count.
+   */
+  void AwaitCompletedFrames(u64 count);
+  /**
+   * Make the current frame's staging partition writable, waiting on its fence if needed.
+   */
+  void OpenStagingPartition();
+  /**
+   * Also acquires whatever the transfer queue has released since.
+   */
   VkCommandBuffer BeginSingleTimeCommands();
   void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
   void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-  void TransitionImageLayout(
-      VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-  void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+  /**
+   * @param indata - Initial contents, or NULL to leave uninitialized.
+   */
   void CreateVertexBuffer(u8 idx, u64 size, const void* indata);
+  /**
+   * Ensure a vertex buffer can hold at least size bytes, preserving its contents.
+   * Capacity doubles as needed; the old buffer is released after frames in flight finish.
+   */
+  void ReserveVertexBuffer(u8 idx, u64 size);
+  /**
+   * Replace the contents of a vertex buffer.
+   * The copy is staged, and recorded into the next DrawFrame().
+   */
   void UpdateVertexBuffer(u8 idx, u64 size, const void* indata);
+  /**
+   * Upload only the given byte ranges of indata, each to the same offset in the vertex buffer.
+   * Ranges must not overlap.
+   */
+  void UpdateVertexBufferRanges(u8 idx, const void* indata, const std::vector<ByteRange>& ranges);
   void CreateIndexBuffer(u64 size, const void* indata);
   void CreateUniformBuffers(const unsigned int length);
   void UpdateUniformBuffer(uint32_t frame, void* data);
   void CreateDescriptorPool();
   void CreateDescriptorSets();
   uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-  void CreateTextureImage(const char* file);
-  void CreateTextureImageView();
+  /**
+   * RGBA8 pixels, as decoded from an image file.
+   */
+  struct DecodedImage {
+    u8* pixels = nullptr;
+    u32 width = 0;
+    u32 height = 0;
+  };
+  /**
+   * Decode an image file. Touches no Vulkan state; safe to call from worker threads.
+   */
+  static DecodedImage DecodeImage(const char* file);
+  static void FreeImage(DecodedImage& image);
+  /**
+   * Upload a texture into the next slot of the bindless texture table. Every slot is
+   * visible to every draw; instances pick theirs by texId (see TexId()).
+   *
+   * @return - The slot.
+   */
+  u32 CreateTexture(const char* file);
+  u32 CreateTexture(const DecodedImage& image);
+  /**
+   * Swap slot's texture for another, ie. on hot reload; frames in flight keep sampling
+   * the old one.
+   */
+  void ReplaceTexture(u32 slot, const DecodedImage& image);
+  u32 TextureCount() const;
+  /**
+   * The sampler shared by every texture.
+   */
   void CreateTextureSampler();
   VkImageView CreateImageView(VkImage image, VkFormat format);
   void CreateImage(
@@ -189,11 +347,25 @@ class Vulkan {
       VkImageUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkImage& image,
-      VkDeviceMemory& imageMemory);
-  void AwaitNextFrame();
+      VulkanAllocation& imageAllocation);
+  /**
+   * @return - false if there is no image to draw to (ie. the window was minimized);
+   *           skip DrawFrame().
+   */
+  bool AwaitNextFrame();
   void DrawFrame();
   void DeviceWaitIdle();
-  void RecreateSwapChain();
+  /**
+   * Replace the swap chain (ie. after a resize), without waiting on the GPU.
+   * The old one is destroyed once frames presented to the new one have finished.
+   *
+   * @return - false if the surface is 0x0 (ie. minimized); then minimized is set, and
+   *           it is recreated on the next AwaitNextFrame() after that's cleared.
+   */
+  bool RecreateSwapChain();
+  /**
+   * Destroy the swap chain. Only call when the device is idle.
+   */
   void CleanupSwapChain();
   void Cleanup();
 
@@ -203,6 +375,17 @@ class Vulkan {
 
   f32 aspectRatio = 1.0f / 1;  // ASPECT_SQUARE
 
+  // relative to working directory; set before UseLogicalDevice()
+  std::string pipelineCacheFile = "pipeline_cache.bin";
+
+  /**
+   * Preferred presentation; set before InitSwapChain(). Falls back to FIFO if unsupported.
+   * FIFO: vsync, never tears; frames queue behind the display (adds latency under load).
+   * MAILBOX: vsync, never tears; newest frame replaces any queued one (lowest latency).
+   * IMMEDIATE: no vsync, may tear; use to measure uncapped frame times.
+   */
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+
   // window size may differ (ie. viewport may have fixed aspect
   // ratio, while window has letterbox/pillarbox)
   u32 windowWidth = 0;
@@ -219,20 +402,70 @@ class Vulkan {
   u32 bufferWidth = 0;
   u32 bufferHeight = 0;
 
+  /**
+   * Frames the CPU may record ahead of the GPU; set before UseLogicalDevice().
+   * 2 has the least latency; 3 keeps the GPU busy when CPU frame times vary.
+   */
+  u8 framesInFlight = 2;
+
   bool framebufferResized = false;
   bool minimized = false;
   bool maximized = false;
   uint32_t imageIndex = 0;
   uint8_t currentFrame = 0;
+  // count of frames submitted so far
+  u64 frameNumber = 0;
   VkExtent2D swapChainExtent = {};
   u32 drawIndexCount = 0;
   u32 instanceCount = 1;
 
+  /**
+   * Reuse recorded draw commands across frames (as secondary command buffers),
+   * re-recording only when pipeline, bindings, or viewport change.
+   */
+  bool cacheCommandBuffers = true;
+  /**
+   * Optional. Split the instanced draw into several draws, over disjoint instance ranges.
+   * When empty, one draw covers [0, instanceCount).
+   */
+  struct DrawBatch {
+    u32 firstInstance = 0;
+    u32 instanceCount = 0;
+  };
+  std::vector<DrawBatch> drawBatches = {};
+  struct CommandCacheStats {
+    u64 hits = 0;
+    u64 misses = 0;
+    // total CPU time spent recording draw commands
+    f64 recordMs = 0;
+  };
+  CommandCacheStats commandCacheStats = {};
+  struct SwapChainStats {
+    u32 recreations = 0;
+    // CPU time spent in RecreateSwapChain()
+    f64 totalMs = 0;
+    f64 maxMs = 0;
+  };
+  SwapChainStats swapChainStats = {};
+  /**
+   * Wait for the device to go idle before recreating the swap chain, as it used to;
+   * only for comparing swapChainStats against the default.
+   */
+  bool drainOnRecreate = false;
+
  private:
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VkDevice logicalDevice = nullptr;
+  VulkanAllocator allocator = {};
+  VulkanStagingRing stagingRing = {};
+  // initial texture and buffer contents; uploads overlap with rendering
+  VulkanTransferQueue transfers = {};
+  // recorded acquires, which the next graphics submit must wait on
+  VulkanTransferQueue::Wait transferWait = {};
   // TODO: swap chain stuff should get its own struct
   SwapChainSupportDetails swapChainSupport = {};
+  // RecreateSwapChain() was skipped for a 0x0 surface; retried by AwaitNextFrame()
+  bool swapChainStale = false;
   VkSwapchainKHR swapChain = 0;
   std::vector<VkImage> swapChainImages = {};
   VkFormat swapChainImageFormat = {};
@@ -241,26 +474,82 @@ class Vulkan {
   VkDescriptorSetLayout descriptorSetLayout;
   VkPipelineLayout pipelineLayout = {};
   VkPipeline graphicsPipeline = {};
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  // whether pipelineCache was seeded from disk
+  bool pipelineCacheWarm = false;
   std::vector<VkFramebuffer> swapChainFramebuffers = {};
   VkCommandPool commandPool = {};
   std::vector<VkCommandBuffer> commandBuffers = {};
+  // everything which, when changed, invalidates cached draw commands
+  struct DrawCommandKey {
+    bool valid = false;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::vector<VkBuffer> vertexBuffers = {};
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    std::array<u32, 4> viewport = {};
+    std::array<u32, 2> extent = {};
+
+    bool operator==(const DrawCommandKey& other) const;
+  };
+  DrawCommandKey GetDrawCommandKey() const;
+  /**
+   * Block until the GPU is done with currentFrame's per-frame resources.
+   */
+  void AwaitFrameSlot();
+  std::vector<VkCommandBuffer> drawCommandBuffers = {};
+  std::vector<DrawCommandKey> drawCommandKeys = {};
+  // per (frame in flight, Jobs::CurrentWorker()) command pool and the secondaries allocated
+  // from it; the last is shared by threads outside the pool
+  struct RecordContext {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers = {};
+    u32 used = 0;
+  };
+  std::vector<std::vector<RecordContext>> recordContexts = {};
+  Jobs* recordJobs = nullptr;
+  // held while a thread outside the pool (ie. one helping in Jobs::Wait()) records
+  std::mutex externalRecordMutex;
+  VkBuffer indirectBuffer = VK_NULL_HANDLE;
+  VulkanAllocation indirectBufferAllocation = {};
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
+  // value n+1 is signaled once the GPU has finished frame n
+  VkSemaphore frameTimeline = VK_NULL_HANDLE;
   std::vector<VkBuffer> vertexBuffers = {};
-  std::vector<VkDeviceMemory> vertexBufferMemories = {};
+  std::vector<VulkanAllocation> vertexBufferAllocations = {};
+  std::vector<VkDeviceSize> vertexBufferCapacities = {};
+  // objects replaced while possibly still in use by frames in flight
+  VulkanDeletionQueue deletionQueue = {};
+  void DestroySwapChain(
+      VkSwapchainKHR& chain,
+      std::vector<VkImageView>& imageViews,
+      std::vector<VkFramebuffer>& framebuffers);
   VkBuffer indexBuffer;
-  VkDeviceMemory indexBufferMemory;
+  VulkanAllocation indexBufferAllocation = {};
   std::vector<VkBuffer> uniformBuffers;
   std::vector<unsigned int> uniformBufferLengths;
-  std::vector<VkDeviceMemory> uniformBuffersMemory;
+  std::vector<VulkanAllocation> uniformBufferAllocations;
   std::vector<void*> uniformBuffersMapped;
   VkDescriptorPool descriptorPool;
   std::vector<VkDescriptorSet> descriptorSets;
-  VkImage textureImage;
-  VkDeviceMemory textureImageMemory;
-  VkImageView textureImageView;
-  VkSampler textureSampler;
+  struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    VulkanAllocation allocation = {};
+    VkImageView view = VK_NULL_HANDLE;
+  };
+  // by slot
+  std::vector<Texture> textures = {};
+  VkSampler textureSampler = VK_NULL_HANDLE;
+  void UploadTexture(Texture& texture, const DecodedImage& image);
+  // per frame in flight; texture slots its descriptor set doesn't point at yet
+  std::vector<std::vector<u32>> staleTextureSlots = {};
+  void MarkTextureStale(u32 slot);
+  /**
+   * Write currentFrame's stale texture slots. Its previous frame must have finished.
+   */
+  void UpdateTextureDescriptors();
 };
 
 }  // namespace mks
\ No newline at end of file
@@ -0,0 +1,391 @@
+#include "VulkanAllocator.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize n, VkDeviceSize alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+namespace mks {
+
+VulkanAllocator::VulkanAllocator() {
+}
+
+VulkanAllocator::~VulkanAllocator() {
+}
+
+void VulkanAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice) {
+  this->physicalDevice = physicalDevice;
+  this->logicalDevice = logicalDevice;
+
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+  // one pool per (memory type, resource kind, strategy); blocks are reserved lazily
+  pools.resize(memProperties.memoryTypeCount * 2 * 2);
+  for (u32 type = 0; type < memProperties.memoryTypeCount; type++) {
+    const VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[type].heapIndex].size;
+    const VkDeviceSize blockSize = std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+    for (u8 kind = 0; kind < 2; kind++) {
+      for (u8 strategy = 0; strategy < 2; strategy++) {
+        auto& pool = pools[PoolIndex(
+            type,
+            static_cast<ResourceKind>(kind),
+            static_cast<AllocationStrategy>(strategy))];
+        pool.memoryType = type;
+        pool.kind = static_cast<ResourceKind>(kind);
+        pool.strategy = static_cast<AllocationStrategy>(strategy);
+        pool.blockSize = blockSize;
+      }
+    }
+  }
+
+  Logger::Debugf(
+      "memory allocator:\n  memoryTypeCount: %u, maxMemoryAllocationCount: %u",
+      memProperties.memoryTypeCount,
+      properties.limits.maxMemoryAllocationCount);
+}
+
+u32 VulkanAllocator::PoolIndex(
+    u32 memoryType, ResourceKind kind, AllocationStrategy strategy) const {
+  return (memoryType * 2 + static_cast<u32>(kind)) * 2 + static_cast<u32>(strategy);
+}
+
+u32 VulkanAllocator::FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties) const {
+  for (u32 i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw Logger::Errorf("failed to find suitable memory type!");
+}
+
+bool VulkanAllocator::AllocateDeviceMemory(
+    u32 memoryType, VkDeviceSize size, VkDeviceMemory& memory, void** mapped) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    return false;
+  }
+  deviceMemoryAllocations++;
+
+  // NOTICE: a VkDeviceMemory may only be mapped once, and every sub-allocation
+  // shares it; so host-visible memory is mapped for its entire lifetime.
+  *mapped = nullptr;
+  if (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(logicalDevice, memory, 0, size, 0, mapped) != VK_SUCCESS) {
+      vkFreeMemory(logicalDevice, memory, nullptr);
+      throw Logger::Errorf("vkMapMemory failed. size: %llu", size);
+    }
+  }
+  return true;
+}
+
+void VulkanAllocator::FreeDeviceMemory(VkDeviceMemory memory, void* mapped) {
+  if (mapped) {
+    vkUnmapMemory(logicalDevice, memory);
+  }
+  vkFreeMemory(logicalDevice, memory, nullptr);
+}
+
+bool VulkanAllocator::SubAllocate(
+    Pool& pool, Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+  if (AllocationStrategy::Linear == pool.strategy) {
+    const VkDeviceSize aligned = AlignUp(block.head, alignment);
+    if (aligned + size > block.size) {
+      return false;
+    }
+    offset = aligned;
+    block.head = aligned + size;
+    return true;
+  }
+
+  // first-fit
+  for (size_t i = 0; i < block.free.size(); i++) {
+    const Range r = block.free[i];
+    const VkDeviceSize aligned = AlignUp(r.offset, alignment);
+    if (aligned + size > r.offset + r.size) {
+      continue;
+    }
+    offset = aligned;
+
+    // split; leading padding remains a (coalescable) free range
+    const Range before = {r.offset, aligned - r.offset};
+    const Range after = {aligned + size, (r.offset + r.size) - (aligned + size)};
+    if (before.size > 0 && after.size > 0) {
+      block.free[i] = before;
+      block.free.insert(block.free.begin() + i + 1, after);
+    } else if (before.size > 0) {
+      block.free[i] = before;
+    } else if (after.size > 0) {
+      block.free[i] = after;
+    } else {
+      block.free.erase(block.free.begin() + i);
+    }
+    return true;
+  }
+  return false;
+}
+
+void VulkanAllocator::ReleaseSubAllocation(
+    Pool& pool, Block& block, VkDeviceSize offset, VkDeviceSize size) {
+  if (AllocationStrategy::Linear == pool.strategy) {
+    // rewind if this was the most recent allocation
+    if (offset + size == block.head) {
+      block.head = offset;
+    }
+    if (0 == block.allocations) {
+      block.head = 0;
+    }
+    return;
+  }
+
+  // insert sorted by offset, then coalesce with neighbors
+  auto it = std::lower_bound(
+      block.free.begin(),
+      block.free.end(),
+      offset,
+      [](const Range& r, VkDeviceSize o) { return r.offset < o; });
+  it = block.free.insert(it, {offset, size});
+  auto next = it + 1;
+  if (next != block.free.end() && it->offset + it->size == next->offset) {
+    it->size += next->size;
+    block.free.erase(next);
+  }
+  if (it != block.free.begin()) {
+    auto prev = it - 1;
+    if (prev->offset + prev->size == it->offset) {
+      prev->size += it->size;
+      block.free.erase(it);
+    }
+  }
+}
+
+VulkanAllocation VulkanAllocator::Allocate(
+    const VkMemoryRequirements& requirements,
+    VkMemoryPropertyFlags properties,
+    ResourceKind kind,
+    AllocationStrategy strategy) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const u32 memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+  const u32 poolIndex = PoolIndex(memoryType, kind, strategy);
+  Pool& pool = pools[poolIndex];
+
+  VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+  const bool coherent =
+      memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  const bool visible =
+      memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  if (visible && !coherent) {
+    // so that flushing one allocation never touches its neighbors
+    alignment = std::max(alignment, nonCoherentAtomSize);
+  }
+
+  VulkanAllocation allocation{};
+  allocation.pool = poolIndex;
+  allocation.size = requirements.size;
+
+  // large resources get their own VkDeviceMemory, rather than fragmenting a block
+  if (requirements.size > pool.blockSize / 2) {
+    if (!AllocateDeviceMemory(
+            memoryType,
+            requirements.size,
+            allocation.memory,
+            &allocation.mapped)) {
+      throw Logger::Errorf(
+          "vkAllocateMemory failed. dedicated size: %llu, memoryType: %u",
+          requirements.size,
+          memoryType);
+    }
+    allocation.offset = 0;
+    allocation.block = VulkanAllocation::DEDICATED;
+    dedicatedCount++;
+    dedicatedBytes += requirements.size;
+    allocationCount++;
+    return allocation;
+  }
+
+  // try existing blocks first
+  VkDeviceSize offset = 0;
+  for (u32 i = 0; i < pool.blocks.size(); i++) {
+    Block& block = pool.blocks[i];
+    if (VK_NULL_HANDLE != block.memory &&
+        SubAllocate(pool, block, requirements.size, alignment, offset)) {
+      block.allocations++;
+      allocation.memory = block.memory;
+      allocation.offset = offset;
+      allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+      allocation.block = i;
+      allocationCount++;
+      return allocation;
+    }
+  }
+
+  // reserve a new block, reusing an empty slot if one was released
+  u32 slot = static_cast<u32>(pool.blocks.size());
+  for (u32 i = 0; i < pool.blocks.size(); i++) {
+    if (VK_NULL_HANDLE == pool.blocks[i].memory) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot == pool.blocks.size()) {
+    pool.blocks.emplace_back();
+  }
+  Block& block = pool.blocks[slot];
+  block = {};
+  block.size = pool.blockSize;
+  if (!AllocateDeviceMemory(memoryType, block.size, block.memory, &block.mapped)) {
+    throw Logger::Errorf(
+        "vkAllocateMemory failed. block size: %llu, memoryType: %u",
+        block.size,
+        memoryType);
+  }
+  block.free.push_back({0, block.size});
+
+  if (!SubAllocate(pool, block, requirements.size, alignment, offset)) {
+    throw Logger::Errorf("allocation does not fit in a new block. size: %llu", requirements.size);
+  }
+  block.allocations++;
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+  allocation.block = slot;
+  allocationCount++;
+  return allocation;
+}
+
+void VulkanAllocator::Free(VulkanAllocation& allocation) {
+  if (VK_NULL_HANDLE == allocation.memory) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (VulkanAllocation::DEDICATED == allocation.block) {
+    FreeDeviceMemory(allocation.memory, allocation.mapped);
+    dedicatedCount--;
+    dedicatedBytes -= allocation.size;
+    allocationCount--;
+    allocation = {};
+    return;
+  }
+
+  Pool& pool = pools[allocation.pool];
+  Block& block = pool.blocks[allocation.block];
+  block.allocations--;
+  allocationCount--;
+  ReleaseSubAllocation(pool, block, allocation.offset, allocation.size);
+
+  // keep at most one empty block per pool, to avoid thrashing vkAllocateMemory
+  if (0 == block.allocations) {
+    for (u32 i = 0; i < pool.blocks.size(); i++) {
+      const Block& other = pool.blocks[i];
+      if (i != allocation.block && VK_NULL_HANDLE != other.memory && 0 == other.allocations) {
+        FreeDeviceMemory(block.memory, block.mapped);
+        block = {};
+        break;
+      }
+    }
+  }
+
+  allocation = {};
+}
+
+void VulkanAllocator::Destroy() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (allocationCount > 0) {
+    Logger::Debugf("memory allocator: %u allocations leaked at shutdown.", allocationCount);
+  }
+  for (auto& pool : pools) {
+    for (auto& block : pool.blocks) {
+      if (VK_NULL_HANDLE != block.memory) {
+        FreeDeviceMemory(block.memory, block.mapped);
+      }
+    }
+    pool.blocks.clear();
+  }
+}
+
+VulkanAllocatorStats VulkanAllocator::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  VulkanAllocatorStats stats{};
+  stats.dedicatedCount = dedicatedCount;
+  stats.allocationCount = allocationCount;
+  stats.deviceMemoryAllocations = deviceMemoryAllocations;
+  stats.reservedBytes = dedicatedBytes;
+  stats.usedBytes = dedicatedBytes;
+  for (const auto& pool : pools) {
+    for (const auto& block : pool.blocks) {
+      if (VK_NULL_HANDLE == block.memory) {
+        continue;
+      }
+      stats.blockCount++;
+      stats.reservedBytes += block.size;
+      if (AllocationStrategy::Linear == pool.strategy) {
+        const VkDeviceSize tail = block.size - block.head;
+        stats.usedBytes += block.head;
+        stats.freeBytes += tail;
+        stats.freeRangeCount++;
+        stats.largestFreeRange = std::max(stats.largestFreeRange, tail);
+        continue;
+      }
+      VkDeviceSize blockFree = 0;
+      for (const auto& r : block.free) {
+        blockFree += r.size;
+        stats.freeRangeCount++;
+        stats.largestFreeRange = std::max(stats.largestFreeRange, r.size);
+      }
+      stats.freeBytes += blockFree;
+      stats.usedBytes += block.size - blockFree;
+    }
+  }
+  stats.deviceMemoryCount = stats.blockCount + stats.dedicatedCount;
+  if (stats.freeBytes > 0) {
+    stats.fragmentation =
+        1.0f - static_cast<f32>(stats.largestFreeRange) / static_cast<f32>(stats.freeBytes);
+  }
+  return stats;
+}
+
+void VulkanAllocator::LogStats() const {
+  const auto s = GetStats();
+  // NOTICE: Logger formats into a fixed 255 byte buffer; keep each line short
+  Logger::Debugf("memory allocator stats:");
+  Logger::Debugf(
+      "  deviceMemory: %u (blocks: %u, dedicated: %u, lifetime: %u), allocations: %u",
+      s.deviceMemoryCount,
+      s.blockCount,
+      s.dedicatedCount,
+      s.deviceMemoryAllocations,
+      s.allocationCount);
+  Logger::Debugf(
+      "  reserved: %llu KiB, used: %llu KiB, free: %llu KiB",
+      s.reservedBytes / 1024,
+      s.usedBytes / 1024,
+      s.freeBytes / 1024);
+  Logger::Debugf(
+      "  free ranges: %u, largest: %llu KiB, fragmentation: %.3f",
+      s.freeRangeCount,
+      s.largestFreeRange / 1024,
+      s.fragmentation);
+}
+
+}  // namespace mks
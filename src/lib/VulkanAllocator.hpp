@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * How sub-allocations are carved from a memory block.
+ */
+enum class AllocationStrategy : u8 {
+  /**
+   * General purpose. First-fit over a sorted free list;
+   * freed ranges are coalesced with their neighbors.
+   */
+  FreeList = 0,
+  /**
+   * Bump pointer for short-lived resources (ie. staging buffers).
+   * The block rewinds once every allocation within it has been freed.
+   */
+  Linear = 1,
+};
+
+/**
+ * Buffers and optimal-tiling images are kept in separate blocks,
+ * so we never have to reason about bufferImageGranularity.
+ */
+enum class ResourceKind : u8 {
+  Buffer = 0,
+  Image = 1,
+};
+
+/**
+ * A sub-range of a VkDeviceMemory object, as handed out by VulkanAllocator.
+ * Bind resources with `memory` + `offset`.
+ */
+struct VulkanAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  /**
+   * Host pointer to `offset` within a persistently mapped block.
+   * NULL unless the memory type is HOST_VISIBLE.
+   */
+  void* mapped = nullptr;
+  u32 pool = 0;
+  /**
+   * Index of the block within its pool, or DEDICATED.
+   */
+  u32 block = 0;
+
+  static const u32 DEDICATED = UINT32_MAX;
+};
+
+/**
+ * Snapshot of allocator state, for profiling and fragmentation tracking.
+ */
+struct VulkanAllocatorStats {
+  // live vkAllocateMemory objects (blocks + dedicated); compare to maxMemoryAllocationCount
+  u32 deviceMemoryCount = 0;
+  u32 blockCount = 0;
+  u32 dedicatedCount = 0;
+  // live sub-allocations handed out to callers
+  u32 allocationCount = 0;
+  // lifetime count of vkAllocateMemory calls
+  u32 deviceMemoryAllocations = 0;
+  VkDeviceSize reservedBytes = 0;
+  VkDeviceSize usedBytes = 0;
+  VkDeviceSize freeBytes = 0;
+  u32 freeRangeCount = 0;
+  VkDeviceSize largestFreeRange = 0;
+  /**
+   * 0 when all free space within blocks is one contiguous range;
+   * approaches 1 as free space is scattered into many small holes.
+   */
+  f32 fragmentation = 0.0f;
+};
+
+/**
+ * Device memory sub-allocator.
+ *
+ * Reserves large blocks per memory type, and hands out aligned sub-ranges of them,
+ * so a scene with thousands of resources needs only a few dozen vkAllocateMemory calls
+ * (the driver limit, maxMemoryAllocationCount, can be as low as 4096).
+ */
+class VulkanAllocator {
+ public:
+  /**
+   * Size of each block reserved from a heap.
+   * (clamped to 1/8th of small heaps, like the 256MB BAR heap)
+   */
+  static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  VulkanAllocator();
+  ~VulkanAllocator();
+
+  void Init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+
+  /**
+   * Locate a memory type index satisfying both the resource requirements and the
+   * desired property flags.
+   */
+  u32 FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties) const;
+
+  /**
+   * Carve a sub-range from a block of a suitable memory type.
+   * Requests larger than half a block get a dedicated VkDeviceMemory.
+   */
+  VulkanAllocation Allocate(
+      const VkMemoryRequirements& requirements,
+      VkMemoryPropertyFlags properties,
+      ResourceKind kind,
+      AllocationStrategy strategy = AllocationStrategy::FreeList);
+
+  /**
+   * Return a sub-range to its block. Resets the allocation.
+   */
+  void Free(VulkanAllocation& allocation);
+
+  /**
+   * Release all blocks. Any outstanding allocations become invalid.
+   */
+  void Destroy();
+
+  VulkanAllocatorStats GetStats() const;
+  void LogStats() const;
+
+ private:
+  struct Range {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+  };
+
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    // sorted by offset (FreeList strategy)
+    std::vector<Range> free = {};
+    // next unused byte (Linear strategy)
+    VkDeviceSize head = 0;
+    u32 allocations = 0;
+  };
+
+  struct Pool {
+    u32 memoryType = 0;
+    ResourceKind kind = ResourceKind::Buffer;
+    AllocationStrategy strategy = AllocationStrategy::FreeList;
+    VkDeviceSize blockSize = 0;
+    std::vector<Block> blocks = {};
+  };
+
+  u32 PoolIndex(u32 memoryType, ResourceKind kind, AllocationStrategy strategy) const;
+  bool AllocateDeviceMemory(
+      u32 memoryType, VkDeviceSize size, VkDeviceMemory& memory, void** mapped);
+  void FreeDeviceMemory(VkDeviceMemory memory, void* mapped);
+  bool SubAllocate(
+      Pool& pool, Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+  void ReleaseSubAllocation(Pool& pool, Block& block, VkDeviceSize offset, VkDeviceSize size);
+
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties memProperties = {};
+  VkDeviceSize nonCoherentAtomSize = 1;
+  std::vector<Pool> pools = {};
+  u32 dedicatedCount = 0;
+  VkDeviceSize dedicatedBytes = 0;
+  u32 allocationCount = 0;
+  u32 deviceMemoryAllocations = 0;
+  mutable std::mutex mutex;
+};
+
+}  // namespace mks
@@ -0,0 +1,40 @@
+#include "VulkanDeletionQueue.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "Base.hpp"
+
+namespace mks {
+
+void VulkanDeletionQueue::Push(u64 frame, Destroyer destroy) {
+  // nearly always the latest frame; then this finds the end right away
+  auto at = std::find_if(entries.rbegin(), entries.rend(), [frame](const Entry& e) {
+    return e.frame <= frame;
+  });
+  entries.insert(at.base(), {frame, std::move(destroy)});
+}
+
+u32 VulkanDeletionQueue::Collect(u64 completedFrames) {
+  u32 count = 0;
+  while (!entries.empty() && entries.front().frame < completedFrames) {
+    // popped first, in case destroy() pushes more
+    Destroyer destroy = std::move(entries.front().destroy);
+    entries.pop_front();
+    destroy();
+    count++;
+  }
+  destroyedCount += count;
+  return count;
+}
+
+void VulkanDeletionQueue::Flush() {
+  Collect(UINT64_MAX);
+}
+
+u32 VulkanDeletionQueue::Size() const {
+  return entries.size();
+}
+
+}  // namespace mks
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+
+#include "Base.hpp"
+
+namespace mks {
+
+/**
+ * Destroys Vulkan objects once the GPU is done with them, instead of waiting for the
+ * device to go idle first.
+ *
+ * Each entry is tagged with the last frame which may use the object; Collect() runs it
+ * once the frame timeline shows that frame has finished. Since a semaphore signal also
+ * covers everything submitted to the queue before it, that includes one-time submits
+ * made while the frame was being prepared.
+ */
+class VulkanDeletionQueue {
+ public:
+  typedef std::function<void()> Destroyer;
+
+  /**
+   * @param frame - The last frameNumber which may use the object. Usually the current
+   *                frame, but may be later (ie. for what presents may still read).
+   */
+  void Push(u64 frame, Destroyer destroy);
+
+  /**
+   * Destroy everything whose frame is less than completedFrames.
+   *
+   * @return - The number of entries destroyed.
+   */
+  u32 Collect(u64 completedFrames);
+
+  /**
+   * Destroy everything. Only call when the device is idle.
+   */
+  void Flush();
+
+  u32 Size() const;
+
+  // lifetime count of entries destroyed
+  u64 destroyedCount = 0;
+
+ private:
+  struct Entry {
+    u64 frame;
+    Destroyer destroy;
+  };
+  // in frame order
+  std::deque<Entry> entries = {};
+};
+
+}  // namespace mks
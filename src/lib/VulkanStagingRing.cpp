@@ -0,0 +1,248 @@
+#include "VulkanStagingRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace {
+
+// keeps every region suitably aligned for later buffer-to-image copies, too
+const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+VkDeviceSize AlignUp(VkDeviceSize n, VkDeviceSize alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+struct WrittenSpan {
+  VkBuffer buffer;
+  VkDeviceSize begin;
+  VkDeviceSize end;
+};
+
+}  // namespace
+
+namespace mks {
+
+VulkanStagingRing::VulkanStagingRing() {
+}
+
+VulkanStagingRing::~VulkanStagingRing() {
+}
+
+void VulkanStagingRing::Init(
+    VkDevice logicalDevice, VulkanAllocator* allocator, u8 frameCount, VkDeviceSize frameSize) {
+  this->logicalDevice = logicalDevice;
+  this->allocator = allocator;
+  this->frameSize = AlignUp(frameSize, STAGING_ALIGNMENT);
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = this->frameSize * frameCount;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw Logger::Errorf("failed to create staging ring buffer!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(logicalDevice, buffer, &memRequirements);
+
+  allocation = allocator->Allocate(
+      memRequirements,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      ResourceKind::Buffer);
+
+  if (vkBindBufferMemory(logicalDevice, buffer, allocation.memory, allocation.offset) !=
+      VK_SUCCESS) {
+    throw Logger::Errorf("failed to bind staging ring memory!");
+  }
+
+  partitions.resize(frameCount);
+  // nothing has been submitted yet, so every partition is free
+  for (u8 i = 0; i < frameCount; i++) {
+    Open(i);
+  }
+
+  Logger::Debugf(
+      "staging ring: %u frames x %llu bytes", frameCount, (unsigned long long)this->frameSize);
+}
+
+void VulkanStagingRing::Open(u8 frame) {
+  if (frame >= partitions.size()) {
+    return;
+  }
+  auto& p = partitions[frame];
+  p.head = 0;
+  p.open = true;
+  p.pending.clear();
+}
+
+bool VulkanStagingRing::IsOpen(u8 frame) const {
+  return frame < partitions.size() && partitions[frame].open;
+}
+
+bool VulkanStagingRing::Stage(
+    u8 frame, VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+  if (!buffer || !IsOpen(frame)) {
+    return false;
+  }
+  auto& p = partitions[frame];
+  const VkDeviceSize offset = AlignUp(p.head, STAGING_ALIGNMENT);
+  if (offset + size > frameSize) {
+    overflowCount++;
+    return false;
+  }
+
+  const VkDeviceSize srcOffset = frameSize * frame + offset;
+  memcpy(static_cast<u8*>(allocation.mapped) + srcOffset, data, static_cast<size_t>(size));
+  p.head = offset + size;
+
+  VkBufferCopy region{};
+  region.srcOffset = srcOffset;
+  region.dstOffset = dstOffset;
+  region.size = size;
+  p.pending.push_back({VK_NULL_HANDLE, dst, region});
+  return true;
+}
+
+bool VulkanStagingRing::StageBufferCopy(
+    u8 frame, VkBuffer src, VkBuffer dst, const VkBufferCopy& region) {
+  if (!buffer || !IsOpen(frame)) {
+    return false;
+  }
+  partitions[frame].pending.push_back({src, dst, region});
+  return true;
+}
+
+bool VulkanStagingRing::HasPending(u8 frame) const {
+  return frame < partitions.size() && !partitions[frame].pending.empty();
+}
+
+void VulkanStagingRing::Record(u8 frame, VkCommandBuffer commandBuffer) {
+  if (frame >= partitions.size()) {
+    return;
+  }
+  auto& p = partitions[frame];
+  // the partition now belongs to this submit, until its fence signals
+  p.open = false;
+  if (p.pending.empty()) {
+    return;
+  }
+
+  // WAR: prior submits may still be reading the destination as vertex input.
+  // (host writes are made visible implicitly by vkQueueSubmit)
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      0,
+      nullptr);
+
+  // batch consecutive copies between the same buffers into one command.
+  // a transfer barrier is inserted only when a copy reads a buffer written earlier
+  // in this batch sequence, or writes over bytes written earlier (RAW, WAW).
+  std::vector<VkBufferCopy> regions;
+  VkBuffer src = VK_NULL_HANDLE;
+  VkBuffer dst = VK_NULL_HANDLE;
+  std::vector<WrittenSpan> written;
+  auto flush = [&]() {
+    if (!regions.empty()) {
+      vkCmdCopyBuffer(commandBuffer, src, dst, static_cast<u32>(regions.size()), regions.data());
+      regions.clear();
+    }
+  };
+  for (const auto& copy : p.pending) {
+    const VkBuffer copySrc = copy.src ? copy.src : buffer;
+    bool hazard = false;
+    for (const auto& w : written) {
+      if (w.buffer == copySrc ||
+          (w.buffer == copy.dst && copy.region.dstOffset < w.end &&
+           w.begin < copy.region.dstOffset + copy.region.size)) {
+        hazard = true;
+        break;
+      }
+    }
+    if (copySrc != src || copy.dst != dst || hazard) {
+      flush();
+    }
+    if (hazard) {
+      VkMemoryBarrier transfer{};
+      transfer.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+      vkCmdPipelineBarrier(
+          commandBuffer,
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          0,
+          1,
+          &transfer,
+          0,
+          nullptr,
+          0,
+          nullptr);
+      written.clear();
+    }
+    src = copySrc;
+    dst = copy.dst;
+    regions.push_back(copy.region);
+
+    // widen the written span of dst (exact for the sorted, disjoint ranges we usually get)
+    bool found = false;
+    for (auto& w : written) {
+      if (w.buffer == dst) {
+        w.begin = std::min(w.begin, copy.region.dstOffset);
+        w.end = std::max(w.end, copy.region.dstOffset + copy.region.size);
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      written.push_back({dst, copy.region.dstOffset, copy.region.dstOffset + copy.region.size});
+    }
+  }
+  flush();
+  p.pending.clear();
+
+  // RAW: make the copies visible to vertex/index fetch in the render pass that follows
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+}
+
+void VulkanStagingRing::Destroy() {
+  if (buffer) {
+    vkDestroyBuffer(logicalDevice, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+  }
+  if (allocator) {
+    allocator->Free(allocation);
+  }
+  partitions.clear();
+  if (overflowCount > 0) {
+    Logger::Debugf("staging ring overflowed %u times.", overflowCount);
+  }
+}
+
+}  // namespace mks
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "Base.hpp"
+#include "VulkanAllocator.hpp"
+
+namespace mks {
+
+/**
+ * Persistently mapped staging buffer, split into one partition per frame in flight.
+ *
+ * Uploads are memcpy'd into the current frame's partition, and the copies are
+ * recorded into that frame's own command buffer (ahead of the render pass),
+ * so the CPU never waits on the GPU to finish a transfer.
+ *
+ * A partition is only reused after the fence of the frame which consumed it
+ * has signaled; see Open().
+ */
+class VulkanStagingRing {
+ public:
+  /**
+   * Bytes of staging space per frame in flight.
+   * Uploads which don't fit fall back to a synchronous copy.
+   */
+  static const VkDeviceSize DEFAULT_FRAME_SIZE = 4 * 1024 * 1024;
+
+  VulkanStagingRing();
+  ~VulkanStagingRing();
+
+  void Init(
+      VkDevice logicalDevice,
+      VulkanAllocator* allocator,
+      u8 frameCount,
+      VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+
+  /**
+   * Rewind a frame's partition.
+   * Only call once the fence of the last submit to use this partition has signaled.
+   */
+  void Open(u8 frame);
+  bool IsOpen(u8 frame) const;
+
+  /**
+   * Copy bytes into the frame's partition, and queue a copy into dst.
+   *
+   * @return - false if the ring is uninitialized, the partition is not open,
+   *           or there is insufficient space; caller must upload some other way.
+   */
+  bool Stage(u8 frame, VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+  /**
+   * Queue a device-side copy between two buffers (ie. when growing a buffer),
+   * ordered after every copy staged before it.
+   *
+   * @return - false if the ring is uninitialized or the partition is not open.
+   */
+  bool StageBufferCopy(u8 frame, VkBuffer src, VkBuffer dst, const VkBufferCopy& region);
+
+  bool HasPending(u8 frame) const;
+
+  /**
+   * Record all queued copies, wrapped in barriers against vertex input.
+   * Must be called outside of a render pass. Closes the partition.
+   */
+  void Record(u8 frame, VkCommandBuffer commandBuffer);
+
+  void Destroy();
+
+  /**
+   * Lifetime count of uploads which did not fit.
+   */
+  u32 overflowCount = 0;
+
+ private:
+  struct PendingCopy {
+    // VK_NULL_HANDLE means the ring buffer itself
+    VkBuffer src;
+    VkBuffer dst;
+    VkBufferCopy region;
+  };
+
+  struct Partition {
+    VkDeviceSize head = 0;
+    bool open = false;
+    std::vector<PendingCopy> pending = {};
+  };
+
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VulkanAllocator* allocator = nullptr;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VulkanAllocation allocation = {};
+  VkDeviceSize frameSize = 0;
+  std::vector<Partition> partitions = {};
+};
+
+}  // namespace mks
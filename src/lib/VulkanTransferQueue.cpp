@@ -0,0 +1,377 @@
+#include "VulkanTransferQueue.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include "Base.hpp"
+#include "Logger.hpp"
+
+namespace {
+
+// how uploaded buffers are used afterward: drawn from, or copied into by the staging ring
+const VkPipelineStageFlags BUFFER_STAGES =
+    VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+const VkAccessFlags BUFFER_ACCESS = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+VkImageMemoryBarrier ImageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  return barrier;
+}
+
+VkBufferMemoryBarrier BufferBarrier(VkBuffer buffer) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  return barrier;
+}
+
+}  // namespace
+
+namespace mks {
+
+VulkanTransferQueue::VulkanTransferQueue() {
+}
+
+VulkanTransferQueue::~VulkanTransferQueue() {
+}
+
+void VulkanTransferQueue::Init(
+    VkDevice logicalDevice,
+    VulkanAllocator* allocator,
+    VkQueue queue,
+    u32 queueFamily,
+    u32 graphicsFamily) {
+  this->logicalDevice = logicalDevice;
+  this->allocator = allocator;
+  this->queue = queue;
+  this->queueFamily = queueFamily;
+  this->graphicsFamily = graphicsFamily;
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+  if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw Logger::Errorf("vkCreateCommandPool transfer failed.");
+  }
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+    throw Logger::Errorf("vkCreateSemaphore transfer timeline failed.");
+  }
+
+  Logger::Debugf(
+      "transfer queue: family %u (%s)",
+      queueFamily,
+      IsDedicated() ? "dedicated" : "shared with graphics");
+}
+
+bool VulkanTransferQueue::IsReady() const {
+  return VK_NULL_HANDLE != timeline;
+}
+
+bool VulkanTransferQueue::IsDedicated() const {
+  return queueFamily != graphicsFamily;
+}
+
+VkCommandBuffer VulkanTransferQueue::Begin(const void* data, VkDeviceSize size, InFlight& upload) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &upload.staging) != VK_SUCCESS) {
+    throw Logger::Errorf("failed to create transfer staging buffer!");
+  }
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(logicalDevice, upload.staging, &memRequirements);
+  upload.stagingAllocation = allocator->Allocate(
+      memRequirements,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      ResourceKind::Buffer,
+      AllocationStrategy::Linear);
+  if (vkBindBufferMemory(
+          logicalDevice,
+          upload.staging,
+          upload.stagingAllocation.memory,
+          upload.stagingAllocation.offset) != VK_SUCCESS) {
+    throw Logger::Errorf("failed to bind transfer staging buffer memory!");
+  }
+  memcpy(upload.stagingAllocation.mapped, data, static_cast<size_t>(size));
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &upload.commandBuffer) != VK_SUCCESS) {
+    throw Logger::Errorf("vkAllocateCommandBuffers transfer failed.");
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+
+  uploadCount++;
+  uploadBytes += size;
+  return upload.commandBuffer;
+}
+
+void VulkanTransferQueue::Submit(InFlight& upload) {
+  if (vkEndCommandBuffer(upload.commandBuffer) != VK_SUCCESS) {
+    throw Logger::Errorf("vkEndCommandBuffer transfer failed.");
+  }
+
+  upload.value = ++submitted;
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &upload.value;
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &upload.commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &timeline;
+
+  if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw Logger::Errorf("vkQueueSubmit transfer failed.");
+  }
+  inFlight.push_back(upload);
+}
+
+void VulkanTransferQueue::UploadImage(
+    VkImage image, const void* pixels, VkDeviceSize size, u32 width, u32 height) {
+  if (!IsReady()) {
+    throw Logger::Errorf("transfer queue used before Init().");
+  }
+  InFlight upload{};
+  VkCommandBuffer commandBuffer = Begin(pixels, size, upload);
+
+  auto barrier =
+      ImageBarrier(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      1,
+      &barrier);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {width, height, 1};
+  vkCmdCopyBufferToImage(
+      commandBuffer,
+      upload.staging,
+      image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      1,
+      &region);
+
+  barrier = ImageBarrier(
+      image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  if (IsDedicated()) {
+    // release; the layout transition happens once, as part of the matching acquire.
+    // access and stages on the other queue family don't apply here.
+    barrier.srcQueueFamilyIndex = queueFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    acquires.push_back({image, VK_NULL_HANDLE});
+  } else {
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      dstStage,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      1,
+      &barrier);
+
+  Submit(upload);
+}
+
+void VulkanTransferQueue::UploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size) {
+  if (!IsReady()) {
+    throw Logger::Errorf("transfer queue used before Init().");
+  }
+  InFlight upload{};
+  VkCommandBuffer commandBuffer = Begin(data, size, upload);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.size = size;
+  vkCmdCopyBuffer(commandBuffer, upload.staging, buffer, 1, &copyRegion);
+
+  auto barrier = BufferBarrier(buffer);
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  VkPipelineStageFlags dstStage = BUFFER_STAGES;
+  if (IsDedicated()) {
+    barrier.srcQueueFamilyIndex = queueFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    acquires.push_back({VK_NULL_HANDLE, buffer});
+  } else {
+    barrier.dstAccessMask = BUFFER_ACCESS;
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      dstStage,
+      0,
+      0,
+      nullptr,
+      1,
+      &barrier,
+      0,
+      nullptr);
+
+  Submit(upload);
+}
+
+VulkanTransferQueue::Wait VulkanTransferQueue::RecordAcquires(VkCommandBuffer commandBuffer) {
+  Wait wait{};
+  if (acquires.empty()) {
+    return wait;
+  }
+
+  // NOTICE: the submit waits on the semaphore at these stages, and each acquire's source
+  // scope is the same stages, so the two form one dependency chain after the release.
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  for (const auto& acquire : acquires) {
+    if (acquire.image) {
+      auto barrier = ImageBarrier(
+          acquire.image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      barrier.srcQueueFamilyIndex = queueFamily;
+      barrier.dstQueueFamilyIndex = graphicsFamily;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      imageBarriers.push_back(barrier);
+      wait.stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else {
+      auto barrier = BufferBarrier(acquire.buffer);
+      barrier.srcQueueFamilyIndex = queueFamily;
+      barrier.dstQueueFamilyIndex = graphicsFamily;
+      barrier.dstAccessMask = BUFFER_ACCESS;
+      bufferBarriers.push_back(barrier);
+      wait.stages |= BUFFER_STAGES;
+    }
+  }
+  acquires.clear();
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      wait.stages,
+      wait.stages,
+      0,
+      0,
+      nullptr,
+      static_cast<u32>(bufferBarriers.size()),
+      bufferBarriers.data(),
+      static_cast<u32>(imageBarriers.size()),
+      imageBarriers.data());
+
+  wait.semaphore = timeline;
+  wait.value = submitted;
+  return wait;
+}
+
+void VulkanTransferQueue::Collect() {
+  if (inFlight.empty()) {
+    return;
+  }
+  u64 completed = 0;
+  if (vkGetSemaphoreCounterValue(logicalDevice, timeline, &completed) != VK_SUCCESS) {
+    throw Logger::Errorf("vkGetSemaphoreCounterValue transfer failed.");
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < inFlight.size(); i++) {
+    auto& upload = inFlight[i];
+    if (upload.value <= completed) {
+      vkFreeCommandBuffers(logicalDevice, commandPool, 1, &upload.commandBuffer);
+      vkDestroyBuffer(logicalDevice, upload.staging, nullptr);
+      allocator->Free(upload.stagingAllocation);
+    } else {
+      inFlight[kept++] = upload;
+    }
+  }
+  inFlight.resize(kept);
+}
+
+void VulkanTransferQueue::WaitIdle() {
+  if (!IsReady() || 0 == submitted) {
+    return;
+  }
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &timeline;
+  waitInfo.pValues = &submitted;
+  if (vkWaitSemaphores(logicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+    throw Logger::Errorf("vkWaitSemaphores transfer failed.");
+  }
+  Collect();
+}
+
+void VulkanTransferQueue::Destroy() {
+  if (!IsReady()) {
+    return;
+  }
+  WaitIdle();
+  Logger::Debugf(
+      "transfer queue: %u uploads, %llu bytes",
+      uploadCount,
+      (unsigned long long)uploadBytes);
+  vkDestroySemaphore(logicalDevice, timeline, nullptr);
+  timeline = VK_NULL_HANDLE;
+  vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+  commandPool = VK_NULL_HANDLE;
+  acquires.clear();
+}
+
+}  // namespace mks
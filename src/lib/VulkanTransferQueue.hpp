@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "Base.hpp"
+#include "VulkanAllocator.hpp"
+
+namespace mks {
+
+/**
+ * Uploads on their own queue, without stalling the CPU or the graphics queue.
+ *
+ * Each upload copies from its own staging buffer, in a command buffer submitted to the
+ * transfer queue right away; the submit signals the next value of a timeline semaphore.
+ * The CPU never waits on it: staging memory is freed by Collect(), once the semaphore
+ * has passed that value.
+ *
+ * With a dedicated transfer queue family, resources are released by the transfer queue
+ * and must be acquired by the graphics queue before use (a queue family ownership
+ * transfer). RecordAcquires() records the acquire half into the next graphics command
+ * buffer, and returns what that submit must wait on. Without one (transfer queue is the
+ * graphics queue), the upload ends with a plain barrier and no acquire is needed.
+ */
+class VulkanTransferQueue {
+ public:
+  /**
+   * What a graphics submit must wait on, before using acquired resources.
+   */
+  struct Wait {
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    // timeline value; 0 means nothing to wait on
+    u64 value = 0;
+    VkPipelineStageFlags stages = 0;
+  };
+
+  VulkanTransferQueue();
+  ~VulkanTransferQueue();
+
+  /**
+   * @param queue - May be the graphics queue itself, when there is no transfer family.
+   */
+  void Init(
+      VkDevice logicalDevice,
+      VulkanAllocator* allocator,
+      VkQueue queue,
+      u32 queueFamily,
+      u32 graphicsFamily);
+
+  /**
+   * Whether Init() succeeded; uploads throw until it has.
+   */
+  bool IsReady() const;
+  /**
+   * Whether uploads run on a queue family of their own.
+   */
+  bool IsDedicated() const;
+
+  /**
+   * Fill a new image (in UNDEFINED layout), leaving it SHADER_READ_ONLY_OPTIMAL for the
+   * fragment shader.
+   */
+  void UploadImage(VkImage image, const void* pixels, VkDeviceSize size, u32 width, u32 height);
+  /**
+   * Fill a new vertex or index buffer, which nothing else has written to yet.
+   */
+  void UploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size);
+
+  /**
+   * Record acquire barriers for everything uploaded since the last call.
+   * Must be called outside of a render pass, on the graphics queue family.
+   */
+  Wait RecordAcquires(VkCommandBuffer commandBuffer);
+
+  /**
+   * Free staging memory of uploads which have finished.
+   */
+  void Collect();
+  /**
+   * Block until every upload has finished; then Collect().
+   */
+  void WaitIdle();
+  void Destroy();
+
+  // lifetime totals
+  u32 uploadCount = 0;
+  u64 uploadBytes = 0;
+
+ private:
+  struct InFlight {
+    u64 value;
+    VkCommandBuffer commandBuffer;
+    VkBuffer staging;
+    VulkanAllocation stagingAllocation;
+  };
+  struct Acquire {
+    VkImage image;
+    VkBuffer buffer;
+  };
+
+  VkCommandBuffer Begin(const void* data, VkDeviceSize size, InFlight& upload);
+  void Submit(InFlight& upload);
+
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VulkanAllocator* allocator = nullptr;
+  VkQueue queue = VK_NULL_HANDLE;
+  u32 queueFamily = 0;
+  u32 graphicsFamily = 0;
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkSemaphore timeline = VK_NULL_HANDLE;
+  // last value signaled by a submit
+  u64 submitted = 0;
+  std::vector<InFlight> inFlight = {};
+  // released by the transfer queue, not yet acquired by the graphics queue
+  std::vector<Acquire> acquires = {};
+};
+
+}  // namespace mks
@@ -4,11 +4,14 @@
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <exception>
 #include <functional>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 #include "Base.hpp"
+#include "FramePacer.hpp"
 #include "Gamepad.hpp"
 #include "Keyboard.hpp"
 #include "Logger.hpp"
@@ -88,106 +91,248 @@ void Window::KeepAspectRatio(const u32 width, const u32 height) {
   v.framebufferResized = true;
 }
 
+void Window::PollEvents(const bool queueInput) {
+  SDL_Event e;
+  while (SDL_PollEvent(&e) > 0) {
+    switch (e.type) {
+      case SDL_WINDOWEVENT:
+        switch (e.window.event) {
+          case SDL_WINDOWEVENT_MINIMIZED:
+            v.minimized = true;
+            break;
+
+          case SDL_WINDOWEVENT_RESTORED:
+            v.minimized = false;
+            v.maximized = false;
+            break;
+
+          case SDL_WINDOWEVENT_MAXIMIZED:
+            v.maximized = true;
+            break;
+
+          // case SDL_WINDOWEVENT_RESIZED:
+          case SDL_WINDOWEVENT_SIZE_CHANGED:
+            v.minimized = false;
+            KeepAspectRatio(e.window.data1, e.window.data2);
+            break;
+        }
+        break;
+
+      case SDL_QUIT:
+        quit = true;
+        break;
+    }
+
+    // keyboard, joystick, and game controller events
+    const bool isInput = (e.type >= SDL_KEYDOWN && e.type < SDL_MOUSEMOTION) ||
+                         (e.type >= SDL_JOYAXISMOTION && e.type < SDL_FINGERDOWN);
+    if (!isInput) {
+      continue;
+    }
+    if (queueInput) {
+      std::lock_guard<std::mutex> lock(inputMutex);
+      if (pendingStamp.polled == FramePacer::Clock::time_point{}) {
+        pendingStamp.polled = FramePacer::Clock::now();
+      }
+      pendingInput.push_back(e);
+    } else {
+      if (pendingStamp.polled == FramePacer::Clock::time_point{}) {
+        pendingStamp.polled = FramePacer::Clock::now();
+      }
+      mks::Gamepad::OnInput(e);
+      mks::Keyboard::OnInput(e);
+    }
+
+    // SDL_UpdateWindowSurface(window);
+  }
+}
+
+void Window::RecordInputLatency(const InputStamp& stamp) {
+  // the same snapshot may be drawn several times; count it once
+  if (stamp.polled == FramePacer::Clock::time_point{} || stamp.polled == lastLatencyStamp) {
+    return;
+  }
+  lastLatencyStamp = stamp.polled;
+  inputLatency.Add(
+      std::chrono::duration<f64, std::milli>(FramePacer::Clock::now() - stamp.polled).count());
+}
+
+void Window::UpdateTitle(const int renderFps, const float deltaTime) {
+  frameCount++;
+  if (frameCount >= renderFps) {
+    const u8 fpsAvg = 1 / (deltaTime / frameCount);
+    // if titlebar updates are tracking with the wall clock seconds hand, then loop is on-time
+    // the value shown is potential frames (ie. accounts for spare cycles)
+    char title[255];
+    sprintf(title, "%s | pFPS: %u", this->title, fpsAvg);
+    SDL_SetWindowTitle(window, title);
+    frameCount = 0;
+  }
+}
+
+void Window::LogLoopStats() const {
+  renderPacer.stats.Log("render interval");
+  if (simulationStats.count > 0) {
+    simulationStats.Log("simulation tick");
+  }
+  if (inputLatency.count > 0) {
+    inputLatency.Log("input latency");
+  }
+  if (physics.droppedCount > 0) {
+    Logger::Infof(
+        "physics steps: %llu, dropped: %llu",
+        (unsigned long long)physics.stepCount,
+        (unsigned long long)physics.droppedCount);
+  }
+  if (renderPacer.missedCount > 0) {
+    Logger::Infof("render deadlines missed: %u", renderPacer.missedCount);
+  }
+}
+
 void Window::RenderLoop(
     const int physicsFps,
     const int renderFps,
     std::function<void(const float)> physicsCallback,
     std::function<void(const float)> renderCallback) {
-  const std::chrono::duration<double, std::milli> physicsInterval(1000.0f / physicsFps);
-  const std::chrono::duration<double, std::milli> renderInterval(1000.0f / renderFps);
-  auto lastPhysics = std::chrono::high_resolution_clock::now();
-  auto lastRender = std::chrono::high_resolution_clock::now();
-  auto currentTime = std::chrono::high_resolution_clock::now();
-  std::chrono::duration<double, std::milli> elapsedPhysics = currentTime - lastPhysics;
-  std::chrono::duration<double, std::milli> elapsedRender = currentTime - lastRender;
-
-  float deltaTime = 0;
-  u8 frameCount = 0;
-  u8 fpsAvg = 0;
-  char title[255];
-  SDL_Event e;
+  physics.Start(physicsFps, maxPhysicsSteps);
+  renderPacer.Start(1000.0 / renderFps);
+  frameCount = 0;
+
   while (!quit) {
-    // input handling
-    while (SDL_PollEvent(&e) > 0) {
-      switch (e.type) {
-        case SDL_WINDOWEVENT:
-          switch (e.window.event) {
-            case SDL_WINDOWEVENT_MINIMIZED:
-              v.minimized = true;
-              break;
-
-            case SDL_WINDOWEVENT_RESTORED:
-              v.minimized = false;
-              v.maximized = false;
-              break;
-
-            case SDL_WINDOWEVENT_MAXIMIZED:
-              v.maximized = true;
-              break;
-
-            // case SDL_WINDOWEVENT_RESIZED:
-            case SDL_WINDOWEVENT_SIZE_CHANGED:
-              v.minimized = false;
-              KeepAspectRatio(e.window.data1, e.window.data2);
-              break;
-          }
-          break;
+    PollEvents(false);
 
-        case SDL_QUIT:
-          quit = true;
-          break;
-      }
+    if (v.minimized) {
+      // nothing to draw; idle a frame at a time, and don't count the gap as missed frames
+      std::this_thread::sleep_for(std::chrono::duration<f64, std::milli>(renderPacer.intervalMs));
+      physics.Resync();
+      renderPacer.Resync();
+      continue;
+    }
 
-      mks::Gamepad::OnInput(e);
-      mks::Keyboard::OnInput(e);
+    // Physics update; always a whole number of constant steps, so it's reproducible
+    const u32 steps = physics.Accumulate(FramePacer::Clock::now());
+    for (u32 i = 0; i < steps; i++) {
+      physicsCallback(physics.stepSeconds);
+    }
+
+    // Render update
+    auto currentTime = FramePacer::Clock::now();
+    // no image to draw to means the window was minimized; the next pass idles
+    if (renderPacer.IsDue(currentTime) && v.AwaitNextFrame()) {
+      // render
+
+      const float deltaTime = renderPacer.Tick(FramePacer::Clock::now());
+
+      renderCallback(deltaTime);
+      v.DrawFrame();
+      RecordInputLatency(pendingStamp);
+      pendingStamp = {};
+
+      UpdateTitle(renderFps, deltaTime);
+    }
+
+    // wait precisely for whichever update is due next
+    renderPacer.SleepUntil(std::min(physics.NextStep(), renderPacer.Deadline()));
+  }
+
+  LogLoopStats();
+}
+
+void Window::RenderLoopThreaded(
+    const int physicsFps,
+    const int renderFps,
+    std::function<void(const float)> physicsCallback,
+    std::function<void(const float, const InputStamp&)> updateCallback,
+    std::function<InputStamp(const float)> renderCallback) {
+  physics.Start(physicsFps, maxPhysicsSteps);
+  renderPacer.Start(1000.0 / renderFps);
+  frameCount = 0;
+
+  std::exception_ptr simulationError = nullptr;
+  std::thread simulation([&] {
+    try {
+      // owns its own pacer, for SleepUntil() between ticks
+      FramePacer pacer{};
+      auto lastUpdate = FramePacer::Clock::now();
+      std::vector<SDL_Event> events;
+      InputStamp stamp{};
+      while (!quit) {
+        {
+          std::lock_guard<std::mutex> lock(inputMutex);
+          events.swap(pendingInput);
+          // input applied during a tick with no steps is reported by the next one
+          if (stamp.polled == FramePacer::Clock::time_point{}) {
+            stamp = pendingStamp;
+          }
+          pendingStamp = {};
+        }
+        for (const auto& e : events) {
+          mks::Gamepad::OnInput(e);
+          mks::Keyboard::OnInput(e);
+        }
+        events.clear();
+
+        const auto begin = FramePacer::Clock::now();
+        const u32 steps = physics.Accumulate(begin);
+        if (steps > 0) {
+          for (u32 i = 0; i < steps; i++) {
+            physicsCallback(physics.stepSeconds);
+          }
+          updateCallback(std::chrono::duration<f32>(begin - lastUpdate).count(), stamp);
+          lastUpdate = begin;
+          stamp = {};
+          simulationStats.Add(
+              std::chrono::duration<f64, std::milli>(FramePacer::Clock::now() - begin).count());
+        }
 
-      // SDL_UpdateWindowSurface(window);
+        pacer.SleepUntil(physics.NextStep());
+      }
+    } catch (...) {
+      simulationError = std::current_exception();
+      quit = true;
     }
+  });
+
+  // a joinable thread must not be destroyed; stop and join the simulation before any
+  // render thread error leaves this scope
+  try {
+    while (!quit) {
+      PollEvents(true);
 
-    if (!v.minimized) {
-      // Physics update
-      currentTime = std::chrono::high_resolution_clock::now();
-      elapsedPhysics = currentTime - lastPhysics;
-      if (elapsedPhysics > physicsInterval) {
-        deltaTime =
-            std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastPhysics)
-                .count();
-        lastPhysics = currentTime;
-
-        physicsCallback(deltaTime);
+      if (v.minimized) {
+        // the simulation carries on; there's just nothing to draw
+        std::this_thread::sleep_for(std::chrono::duration<f64, std::milli>(renderPacer.intervalMs));
+        renderPacer.Resync();
+        continue;
       }
 
-      // Render update
-      currentTime = std::chrono::high_resolution_clock::now();
-      elapsedRender = currentTime - lastRender;
-      if (elapsedRender > renderInterval) {
-        // render
-        v.AwaitNextFrame();
+      auto currentTime = FramePacer::Clock::now();
+      // no image to draw to means the window was minimized; the next pass idles
+      if (renderPacer.IsDue(currentTime) && v.AwaitNextFrame()) {
 
-        currentTime = std::chrono::high_resolution_clock::now();
-        deltaTime =
-            std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastRender)
-                .count();
-        lastRender = currentTime;
+        const float deltaTime = renderPacer.Tick(FramePacer::Clock::now());
 
-        renderCallback(deltaTime);
+        const InputStamp stamp = renderCallback(deltaTime);
         v.DrawFrame();
+        RecordInputLatency(stamp);
 
-        frameCount++;
-        if (frameCount >= renderFps) {
-          fpsAvg = 1 / (deltaTime / frameCount);
-          // if titlebar updates are tracking with the wall clock seconds hand, then loop is on-time
-          // the value shown is potential frames (ie. accounts for spare cycles)
-          sprintf(title, "%s | pFPS: %u", this->title, fpsAvg);
-          SDL_SetWindowTitle(window, title);
-          frameCount = 0;
-        }
+        UpdateTitle(renderFps, deltaTime);
       }
+
+      renderPacer.SleepUntil(renderPacer.Deadline());
     }
+  } catch (...) {
+    quit = true;
+    simulation.join();
+    throw;
+  }
 
-    // sleep to control the frame rate
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  simulation.join();
+  if (simulationError) {
+    std::rethrow_exception(simulationError);
   }
+
+  LogLoopStats();
 }
 
 void Window::End() {
@@ -4,12 +4,24 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
 
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <vector>
 
+#include "FramePacer.hpp"
 #include "Vulkan.hpp"
 
 namespace mks {
 
+/**
+ * Tags a simulation snapshot with the input it first reflects, to measure input latency.
+ */
+struct InputStamp {
+  // when the oldest such input event was polled; the epoch if there was none
+  FramePacer::Clock::time_point polled = {};
+};
+
 class Window {
  public:
   struct DrawableArea {
@@ -29,11 +41,54 @@ class Window {
       const int renderFps,
       std::function<void(const float)> physicsCallback,
       std::function<void(const float)> renderCallback);
+  /**
+   * Like RenderLoop(), but simulation runs on its own thread, so a slow GPU frame
+   * doesn't stall gameplay, and a slow simulation tick doesn't stall presentation.
+   *
+   * Simulation thread: physicsCallback in fixed steps, then updateCallback once per tick;
+   * updateCallback should publish a snapshot for rendering (ie. via TripleBuffer),
+   * tagged with the given InputStamp. Gamepad and Keyboard state is only updated here.
+   *
+   * Calling thread: polls window events, forwards input, and calls renderCallback,
+   * which draws the latest snapshot and returns its stamp.
+   */
+  void RenderLoopThreaded(
+      const int physicsFps,
+      const int renderFps,
+      std::function<void(const float)> physicsCallback,
+      std::function<void(const float, const InputStamp&)> updateCallback,
+      std::function<InputStamp(const float)> renderCallback);
   void End();
 
-  bool quit = false;
+  std::atomic<bool> quit = false;
   SDL_Window* window;
   const char* title;
   Vulkan v = {};
+  // physics steps simulated per render frame, at most; see FixedTimestep::Start()
+  u32 maxPhysicsSteps = 5;
+  // for RenderLoop() callbacks to inspect; ie. physics.Alpha() to interpolate rendering
+  FixedTimestep physics = {};
+  FramePacer renderPacer = {};
+  // from input event poll to the submit of the first frame which reflects it
+  FrameTimeStats inputLatency = {};
+  // RenderLoopThreaded() only; time spent per simulation tick
+  FrameTimeStats simulationStats = {};
+
+ private:
+  /**
+   * Handle window events. Input events are either applied here, or queued for the
+   * simulation thread.
+   */
+  void PollEvents(const bool queueInput);
+  void RecordInputLatency(const InputStamp& stamp);
+  void UpdateTitle(const int renderFps, const float deltaTime);
+  void LogLoopStats() const;
+
+  // input polled but not yet applied (threaded), or not yet drawn (single-threaded)
+  std::mutex inputMutex;
+  std::vector<SDL_Event> pendingInput = {};
+  InputStamp pendingStamp = {};
+  FramePacer::Clock::time_point lastLatencyStamp = {};
+  u8 frameCount = 0;
 };
 }  // namespace mks
\ No newline at end of file
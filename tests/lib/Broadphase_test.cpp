@@ -0,0 +1,220 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/Broadphase.hpp"
+#include "../../src/lib/Logger.hpp"
+
+namespace {
+
+// same layout as the Pong_test instance VBO; the broadphase reads pos in place
+struct Instance {
+  glm::vec3 pos{0.0f, 0.0f, 0.0f};
+  glm::vec3 rot{0.0f, 0.0f, 0.0f};
+  glm::vec3 scale{1.0f, 1.0f, 1.0f};
+  u32 texId{0};
+};
+
+const u32 FRAMES = 30;
+const f32 DT = 1.0f / 60;
+const f32 BOX_WH = 0.02f;
+
+const char* ModeName(mks::Broadphase::Mode mode) {
+  return mks::Broadphase::Mode::SPATIAL_HASH == mode ? "spatial hash" : "sweep and prune";
+}
+
+f32 random(f32 a, f32 b) {
+  return a + (((f32)rand()) / (f32)RAND_MAX) * (b - a);
+}
+
+/**
+ * Boxes wandering within [-extent, extent], bouncing off its edges.
+ */
+struct Scene {
+  std::vector<Instance> instances = {};
+  std::vector<glm::vec2> velocity = {};
+  f32 extent = 0;
+
+  Scene(u32 count, f32 extent) : extent(extent) {
+    instances.resize(count);
+    velocity.resize(count);
+    for (u32 i = 0; i < count; i++) {
+      instances[i].pos = glm::vec3(random(-extent, extent), random(-extent, extent), 0);
+      instances[i].scale = glm::vec3(BOX_WH, BOX_WH * random(0.5f, 2), 1);
+      velocity[i] = glm::vec2(random(-1, 1), random(-1, 1));
+    }
+  }
+
+  void Step() {
+    for (u32 i = 0; i < instances.size(); i++) {
+      auto& pos = instances[i].pos;
+      pos.x += velocity[i].x * DT;
+      pos.y += velocity[i].y * DT;
+      if (pos.x < -extent || pos.x > extent) {
+        velocity[i].x = -velocity[i].x;
+      }
+      if (pos.y < -extent || pos.y > extent) {
+        velocity[i].y = -velocity[i].y;
+      }
+    }
+  }
+
+  void AddTo(mks::Broadphase& broadphase) const {
+    for (const auto& instance : instances) {
+      broadphase.Add(instance.pos.x, instance.pos.y, instance.scale.x / 2, instance.scale.y / 2);
+    }
+  }
+
+  std::vector<u64> BruteForce() const {
+    std::vector<u64> pairs;
+    for (u32 a = 0; a < instances.size(); a++) {
+      const auto& pa = instances[a].pos;
+      const auto& ha = instances[a].scale / 2.0f;
+      for (u32 b = a + 1; b < instances.size(); b++) {
+        const auto& pb = instances[b].pos;
+        const auto& hb = instances[b].scale / 2.0f;
+        if (pa.x - ha.x <= pb.x + hb.x && pb.x - hb.x <= pa.x + ha.x &&
+            pa.y - ha.y <= pb.y + hb.y && pb.y - hb.y <= pa.y + ha.y) {
+          pairs.push_back(static_cast<u64>(a) << 32 | b);
+        }
+      }
+    }
+    return pairs;
+  }
+};
+
+/**
+ * Both modes must find exactly the pairs an all-pairs test does, frame after frame.
+ */
+bool CheckAgainstBruteForce(mks::Broadphase::Mode mode) {
+  srand(1);
+  Scene scene(2000, 1);
+  mks::Broadphase broadphase{};
+  broadphase.SetMode(mode, BOX_WH * 2);
+  scene.AddTo(broadphase);
+  std::vector<u64> pairs;
+  for (u32 frame = 0; frame < FRAMES; frame++) {
+    scene.Step();
+    broadphase.MoveAll(&scene.instances[0].pos, sizeof(Instance));
+    broadphase.FindPairs(pairs);
+    if (pairs != scene.BruteForce()) {
+      mks::Logger::Infof("FAIL %s: wrong pairs on frame %u", ModeName(mode), frame);
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Bodies far outside of s32 cells (or at NaN) must still be handled; the far ones must
+ * find each other, and nothing else.
+ */
+bool CheckFarAway(mks::Broadphase::Mode mode) {
+  mks::Broadphase broadphase{};
+  broadphase.SetMode(mode, BOX_WH * 2);
+  broadphase.Add(0, 0, BOX_WH, BOX_WH);
+  broadphase.Add(1e30f, -1e30f, BOX_WH, BOX_WH);
+  broadphase.Add(1e30f, -1e30f, BOX_WH, BOX_WH);
+  broadphase.Add(-3e9f, 3e9f, BOX_WH, BOX_WH);
+  broadphase.Add(NAN, 0, BOX_WH, BOX_WH);
+  std::vector<u64> pairs;
+  broadphase.FindPairs(pairs);
+  bool ok = std::vector<u64>{1ull << 32 | 2} == pairs;
+  // and moving there, or back
+  broadphase.Move(0, -1e30f, INFINITY);
+  broadphase.Move(3, 0, 0);
+  broadphase.Move(4, 0, NAN);
+  broadphase.FindPairs(pairs);
+  ok &= std::vector<u64>{1ull << 32 | 2} == pairs;
+  if (!ok) {
+    mks::Logger::Infof("FAIL %s: far away bodies", ModeName(mode));
+  }
+  return ok;
+}
+
+/**
+ * Time both modes on the same moving boxes; they must agree on every pair count.
+ */
+bool Bench(const u32 count) {
+  // about 4 overlaps per box, at any count
+  const f32 extent = std::sqrt(static_cast<f32>(count)) * BOX_WH;
+  u64 pairCount[2] = {};
+  for (const auto mode :
+       {mks::Broadphase::Mode::SPATIAL_HASH, mks::Broadphase::Mode::SWEEP_AND_PRUNE}) {
+    srand(count);
+    Scene scene(count, extent);
+    mks::Broadphase broadphase{};
+    broadphase.SetMode(mode, BOX_WH * 2);
+    scene.AddTo(broadphase);
+
+    // the first frame builds from scratch; the rest are incremental
+    std::vector<u64> pairs;
+    auto begin = std::chrono::high_resolution_clock::now();
+    broadphase.FindPairs(pairs);
+    const f64 buildMs = std::chrono::duration<f64, std::milli>(
+                            std::chrono::high_resolution_clock::now() - begin)
+                            .count();
+    f64 updateMs = 0;
+    u64 total = 0;
+    for (u32 frame = 0; frame < FRAMES; frame++) {
+      scene.Step();
+      begin = std::chrono::high_resolution_clock::now();
+      broadphase.MoveAll(&scene.instances[0].pos, sizeof(Instance));
+      broadphase.FindPairs(pairs);
+      updateMs += std::chrono::duration<f64, std::milli>(
+                      std::chrono::high_resolution_clock::now() - begin)
+                      .count();
+      total += pairs.size();
+    }
+    pairCount[static_cast<u32>(mode)] = total;
+    mks::Logger::Infof(
+        "%6u boxes, %-15s: build %7.3fms, update %7.3fms/frame, %7.1f pairs/frame",
+        count,
+        ModeName(mode),
+        buildMs,
+        updateMs / FRAMES,
+        (f64)total / FRAMES);
+  }
+  if (pairCount[0] != pairCount[1]) {
+    mks::Logger::Infof("FAIL %u boxes: modes disagree on pair counts", count);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin Broadphase test.");
+    bool ok = true;
+
+    ok &= CheckAgainstBruteForce(mks::Broadphase::Mode::SPATIAL_HASH);
+    ok &= CheckAgainstBruteForce(mks::Broadphase::Mode::SWEEP_AND_PRUNE);
+    ok &= CheckFarAway(mks::Broadphase::Mode::SPATIAL_HASH);
+    ok &= CheckFarAway(mks::Broadphase::Mode::SWEEP_AND_PRUNE);
+
+    for (const u32 count : {1000u, 10000u, 100000u}) {
+      ok &= Bench(count);
+    }
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../../src/components/Behavior.hpp"
+#include "../../src/components/Components.hpp"
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/Ecs.hpp"
+#include "../../src/lib/Engine.hpp"
+#include "../../src/lib/Logger.hpp"
+
+namespace {
+
+const u32 ENTITY_COUNT = 100000;
+const u32 REPS = 100;
+const u32 CHURN_FRAMES = 100;
+// entities destroyed and replaced per churn frame
+const u32 CHURN_PER_FRAME = ENTITY_COUNT / 10;
+const f32 DT = 1.0f / 120;
+
+/**
+ * The previous model, for comparison: one heap object per entity, pointing at one heap
+ * allocation per attachment.
+ */
+struct PointerBehavior {
+  void* Animation = nullptr;
+  void* Audio = nullptr;
+  void* Camera = nullptr;
+  void* Collider2D = nullptr;
+  void* Light = nullptr;
+  void* Renderer = nullptr;
+  void* RigidBody2D = nullptr;
+  void* Transform = nullptr;
+  void* Scripts = nullptr;
+
+  ~PointerBehavior() {
+    delete static_cast<mks::Transform*>(Transform);
+    delete static_cast<mks::RigidBody2D*>(RigidBody2D);
+    delete static_cast<mks::Renderer*>(Renderer);
+  }
+};
+
+std::unique_ptr<PointerBehavior> NewPointerBehavior(const u32 i) {
+  auto b = std::make_unique<PointerBehavior>();
+  b->Transform = new mks::Transform{static_cast<f32>(i), 0};
+  // every other entity moves; every one is drawn
+  if (0 == i % 2) {
+    b->RigidBody2D = new mks::RigidBody2D{1, 1};
+  }
+  b->Renderer = new mks::Renderer{i % 4};
+  return b;
+}
+
+void PointerUpdate(std::vector<std::unique_ptr<PointerBehavior>>& objects) {
+  for (auto& b : objects) {
+    if (b->Transform && b->RigidBody2D) {
+      auto t = static_cast<mks::Transform*>(b->Transform);
+      auto body = static_cast<mks::RigidBody2D*>(b->RigidBody2D);
+      t->x += body->vx * DT;
+      t->y += body->vy * DT;
+    }
+  }
+}
+
+mks::Entity NewEntity(mks::Registry& registry, const u32 i) {
+  const auto e = registry.Create();
+  registry.Add<mks::Transform>(e, {static_cast<f32>(i), 0});
+  if (0 == i % 2) {
+    registry.Add<mks::RigidBody2D>(e, {1, 1});
+  }
+  registry.Add<mks::Renderer>(e, {i % 4});
+  return e;
+}
+
+f64 ElapsedNs(std::chrono::high_resolution_clock::time_point begin) {
+  return std::chrono::duration<f64, std::nano>(std::chrono::high_resolution_clock::now() - begin)
+      .count();
+}
+
+bool CheckRegistry() {
+  bool ok = true;
+  mks::Registry registry{};
+  const auto a = registry.Create();
+  const auto b = registry.Create();
+  const auto c = registry.Create();
+  registry.Add<mks::Transform>(a, {1, 0});
+  registry.Add<mks::Transform>(b, {2, 0});
+  registry.Add<mks::Transform>(c, {3, 0});
+  registry.Add<mks::RigidBody2D>(c, {5, 0});
+
+  // removal swaps the last component into the gap; the others must still be intact
+  registry.Destroy(a);
+  ok &= !registry.IsAlive(a) && nullptr == registry.Get<mks::Transform>(a);
+  ok &= 2 == registry.Get<mks::Transform>(b)->x && 3 == registry.Get<mks::Transform>(c)->x;
+  ok &= 2 == registry.Pool<mks::Transform>().Size();
+
+  // the index is reused, but the old handle stays dead
+  const auto d = registry.Create();
+  ok &= d.index == a.index && d.generation != a.generation;
+  ok &= registry.IsAlive(d) && !registry.IsAlive(a);
+  ok &= !registry.Has<mks::Transform>(d);
+  // a stale handle can't add to whichever entity reused its index
+  ok &= nullptr == registry.Add<mks::Transform>(a, {9, 0});
+  ok &= !registry.Has<mks::Transform>(d) && 2 == registry.Pool<mks::Transform>().Size();
+  ok &= nullptr != registry.Add<mks::Transform>(d, {4, 0}) && registry.Has<mks::Transform>(d);
+  registry.Remove<mks::Transform>(d);
+
+  u32 visited = 0;
+  registry.Each<mks::Transform, mks::RigidBody2D>(
+      [&](mks::Entity e, mks::Transform& t, mks::RigidBody2D& body) {
+        ok &= e == c && 3 == t.x && 5 == body.vx;
+        visited++;
+      });
+  ok &= 1 == visited;
+
+  mks::Engine engine{};
+  auto paddle = engine.GetObject("paddle");
+  paddle.Add<mks::Transform>({0, 0});
+  paddle.Add<mks::RigidBody2D>({120, 0});
+  paddle.Add<mks::Renderer>({7});
+  ok &= engine.GetObject("paddle").entity == paddle.entity;
+  engine.Update(DT);
+  engine.Draw();
+  ok &= 1 == engine.drawList.size() && 1 == engine.drawList[0].x && 7 == engine.drawList[0].texId;
+
+  if (!ok) {
+    mks::Logger::Infof("FAIL registry");
+  }
+  return ok;
+}
+
+void BenchIteration() {
+  mks::Engine engine{};
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    NewEntity(engine.registry, i);
+  }
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (u32 r = 0; r < REPS; r++) {
+    engine.Update(DT);
+  }
+  const f64 ecsNs = ElapsedNs(begin) / (static_cast<f64>(ENTITY_COUNT) * REPS);
+
+  std::vector<std::unique_ptr<PointerBehavior>> objects;
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    objects.push_back(NewPointerBehavior(i));
+  }
+  // a long-running game allocates and frees in no particular order
+  std::shuffle(objects.begin(), objects.end(), std::mt19937(1));
+  begin = std::chrono::high_resolution_clock::now();
+  for (u32 r = 0; r < REPS; r++) {
+    PointerUpdate(objects);
+  }
+  const f64 pointerNs = ElapsedNs(begin) / (static_cast<f64>(ENTITY_COUNT) * REPS);
+
+  mks::Logger::Infof("update, %u entities:", ENTITY_COUNT);
+  mks::Logger::Infof("  sparse set:      %6.2f ns/entity", ecsNs);
+  mks::Logger::Infof("  pointer-based:   %6.2f ns/entity", pointerNs);
+}
+
+void BenchChurn() {
+  mks::Engine engine{};
+  auto& registry = engine.registry;
+  std::vector<mks::Entity> entities;
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    entities.push_back(NewEntity(registry, i));
+  }
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (u32 f = 0; f < CHURN_FRAMES; f++) {
+    for (u32 k = 0; k < CHURN_PER_FRAME; k++) {
+      const u32 victim = rand() % ENTITY_COUNT;
+      registry.Destroy(entities[victim]);
+      entities[victim] = NewEntity(registry, victim);
+    }
+  }
+  const f64 ecsNs = ElapsedNs(begin) / (static_cast<f64>(CHURN_FRAMES) * CHURN_PER_FRAME);
+
+  std::vector<std::unique_ptr<PointerBehavior>> objects;
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    objects.push_back(NewPointerBehavior(i));
+  }
+  begin = std::chrono::high_resolution_clock::now();
+  for (u32 f = 0; f < CHURN_FRAMES; f++) {
+    for (u32 k = 0; k < CHURN_PER_FRAME; k++) {
+      const u32 victim = rand() % ENTITY_COUNT;
+      objects[victim] = NewPointerBehavior(victim);
+    }
+  }
+  const f64 pointerNs = ElapsedNs(begin) / (static_cast<f64>(CHURN_FRAMES) * CHURN_PER_FRAME);
+
+  mks::Logger::Infof("destroy + create, %u per frame:", CHURN_PER_FRAME);
+  mks::Logger::Infof("  sparse set:      %6.2f ns/entity", ecsNs);
+  mks::Logger::Infof("  pointer-based:   %6.2f ns/entity", pointerNs);
+
+  // and iteration after all that churn; the dense arrays stay packed
+  begin = std::chrono::high_resolution_clock::now();
+  for (u32 r = 0; r < REPS; r++) {
+    engine.Update(DT);
+  }
+  const f64 afterNs = ElapsedNs(begin) / (static_cast<f64>(ENTITY_COUNT) * REPS);
+  begin = std::chrono::high_resolution_clock::now();
+  for (u32 r = 0; r < REPS; r++) {
+    PointerUpdate(objects);
+  }
+  const f64 pointerAfterNs = ElapsedNs(begin) / (static_cast<f64>(ENTITY_COUNT) * REPS);
+  mks::Logger::Infof("update, after churn:");
+  mks::Logger::Infof("  sparse set:      %6.2f ns/entity", afterNs);
+  mks::Logger::Infof("  pointer-based:   %6.2f ns/entity", pointerAfterNs);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin Ecs test.");
+    srand(1);
+    bool ok = true;
+
+    ok &= CheckRegistry();
+    BenchIteration();
+    BenchChurn();
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
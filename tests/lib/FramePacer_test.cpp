@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/FramePacer.hpp"
+#include "../../src/lib/Logger.hpp"
+
+namespace {
+
+// headless; exercises pacing only, so no window or device is needed
+const u32 FRAMES = 120;
+// median, so a few preempted frames on a busy machine don't fail the test;
+// the old sleep_for(1ms) polling loop is late by ~1ms on every frame
+const f64 MAX_MEDIAN_ERROR_MS = 0.25;
+// with no missed deadlines, absolute deadlines make the average interval exact
+const f64 MAX_MEAN_ERROR_MS = 0.05;
+// ~2% of FRAMES; a preempted frame now and then, not a pacer that can't keep up
+const u32 MAX_MISSED = FRAMES / 50;
+
+struct Result {
+  mks::FrameTimeStats stats = {};
+  std::vector<f64> errors = {};
+  u32 missedCount = 0;
+  f64 intervalMs = 0;
+
+  void Add(const f64 ms) {
+    stats.Add(ms);
+    errors.push_back(std::abs(ms - intervalMs));
+  }
+
+  f64 MedianError() {
+    std::sort(errors.begin(), errors.end());
+    return errors[errors.size() / 2];
+  }
+};
+
+/**
+ * The loop Window::RenderLoop used to run: poll, then sleep 1ms. For comparison only.
+ */
+Result PollingLoop(const f64 intervalMs) {
+  const std::chrono::duration<f64, std::milli> interval(intervalMs);
+  Result result{};
+  result.intervalMs = intervalMs;
+  auto last = std::chrono::steady_clock::now();
+  while (result.stats.count < FRAMES) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last > interval) {
+      result.Add(std::chrono::duration<f64, std::milli>(now - last).count());
+      last = now;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return result;
+}
+
+Result PacedLoop(const f64 intervalMs, const f64 workMs) {
+  mks::FramePacer pacer{};
+  pacer.Start(intervalMs);
+  Result result{};
+  result.intervalMs = intervalMs;
+  while (result.stats.count < FRAMES) {
+    pacer.SleepUntil(pacer.Deadline());
+    result.Add(pacer.Tick(mks::FramePacer::Clock::now()) * 1000.0);
+
+    // simulated frame work; must not shift the deadlines after it
+    const auto until =
+        mks::FramePacer::Clock::now() + std::chrono::duration<f64, std::milli>(workMs);
+    while (mks::FramePacer::Clock::now() < until) {
+    }
+  }
+  result.missedCount = pacer.missedCount;
+  return result;
+}
+
+void Log(const char* label, Result result) {
+  result.stats.Log(label);
+  mks::Logger::Infof(
+      "  median error: %.3fms, missed: %u", result.MedianError(), result.missedCount);
+}
+
+bool Check(const char* label, Result result) {
+  Log(label, result);
+  const f64 meanError = std::abs(result.stats.mean - result.intervalMs);
+  // a missed deadline is resynced (not caught up), which legitimately lengthens the
+  // average; by about one interval per miss
+  const f64 maxMeanError =
+      MAX_MEAN_ERROR_MS + result.missedCount * result.intervalMs / result.stats.count;
+  if (result.MedianError() > MAX_MEDIAN_ERROR_MS || result.missedCount > MAX_MISSED ||
+      meanError > maxMeanError) {
+    mks::Logger::Infof(
+        "FAIL %.60s: mean error: %.3fms (max %.3fms), missed: %u (max %u)",
+        label,
+        meanError,
+        maxMeanError,
+        result.missedCount,
+        MAX_MISSED);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Replay a sequence of frame times through a FixedTimestep, on a synthetic clock.
+ */
+mks::FixedTimestep Replay(const std::vector<f64>& frameMs, const u32 maxSteps) {
+  const auto t0 = mks::FramePacer::Clock::now();
+  mks::FixedTimestep physics{};
+  physics.Start(120, maxSteps, t0);
+  std::chrono::duration<f64, std::milli> t(0);
+  for (u32 i = 0; i < 120; i++) {
+    t += std::chrono::duration<f64, std::milli>(frameMs[i % frameMs.size()]);
+    physics.Accumulate(
+        t0 + std::chrono::duration_cast<mks::FramePacer::Clock::duration>(t));
+    if (physics.Alpha() < 0 || physics.Alpha() >= 1) {
+      mks::Logger::Infof("FAIL alpha out of range: %f", physics.Alpha());
+      physics.stepCount = 0;
+      break;
+    }
+  }
+  return physics;
+}
+
+bool CheckFixedTimestep() {
+  bool ok = true;
+  // the same 1.5s of wall time, split into very different frames, must simulate the same steps
+  const u64 smooth = Replay({12.5}, 5).stepCount;
+  const u64 jittery = Replay({3, 20, 1, 26}, 5).stepCount;
+  mks::Logger::Infof(
+      "fixed steps, smooth: %llu, jittery: %llu",
+      (unsigned long long)smooth,
+      (unsigned long long)jittery);
+  ok &= 180 == smooth && smooth == jittery;
+
+  // a 500ms hitch is clamped to maxSteps, instead of a 60 step catch-up
+  const auto hitch = Replay({500}, 5);
+  mks::Logger::Infof(
+      "fixed steps after hitches: %llu, dropped: %llu",
+      (unsigned long long)hitch.stepCount,
+      (unsigned long long)hitch.droppedCount);
+  ok &= 120 * 5 == hitch.stepCount && 120 * 55 == hitch.droppedCount;
+
+  if (!ok) {
+    mks::Logger::Infof("FAIL fixed timestep");
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin FramePacer test.");
+    bool ok = true;
+
+    ok &= CheckFixedTimestep();
+
+    Log("60Hz, sleep_for(1ms) polling", PollingLoop(1000.0 / 60));
+    ok &= Check("60Hz, paced, idle", PacedLoop(1000.0 / 60, 0));
+    ok &= Check("144Hz, paced, idle", PacedLoop(1000.0 / 144, 0));
+    ok &= Check("60Hz, paced, 8ms of work", PacedLoop(1000.0 / 60, 8));
+
+    // under load: all hardware threads but ours are busy (at least one)
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> load;
+    const u32 loadThreads = Max(2u, std::thread::hardware_concurrency()) - 1;
+    for (u32 i = 0; i < loadThreads; i++) {
+      load.emplace_back([&stop] {
+        volatile u64 n = 0;
+        while (!stop) {
+          n = n + 1;
+        }
+      });
+    }
+    mks::Logger::Infof("load threads: %u", loadThreads);
+    Log("60Hz, sleep_for(1ms) polling, loaded", PollingLoop(1000.0 / 60));
+    ok &= Check("60Hz, paced, loaded", PacedLoop(1000.0 / 60, 4));
+    ok &= Check("144Hz, paced, loaded", PacedLoop(1000.0 / 144, 2));
+    stop = true;
+    for (auto& t : load) {
+      t.join();
+    }
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/DirtyRanges.hpp"
+#include "../../src/lib/Jobs.hpp"
+#include "../../src/lib/Logger.hpp"
+#include "../../src/lib/Window.hpp"
+
+namespace {
+
+const char* WINDOW_TITLE = "InstanceStress";
+const u8 PHYSICS_FPS = 1;
+// uncapped (as far as the render loop allows), so we measure frame time, not vsync
+const u16 RENDER_FPS = 1000;
+
+// 1000 x 1000 grid of quads
+const u32 GRID = 1000;
+const u32 INSTANCE_COUNT = GRID * GRID;
+// instances appended per frame while filling; exercises VBO growth across frames in flight
+const u32 SPAWN_PER_FRAME = 50000;
+// instances rewritten per frame once full; exercises dirty-range uploads
+const u32 ANIMATE_PER_FRAME = 10000;
+const u32 REPORT_EVERY = 120;
+// steady-state frames per phase: one cached draw, then many batches recorded on worker threads
+const u32 PHASE_FRAMES = 600;
+const u32 INSTANCES_PER_BATCH = 4096;
+
+struct Mesh {
+  glm::vec2 vertex;
+};
+
+struct Instance {
+  glm::vec3 pos{0.0f, 0.0f, 0.0f};
+  glm::vec3 rot{0.0f, 0.0f, 0.0f};
+  glm::vec3 scale{1.0f, 1.0f, 1.0f};
+  u32 texId{0};
+};
+
+struct ubo_ProjView {
+  glm::mat4 proj;
+  glm::mat4 view;
+  glm::vec2 user1;
+  glm::vec2 user2;
+};
+
+std::vector<Mesh> vertices = {{{-0.5f, -0.5f}}, {{0.5f, -0.5f}}, {{0.5f, 0.5f}}, {{-0.5f, 0.5f}}};
+
+std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
+
+std::vector<Instance> instances(0);
+mks::DirtyRanges dirtyInstances{};
+
+void Spawn(u32 count) {
+  const f32 cell = 1.0f / GRID;
+  for (u32 i = 0; i < count && instances.size() < INSTANCE_COUNT; i++) {
+    const u32 id = instances.size();
+    Instance instance{};
+    instance.pos = glm::vec3(
+        -0.5f + cell * (id % GRID) + cell / 2, -0.5f + cell * (id / GRID) + cell / 2, 0.0f);
+    instance.scale = glm::vec3(cell * 0.8f, cell * 0.8f, 1.0f);
+    instance.texId = 2;  // ball
+    instances.push_back(instance);
+    dirtyInstances.Mark(id);
+  }
+}
+
+void Animate(u64 frame) {
+  // a rolling window of instances, so each frame touches different slots
+  const u32 first = (frame * ANIMATE_PER_FRAME) % INSTANCE_COUNT;
+  for (u32 i = 0; i < ANIMATE_PER_FRAME; i++) {
+    const u32 id = (first + i) % INSTANCE_COUNT;
+    instances[id].rot.z += 0.1f;
+    dirtyInstances.Mark(id);
+  }
+}
+
+struct FrameStats {
+  std::vector<f64> samples;
+
+  void Report(const char* label) {
+    if (samples.empty()) {
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    f64 sum = 0;
+    for (const f64 s : samples) {
+      sum += s;
+    }
+    mks::Logger::Infof(
+        "%s: frames: %u, avg: %.3fms, min: %.3fms, p99: %.3fms, max: %.3fms",
+        label,
+        static_cast<u32>(samples.size()),
+        sum / samples.size(),
+        samples.front(),
+        samples[(samples.size() - 1) * 99 / 100],
+        samples.back());
+  }
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin %s test.", WINDOW_TITLE);
+
+    // records draw batches
+    mks::Jobs jobs{};
+    jobs.Start();
+    auto w = mks::Window{};
+    w.Begin(WINDOW_TITLE, 800, 800);
+    w.v.AssertDriverValidationLayersSupported();
+#if OS_MAC == 1
+    // enable MoltenVK support for MacOS cross-platform support
+    w.v.requiredDriverExtensionNames.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+#endif
+    w.v.AssertDriverExtensionsSupported();
+    char instance_name[255];
+    std::sprintf(instance_name, "%s_test", WINDOW_TITLE);
+    w.v.CreateInstance(instance_name, 1, 0, 0);
+    w.v.UsePhysicalDevice(0);
+
+    w.Bind();
+
+    // vsync would cap the frame times we're here to measure
+    w.v.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+    auto b = w.GetDrawableAreaExtentBounds();
+    w.KeepAspectRatio(b.width, b.height);
+
+    w.v.InitSwapChain();
+    w.v.CreateImageViews();
+    w.v.CreateRenderPass();
+    w.v.CreateDescriptorSetLayout();
+    w.v.CreateGraphicsPipeline(
+        "../assets/shaders/simple_shader.frag.spv",
+        "../assets/shaders/simple_shader.vert.spv",
+        sizeof(Mesh),
+        sizeof(Instance),
+        5,
+        {0, 1, 1, 1, 1},
+        {0, 1, 2, 3, 4},
+        {/*VK_FORMAT_R32G32_SFLOAT*/ 103,
+         /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
+         /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
+         /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
+         /*VK_FORMAT_R32_UINT*/ 98},
+        {offsetof(Mesh, vertex),
+         offsetof(Instance, pos),
+         offsetof(Instance, rot),
+         offsetof(Instance, scale),
+         offsetof(Instance, texId)});
+    w.v.CreateFrameBuffers();
+    w.v.CreateCommandPool();
+    w.v.EnableThreadedRecording(jobs);
+
+    w.v.CreateTexture("../assets/textures/pong-atlas.png");
+    w.v.CreateTextureSampler();
+    w.v.CreateVertexBuffer(0, VectorSize(vertices), vertices.data());
+    // deliberately small; must grow ~13 times to hold every instance
+    w.v.CreateVertexBuffer(1, sizeof(Instance) * 256, nullptr);
+    w.v.CreateIndexBuffer(sizeof(indices[0]) * indices.size(), indices.data());
+    w.v.CreateUniformBuffers(sizeof(ubo_ProjView));
+
+    w.v.CreateDescriptorPool();
+    w.v.CreateDescriptorSets();
+    w.v.CreateCommandBuffers();
+    w.v.CreateSyncObjects();
+
+    ubo_ProjView ubo1{};
+    ubo1.view = glm::lookAt(
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    ubo1.proj = glm::ortho(-0.5f, +0.5f, -0.5f, +0.5f, 0.1f, 10.0f);
+    w.v.drawIndexCount = static_cast<u32>(indices.size());
+
+    u64 frame = 0;
+    u32 steadyFrames = 0;
+    FrameStats window{};
+    FrameStats single{};
+    FrameStats threaded{};
+    auto last = std::chrono::high_resolution_clock::now();
+
+    w.RenderLoop(
+        PHYSICS_FPS,
+        RENDER_FPS,
+        [](const float deltaTime) {},
+        [&](const float deltaTime) {
+          auto now = std::chrono::high_resolution_clock::now();
+          const f64 ms = std::chrono::duration<f64, std::milli>(now - last).count();
+          last = now;
+          // skip the fill phase; it measures growth, not steady state
+          if (instances.size() == INSTANCE_COUNT) {
+            window.samples.push_back(ms);
+            (w.v.drawBatches.empty() ? single : threaded).samples.push_back(ms);
+            steadyFrames++;
+            if (PHASE_FRAMES == steadyFrames) {
+              window.Report("frame time");
+              window.samples.clear();
+              mks::Logger::Infof(
+                  "switching to %u draw batches, recorded on worker threads.",
+                  INSTANCE_COUNT / INSTANCES_PER_BATCH);
+              for (u32 first = 0; first < INSTANCE_COUNT; first += INSTANCES_PER_BATCH) {
+                w.v.drawBatches.push_back(
+                    {first, std::min(INSTANCES_PER_BATCH, INSTANCE_COUNT - first)});
+              }
+            }
+          }
+
+          if (instances.size() < INSTANCE_COUNT) {
+            Spawn(SPAWN_PER_FRAME);
+          } else {
+            Animate(frame);
+          }
+
+          if (dirtyInstances.IsDirty()) {
+            w.v.instanceCount = instances.size();
+            w.v.UpdateVertexBufferRanges(
+                1,
+                instances.data(),
+                dirtyInstances.Coalesce(sizeof(Instance)));
+            dirtyInstances.Clear();
+          }
+
+          w.v.UpdateUniformBuffer(w.v.currentFrame, &ubo1);
+
+          frame++;
+          if (window.samples.size() >= REPORT_EVERY) {
+            window.Report("frame time");
+            window.samples.clear();
+          }
+          if (steadyFrames >= PHASE_FRAMES * 2) {
+            w.quit = true;
+          }
+        });
+
+    w.v.DeviceWaitIdle();
+    single.Report("single draw, cached commands");
+    threaded.Report("batched draws, threaded recording");
+    w.v.Cleanup();
+    w.End();
+
+    mks::Logger::Infof("End of test.");
+    return EXIT_SUCCESS;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,220 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/Jobs.hpp"
+#include "../../src/lib/Logger.hpp"
+
+namespace {
+
+const u32 TEST_WORKERS = 3;
+
+bool CheckDependencies() {
+  bool ok = true;
+  mks::Jobs jobs{};
+  jobs.Start(TEST_WORKERS);
+  for (u32 round = 0; round < 100; round++) {
+    // a -> (b, c) -> d
+    std::atomic<u32> sequence = 0;
+    u32 a = 0, b = 0, c = 0, d = 0;
+    auto ha = jobs.Submit([&] { a = ++sequence; });
+    auto hb = jobs.Submit([&] { b = ++sequence; }, {ha});
+    auto hc = jobs.Submit([&] { c = ++sequence; }, {ha});
+    auto hd = jobs.Submit([&] { d = ++sequence; }, {hb, hc});
+    jobs.Wait(hd);
+    ok &= 1 == a && a < b && a < c && b < d && c < d && 4 == d;
+  }
+  if (!ok) {
+    mks::Logger::Infof("FAIL dependencies");
+  }
+  return ok;
+}
+
+bool CheckParallelFor() {
+  bool ok = true;
+  mks::Jobs jobs{};
+  jobs.Start(TEST_WORKERS);
+  const u32 count = 1000000;
+  std::vector<u32> values(count, 0);
+  jobs.Wait(jobs.ParallelFor(0, count, 0, [&](u32 i0, u32 i1) {
+    for (u32 i = i0; i < i1; i++) {
+      values[i] += i;
+    }
+  }));
+  for (u32 i = 0; i < count; i++) {
+    ok &= values[i] == i;
+  }
+
+  // nested: each outer job fans out, and waits by running jobs itself
+  std::atomic<u64> sum = 0;
+  jobs.Wait(jobs.ParallelFor(0, 16, 1, [&](u32 i0, u32 i1) {
+    for (u32 outer = i0; outer < i1; outer++) {
+      jobs.Wait(jobs.ParallelFor(0, 1000, 10, [&](u32 j0, u32 j1) {
+        u64 partial = 0;
+        for (u32 j = j0; j < j1; j++) {
+          partial += j;
+        }
+        sum += partial;
+      }));
+    }
+  }));
+  ok &= 16 * (999 * 1000 / 2) == sum;
+
+  // nothing to do is done right away
+  ok &= jobs.ParallelFor(5, 5, 0, [](u32, u32) {})->IsDone();
+  if (!ok) {
+    mks::Logger::Infof("FAIL parallel for");
+  }
+  return ok;
+}
+
+mks::Jobs::Task Pipeline(mks::Jobs& jobs, std::vector<f32>& data, bool& caught) {
+  co_await jobs.Submit([&] { data.assign(100000, 1.0f); });
+  co_await jobs.ParallelFor(0, data.size(), 0, [&](u32 i0, u32 i1) {
+    for (u32 i = i0; i < i1; i++) {
+      data[i] *= static_cast<f32>(i);
+    }
+  });
+  try {
+    co_await jobs.Submit([] { throw std::runtime_error("load failed"); });
+  } catch (const std::runtime_error& e) {
+    caught = std::string("load failed") == e.what();
+  }
+}
+
+bool CheckCoroutines() {
+  bool ok = true;
+  mks::Jobs jobs{};
+  jobs.Start(TEST_WORKERS);
+  std::vector<std::vector<f32>> data(8);
+  bool caught[8] = {};
+  std::vector<mks::JobHandle> handles;
+  for (u32 i = 0; i < data.size(); i++) {
+    handles.push_back(jobs.Spawn(Pipeline(jobs, data[i], caught[i])));
+  }
+  for (u32 i = 0; i < data.size(); i++) {
+    jobs.Wait(handles[i]);
+    ok &= caught[i] && 100000 == data[i].size() && 99999.0f == data[i][99999];
+  }
+  if (!ok) {
+    mks::Logger::Infof("FAIL coroutines");
+  }
+  return ok;
+}
+
+bool CheckErrors() {
+  bool ok = true;
+  mks::Jobs jobs{};
+  jobs.Start(TEST_WORKERS);
+  bool ranDependent = false;
+  auto failed = jobs.Submit([] { throw std::runtime_error("job failed"); });
+  auto dependent = jobs.Submit([&] { ranDependent = true; }, {failed});
+  try {
+    jobs.Wait(dependent);
+    ok = false;
+  } catch (const std::runtime_error& e) {
+    ok &= std::string("job failed") == e.what();
+  }
+  ok &= !ranDependent;
+  if (!ok) {
+    mks::Logger::Infof("FAIL errors");
+  }
+  return ok;
+}
+
+/**
+ * Coarse (one big ParallelFor) and fine-grained (many tiny jobs) work on 1 to N threads,
+ * counting the waiting caller as one of them.
+ */
+void BenchScalability() {
+  const u32 hw = Max(1u, std::thread::hardware_concurrency());
+  const u32 count = 1 << 22;
+  const u32 tinyJobs = 100000;
+  std::vector<f32> data(count, 1.0f);
+  f64 baseCoarseMs = 0;
+  f64 baseFineMs = 0;
+  mks::Logger::Infof("%u hardware threads", hw);
+  for (u32 threads = 1; threads <= Max(hw, 4u); threads *= 2) {
+    mks::Jobs jobs{};
+    // with no workers started, the waiting caller runs everything
+    if (threads > 1) {
+      jobs.Start(threads - 1);
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    jobs.Wait(jobs.ParallelFor(0, count, 0, [&](u32 i0, u32 i1) {
+      for (u32 i = i0; i < i1; i++) {
+        data[i] = std::sqrt(data[i] * 1.0001f + 0.5f);
+      }
+    }));
+    const f64 coarseMs = std::chrono::duration<f64, std::milli>(
+                             std::chrono::high_resolution_clock::now() - begin)
+                             .count();
+
+    std::atomic<u32> ran = 0;
+    begin = std::chrono::high_resolution_clock::now();
+    auto root = jobs.Submit([&] {
+      std::vector<mks::JobHandle> handles;
+      handles.reserve(tinyJobs);
+      for (u32 i = 0; i < tinyJobs; i++) {
+        handles.push_back(jobs.Submit([&ran] { ran++; }));
+      }
+      for (const auto& h : handles) {
+        jobs.Wait(h);
+      }
+    });
+    jobs.Wait(root);
+    const f64 fineMs = std::chrono::duration<f64, std::milli>(
+                           std::chrono::high_resolution_clock::now() - begin)
+                           .count();
+
+    if (1 == threads) {
+      baseCoarseMs = coarseMs;
+      baseFineMs = fineMs;
+    }
+    mks::Logger::Infof(
+        "%2u threads%s: parallel for %7.2fms (x%.2f), %u tiny jobs %7.2fms (%5.0f ns/job, x%.2f)",
+        threads,
+        threads > hw ? " (oversubscribed)" : "",
+        coarseMs,
+        baseCoarseMs / coarseMs,
+        tinyJobs,
+        fineMs,
+        fineMs * 1e6 / tinyJobs,
+        baseFineMs / fineMs);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin Jobs test.");
+    bool ok = true;
+
+    ok &= CheckDependencies();
+    ok &= CheckParallelFor();
+    ok &= CheckCoroutines();
+    ok &= CheckErrors();
+    BenchScalability();
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,412 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/DirtyRanges.hpp"
+#include "../../src/lib/Logger.hpp"
+#include "../../src/lib/Lua.hpp"
+#include "../../src/lib/LuaStructView.hpp"
+#include "../../src/lib/Physics2D.hpp"
+
+namespace {
+
+// same layout as the Pong_test instance VBO
+struct Instance {
+  glm::vec3 pos{0.0f, 0.0f, 0.0f};
+  glm::vec3 rot{0.0f, 0.0f, 0.0f};
+  glm::vec3 scale{1.0f, 1.0f, 1.0f};
+  u32 texId{0};
+};
+
+const u32 INSTANCE_COUNT = 10000;
+const u32 REPS = 100;
+const u32 TICKS = 120;
+
+std::vector<Instance> instances(INSTANCE_COUNT);
+mks::DirtyRanges dirtyInstances{};
+
+// the per-entity call, as Pong_test had it
+int lua_WriteInstanceVBO(lua_State* L) {
+  const u32 id = lua_tointeger(L, 1);
+  const f32 pos_x = lua_tonumber(L, 2);
+  const f32 pos_y = lua_tonumber(L, 3);
+  const f32 pos_z = lua_tonumber(L, 4);
+  const f32 rot_x = lua_tonumber(L, 5);
+  const f32 rot_y = lua_tonumber(L, 6);
+  const f32 rot_z = lua_tonumber(L, 7);
+  const f32 scale_x = lua_tonumber(L, 8);
+  const f32 scale_y = lua_tonumber(L, 9);
+  const f32 scale_z = lua_tonumber(L, 10);
+  const u32 texId = lua_tointeger(L, 11);
+  auto& instance = instances[id];
+  instance.pos = glm::vec3(pos_x, pos_y, pos_z);
+  instance.rot = glm::vec3(rot_x, rot_y, rot_z);
+  instance.scale = glm::vec3(scale_x, scale_y, scale_z);
+  instance.texId = texId;
+  dirtyInstances.Mark(id);
+  return 11;
+}
+
+// each benchmark writes every field of every instance, REPS times
+const char* BENCH_SCRIPT = R"(
+local N = ...
+
+function PerCall(reps)
+  for r = 1, reps do
+    for i = 0, N - 1 do
+      WriteInstanceVBO(i, r, i, 0, 0, 0, r, 1, 1, 1, 2)
+    end
+  end
+end
+
+local proxies = {}
+for i = 0, N - 1 do proxies[i] = Instances:at(i) end
+
+function Proxy(reps)
+  for r = 1, reps do
+    for i = 0, N - 1 do
+      local e = proxies[i]
+      e.posX = r; e.posY = i; e.posZ = 0
+      e.rotX = 0; e.rotY = 0; e.rotZ = r
+      e.scaleX = 1; e.scaleY = 1; e.scaleZ = 1
+      e.texId = 2
+    end
+  end
+end
+
+-- typical for movement: only position changes
+function ProxyPosOnly(reps)
+  for r = 1, reps do
+    for i = 0, N - 1 do
+      local e = proxies[i]
+      e.posX = r; e.posY = i
+    end
+  end
+end
+
+local packed = {}
+function Batch(reps)
+  for r = 1, reps do
+    local k = 1
+    for i = 0, N - 1 do
+      packed[k] = r; packed[k + 1] = i; packed[k + 2] = 0
+      packed[k + 3] = 0; packed[k + 4] = 0; packed[k + 5] = r
+      packed[k + 6] = 1; packed[k + 7] = 1; packed[k + 8] = 1
+      packed[k + 9] = 2
+      k = k + 10
+    end
+    WriteInstances(0, N, packed)
+  end
+end
+)";
+
+std::vector<mks::LuaField> InstanceFields() {
+  return {
+      {"posX", offsetof(Instance, pos) + 0, mks::LuaField::Type::F32},
+      {"posY", offsetof(Instance, pos) + 4, mks::LuaField::Type::F32},
+      {"posZ", offsetof(Instance, pos) + 8, mks::LuaField::Type::F32},
+      {"rotX", offsetof(Instance, rot) + 0, mks::LuaField::Type::F32},
+      {"rotY", offsetof(Instance, rot) + 4, mks::LuaField::Type::F32},
+      {"rotZ", offsetof(Instance, rot) + 8, mks::LuaField::Type::F32},
+      {"scaleX", offsetof(Instance, scale) + 0, mks::LuaField::Type::F32},
+      {"scaleY", offsetof(Instance, scale) + 4, mks::LuaField::Type::F32},
+      {"scaleZ", offsetof(Instance, scale) + 8, mks::LuaField::Type::F32},
+      {"texId", offsetof(Instance, texId), mks::LuaField::Type::U32}};
+}
+
+bool Bench(mks::Lua& l, const char* fn, const char* label) {
+  dirtyInstances.Clear();
+  lua_getglobal(l.L, fn);
+  lua_pushinteger(l.L, REPS);
+  const auto begin = std::chrono::high_resolution_clock::now();
+  const bool ok = LUA_OK == lua_pcall(l.L, 1, 0, 0);
+  const f64 ns = std::chrono::duration<f64, std::nano>(
+                     std::chrono::high_resolution_clock::now() - begin)
+                     .count();
+  if (!ok) {
+    mks::Logger::Infof("%s failed: %.160s", fn, l.GetError().c_str());
+    return false;
+  }
+  mks::Logger::Infof(
+      "%-40s %8.1f ns/instance (dirty: %u)",
+      label,
+      ns / (static_cast<f64>(INSTANCE_COUNT) * REPS),
+      dirtyInstances.DirtyCount());
+  return true;
+}
+
+struct Rejected {
+  const char* code;
+  // expected in the error message, so an error about some other argument doesn't pass
+  const char* error;
+};
+
+// each must raise a Lua error before touching native memory; N is INSTANCE_COUNT
+const Rejected OUT_OF_RANGE[] = {
+    {"WriteInstances(10, -8, {})", "range [10, +-8) out of range"},
+    {"Instances:write(10, -8, {})", "range [10, +-8) out of range"},
+    {"WriteInstances(-1, 1, {})", "range [-1, +1) out of range"},
+    {"WriteInstances(N - 1, 2, {})", "range [9999, +2) out of range"},
+    {"WriteInstances(N - 1, 4294967297, {})", "range [9999, +4294967297) out of range"},
+    // no math.maxinteger in LuaJIT
+    {"WriteInstances(1, 2^40, {})", "range [1, +1099511627776) out of range"},
+    {"Instances:read(10, -8)", "range [10, +-8) out of range"},
+    {"Instances:read(-1, 1)", "range [-1, +1) out of range"},
+    {"Instances:read(N, 1)", "range [10000, +1) out of range"},
+    {"Instances:read(4294967295, 2)", "range [4294967295, +2) out of range"},
+    {"Instances:at(-1)", "index -1 out of range"},
+    {"Instances:at(-4294967295)", "index -4294967295 out of range"},
+    {"Instances:at(N)", "index 10000 out of range"},
+};
+
+// wrong kinds of userdata, and values which aren't numbers; these must raise too
+const char* BAD_ARGUMENTS[] = {
+    "Instances.read(Instances:at(0), 0, 1)",
+    "Instances.write(io.stdout, 0, 0, {})",
+    "Instances.at(io.stdout, 0)",
+    "getmetatable(Instances).__len(io.stdout)",
+    "getmetatable(Instances:at(0)).__index(io.stdout, 'posX')",
+    "Instances:at(0).posX = nil",
+    "Instances:at(0).posX = 'far'",
+    "Instances:at(0).texId = 1.5",
+    "Instances:at(0).texId = -1",
+    "WriteInstances(0, 1, {})",
+    "WriteInstances(0, 1, {1, 2, 3, 4, 5, 6, 7, 8, 9, 'a'})",
+};
+
+bool RunSnippet(mks::Lua& l, const char* code) {
+  return LUA_OK == luaL_loadstring(l.L, code) && LUA_OK == lua_pcall(l.L, 0, 0, 0);
+}
+
+bool CheckBounds(mks::Lua& l) {
+  bool ok = true;
+  lua_pushinteger(l.L, INSTANCE_COUNT);
+  lua_setglobal(l.L, "N");
+  for (const auto& rejected : OUT_OF_RANGE) {
+    if (RunSnippet(l, rejected.code)) {
+      mks::Logger::Infof("FAIL: no error from %s", rejected.code);
+      ok = false;
+      continue;
+    }
+    const std::string error = l.GetError();
+    lua_pop(l.L, 1);
+    if (std::string::npos == error.find(rejected.error)) {
+      mks::Logger::Infof(
+          "FAIL: %s raised \"%.160s\", expected \"%s\"",
+          rejected.code,
+          error.c_str(),
+          rejected.error);
+      ok = false;
+    }
+  }
+  for (const char* code : BAD_ARGUMENTS) {
+    if (RunSnippet(l, code)) {
+      mks::Logger::Infof("FAIL: no error from %s", code);
+      ok = false;
+    } else {
+      lua_pop(l.L, 1);
+    }
+  }
+  // ranges ending exactly at the end are fine
+  const char* IN_RANGE = R"(
+    assert(#Instances:read(N, 0) == 0)
+    assert(#Instances:read(N - 1, 1) == 10)
+    WriteInstances(N, 0, {})
+  )";
+  if (!RunSnippet(l, IN_RANGE)) {
+    mks::Logger::Infof("FAIL: in-range: %.160s", l.GetError().c_str());
+    lua_pop(l.L, 1);
+    ok = false;
+  }
+  return ok;
+}
+
+/**
+ * Pong's per-tick rigidbody and collider work (move, bounce, collide, interpolate) at n
+ * entities, in a fresh state; run with and without MKS_LUAJIT=1 to compare runtimes.
+ */
+bool BenchTick(const u32 n) {
+  mks::Lua l{};
+  std::vector<Instance> entities(n);
+  mks::DirtyRanges dirty{};
+  mks::LuaStructView view{};
+  view.Bind<Instance>(l.L, "Instances", entities, InstanceFields(), &dirty);
+
+  if (LUA_OK != luaL_loadfile(l.L, "../assets/lua/bench.lua")) {
+    mks::Logger::Infof("bench.lua failed to load: %.160s", l.GetError().c_str());
+    return false;
+  }
+  lua_pushinteger(l.L, n);
+  lua_pushinteger(l.L, TICKS);
+  if (LUA_OK != lua_pcall(l.L, 2, 1, 0)) {
+    mks::Logger::Infof("bench.lua failed: %.160s", l.GetError().c_str());
+    return false;
+  }
+  const std::string runtime = lua_tostring(l.L, -1);
+  lua_pop(l.L, 1);
+
+  lua_getglobal(l.L, "Run");
+  const auto begin = std::chrono::high_resolution_clock::now();
+  const bool ok = LUA_OK == lua_pcall(l.L, 0, 0, 0);
+  const f64 us = std::chrono::duration<f64, std::micro>(
+                     std::chrono::high_resolution_clock::now() - begin)
+                     .count();
+  if (!ok) {
+    mks::Logger::Infof("bench.lua Run failed: %.160s", l.GetError().c_str());
+    return false;
+  }
+  mks::Logger::Infof(
+      "%-12.12s tick, %5u entities: %9.1f us/tick (dirty: %u)",
+      runtime.c_str(),
+      n,
+      us / TICKS,
+      dirty.DirtyCount());
+  return n == dirty.DirtyCount();
+}
+
+// pong.lua's instances; AddInstance() appends, as in Pong_test
+std::vector<Instance> pongInstances(0);
+mks::DirtyRanges pongDirty{};
+int lua_AddInstance(lua_State* L) {
+  const u32 id = pongInstances.size();
+  pongInstances.push_back({});
+  pongDirty.Mark(id);
+  lua_pushinteger(L, id);
+  return 1;
+}
+
+// the rest of what pong.lua calls; assets and audio do nothing, and the gamepad presses
+// start once, then steers the paddle (body 0) under the ball (body 1)
+const char* PONG_STUBS = R"(
+function LoadTexture() return 0 end
+function LoadAudioFile() return 0 end
+function LoadShader() return 0 end
+function PlayAudio() end
+function WriteWorldUBO() end
+function Exit() end
+function GetKeyboardInput() return false, false, false, false, false, 0, 0 end
+local started = false
+function GetGamepadInput()
+  local ballX = Physics.position(1)
+  local paddleX = Physics.position(0)
+  local stick = math.max(-1, math.min(1, (ballX - paddleX) * 10))
+  local start = not started
+  started = true
+  return stick, 0, 0, 0, start, false, false, false
+end
+)";
+
+/**
+ * The real pong.lua, driven the way Pong_test drives it: each tick a physics step, its
+ * contacts, OnFixedUpdate() and OnUpdate(), then interpolation into the instances.
+ */
+bool BenchPong(const u32 ticks) {
+  mks::Lua l{};
+  pongInstances.clear();
+  pongDirty.Clear();
+  mks::LuaStructView view{};
+  view.Bind<Instance>(l.L, "Instances", pongInstances, InstanceFields(), &pongDirty);
+  view.BindWrite(l.L, "WriteInstances");
+  lua_register(l.L, "AddInstance", lua_AddInstance);
+  mks::Physics2D physics{};
+  physics.Bind(l.L, "Physics");
+  if (!RunSnippet(l, PONG_STUBS) || !l.ReloadScript("../assets/lua/pong.lua")) {
+    mks::Logger::Infof("pong.lua failed to load: %.160s", l.GetError().c_str());
+    return false;
+  }
+
+  const f32 dt = 1.0f / 120;
+  bool ok = true;
+  const auto begin = std::chrono::high_resolution_clock::now();
+  for (u32 t = 0; ok && t < ticks; t++) {
+    physics.Step(dt);
+    ok = physics.DispatchContacts(l.L, "OnContacts");
+    lua_getglobal(l.L, "OnFixedUpdate");
+    lua_pushnumber(l.L, dt);
+    ok = ok && LUA_OK == lua_pcall(l.L, 1, 0, 0);
+    lua_getglobal(l.L, "OnUpdate");
+    lua_pushnumber(l.L, dt);
+    lua_pushnumber(l.L, 0.5);
+    ok = ok && LUA_OK == lua_pcall(l.L, 2, 0, 0);
+    physics.Interpolate(0.5f, [](u32 instance, f32 x, f32 y) {
+      pongInstances[instance].pos.x = x;
+      pongInstances[instance].pos.y = y;
+      pongDirty.Mark(instance);
+    });
+  }
+  const f64 us = std::chrono::duration<f64, std::micro>(
+                     std::chrono::high_resolution_clock::now() - begin)
+                     .count();
+  if (!ok) {
+    mks::Logger::Infof("pong.lua failed: %.160s", l.GetError().c_str());
+    return false;
+  }
+  mks::Logger::Infof(
+      "pong.lua     tick, %5u entities: %9.1f us/tick (bodies: %u)",
+      static_cast<u32>(pongInstances.size()),
+      us / ticks,
+      physics.Count());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin LuaBridge test.");
+    mks::Lua l{};
+    lua_register(l.L, "WriteInstanceVBO", lua_WriteInstanceVBO);
+
+    mks::LuaStructView view{};
+    view.Bind<Instance>(l.L, "Instances", instances, InstanceFields(), &dirtyInstances);
+    view.BindWrite(l.L, "WriteInstances");
+
+    if (LUA_OK != luaL_loadstring(l.L, BENCH_SCRIPT)) {
+      throw mks::Logger::Errorf(l.GetError());
+    }
+    lua_pushinteger(l.L, INSTANCE_COUNT);
+    if (LUA_OK != lua_pcall(l.L, 1, 0, 0)) {
+      throw mks::Logger::Errorf(l.GetError());
+    }
+
+    bool ok = true;
+    ok &= Bench(l, "PerCall", "WriteInstanceVBO(id, 11 numbers)");
+    ok &= Bench(l, "Proxy", "view:at(id) proxy, all 10 fields");
+    ok &= Bench(l, "ProxyPosOnly", "view:at(id) proxy, posX + posY");
+    ok &= Bench(l, "Batch", "WriteInstances(0, N, packed)");
+
+    // every path must land in the same native memory
+    const auto& last = instances[INSTANCE_COUNT - 1];
+    if (last.pos.x != REPS || last.pos.y != INSTANCE_COUNT - 1 || last.rot.z != REPS ||
+        last.texId != 2) {
+      mks::Logger::Infof("FAIL: unexpected instance contents");
+      ok = false;
+    }
+
+    ok &= CheckBounds(l);
+
+    ok &= BenchPong(TICKS * 10);
+    for (const u32 n : {1000u, 5000u, 10000u}) {
+      ok &= BenchTick(n);
+    }
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
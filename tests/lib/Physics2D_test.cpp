@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/Logger.hpp"
+#include "../../src/lib/Physics2D.hpp"
+
+namespace {
+
+const f32 DT = 1.0f / 120;
+const u32 STEPS = 60;
+
+f32 random(f32 a, f32 b) {
+  return a + (((f32)rand()) / (f32)RAND_MAX) * (b - a);
+}
+
+/**
+ * Two boxes approach, overlap for a while, then separate: one enter, stays, one exit.
+ */
+bool CheckEvents() {
+  mks::Physics2D physics{};
+  const u32 a = physics.Add(0, -1, 0, 0.5f, 0.5f);
+  const u32 b = physics.Add(1, 1, 0, 0.5f, 0.5f);
+  physics.SetVelocity(a, 1, 0);
+  u32 entered = 0, stayed = 0, exited = 0;
+  for (u32 i = 0; i < 4 * 120; i++) {
+    physics.Step(DT);
+    entered += physics.entered.size();
+    stayed += physics.stayed.size();
+    exited += physics.exited.size();
+  }
+  // overlapping while a.x is within 0.5 of b.x; at 1 unit/s that's ~1s
+  mks::Logger::Infof("events, entered: %u, stayed: %u, exited: %u", entered, stayed, exited);
+  const bool ok = 1 == entered && 1 == exited && stayed >= 110 && stayed <= 130;
+  if (!ok) {
+    mks::Logger::Infof("FAIL contact events");
+  }
+  return ok;
+}
+
+/**
+ * The broadphase must find exactly the pairs an all-pairs test does.
+ */
+bool CheckAgainstBruteForce() {
+  mks::Physics2D physics{};
+  for (u32 i = 0; i < 2000; i++) {
+    // mixed sizes, some spanning several cells, and a few without a collider
+    const f32 size = 0 == i % 50 ? 0 : random(0.005f, 0.05f);
+    physics.Add(i, random(-1, 1), random(-1, 1), size, size * random(0.5f, 2));
+  }
+  physics.Step(DT);
+
+  u32 expected = 0;
+  const u32 n = physics.Count();
+  for (u32 a = 0; a < n; a++) {
+    for (u32 b = a + 1; b < n; b++) {
+      const auto& p = physics;
+      if (0 != p.halfW[a] && 0 != p.halfW[b] && p.x[a] - p.halfW[a] <= p.x[b] + p.halfW[b] &&
+          p.x[b] - p.halfW[b] <= p.x[a] + p.halfW[a] && p.y[a] - p.halfH[a] <= p.y[b] + p.halfH[b] &&
+          p.y[b] - p.halfH[b] <= p.y[a] + p.halfH[a]) {
+        expected++;
+      }
+    }
+  }
+  mks::Logger::Infof("pairs, broadphase: %u, brute force: %u", (u32)physics.entered.size(), expected);
+  if (expected != physics.entered.size()) {
+    mks::Logger::Infof("FAIL pair count");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Interpolated positions blend the last two steps; a body which stops is drawn where it
+ * stopped, not short of it.
+ */
+bool CheckInterpolation() {
+  bool ok = true;
+  mks::Physics2D physics{};
+  const u32 body = physics.Add(7, 0, 0, 0.5f, 0.5f);
+  physics.SetVelocity(body, 1.2f, 0);
+
+  u32 writes = 0;
+  f32 drawnX = -1, drawnY = -1;
+  auto write = [&](u32 instance, f32 x, f32 y) {
+    ok &= 7 == instance;
+    writes++;
+    drawnX = x;
+    drawnY = y;
+  };
+
+  // added bodies are reported once, where they were added
+  physics.Interpolate(0.5f, write);
+  ok &= 1 == writes && 0 == drawnX && 0 == drawnY;
+
+  physics.Step(DT);
+  physics.Interpolate(0.25f, write);
+  ok &= 2 == writes && std::abs(drawnX - 0.25f * 1.2f * DT) < 1e-6f && 0 == drawnY;
+  // unchanged since last reported
+  physics.Interpolate(0.25f, write);
+  ok &= 2 == writes;
+
+  // stops part way through the blend; one more write lands on the final position
+  physics.SetActive(body, false);
+  physics.Step(DT);
+  physics.Interpolate(0.25f, write);
+  ok &= 3 == writes && std::abs(drawnX - 1.2f * DT) < 1e-6f;
+  physics.Step(DT);
+  physics.Interpolate(0.75f, write);
+  ok &= 3 == writes;
+
+  // same, stopping by velocity
+  physics.SetActive(body, true);
+  physics.Step(DT);
+  physics.Interpolate(0.5f, write);
+  ok &= 4 == writes && std::abs(drawnX - 1.5f * 1.2f * DT) < 1e-6f;
+  physics.SetVelocity(body, 0, 0);
+  physics.Step(DT);
+  physics.Interpolate(0.5f, write);
+  ok &= 5 == writes && std::abs(drawnX - 2 * 1.2f * DT) < 1e-6f;
+
+  physics.Teleport(body, 3, 4);
+  physics.Interpolate(0.5f, write);
+  ok &= 6 == writes && 3 == drawnX && 4 == drawnY;
+
+  if (!ok) {
+    mks::Logger::Infof("FAIL interpolation, %u writes, drawn at %f, %f", writes, drawnX, drawnY);
+  }
+  return ok;
+}
+
+void Bench(const u32 count) {
+  mks::Physics2D physics{};
+  // about as crowded as Pong's ball against its paddle, at any count
+  const f32 extent = std::sqrt(static_cast<f32>(count)) * 0.05f;
+  for (u32 i = 0; i < count; i++) {
+    const u32 id = physics.Add(i, random(-extent, extent), random(-extent, extent), 0.02f, 0.02f);
+    physics.SetVelocity(id, random(-1, 1), random(-1, 1));
+  }
+  u32 contacts = 0;
+  u32 written = 0;
+  const auto begin = std::chrono::high_resolution_clock::now();
+  for (u32 i = 0; i < STEPS; i++) {
+    physics.Step(DT);
+    contacts += physics.entered.size() + physics.stayed.size();
+    physics.Interpolate(0.5f, [&written](u32 instance, f32 x, f32 y) { written++; });
+  }
+  const f64 ms = std::chrono::duration<f64, std::milli>(
+                     std::chrono::high_resolution_clock::now() - begin)
+                     .count();
+  mks::Logger::Infof(
+      "%6u bodies: %7.3f ms/step, %6.1f contacts/step, %u drawn",
+      count,
+      ms / STEPS,
+      (f64)contacts / STEPS,
+      written / STEPS);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin Physics2D test.");
+    srand(1);
+    bool ok = true;
+
+    ok &= CheckEvents();
+    ok &= CheckAgainstBruteForce();
+    ok &= CheckInterpolation();
+
+    for (const u32 count : {1000u, 10000u, 100000u}) {
+      Bench(count);
+    }
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -1,6 +1,12 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -8,12 +14,20 @@
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "../../src/lib/Assets.hpp"
 #include "../../src/lib/Audio.hpp"
 #include "../../src/lib/Base.hpp"
+#include "../../src/lib/DirtyRanges.hpp"
 #include "../../src/lib/Gamepad.hpp"
+#include "../../src/lib/Jobs.hpp"
 #include "../../src/lib/Keyboard.hpp"
 #include "../../src/lib/Logger.hpp"
 #include "../../src/lib/Lua.hpp"
+#include "../../src/lib/LuaStructView.hpp"
+#include "../../src/lib/Physics2D.hpp"
+#include "../../src/lib/Shader.hpp"
+#include "../../src/lib/TaskGraph.hpp"
+#include "../../src/lib/TripleBuffer.hpp"
 #include "../../src/lib/Window.hpp"
 
 namespace {
@@ -31,6 +45,7 @@ struct Instance {
   glm::vec3 pos{0.0f, 0.0f, 0.0f};
   glm::vec3 rot{0.0f, 0.0f, 0.0f};
   glm::vec3 scale{1.0f, 1.0f, 1.0f};
+  // Vulkan::TexId(texture slot, region)
   u32 texId{0};
 };
 
@@ -73,33 +88,99 @@ const f32 MAX_X = 1.0f;
 const f32 MAX_Y = 1.0f;
 const f32 MAX_Z = 10.0f;
 const f32 MAX_SCALE = 0.4f;
-const u32 MAX_INSTANCES = 255;  // TODO: find out how to exceed this limit
-bool isVBODirty = true;
+// initial GPU-side capacity; the instance VBO grows as needed
+const u32 INITIAL_INSTANCE_CAPACITY = 256;
+// instance slots modified since last upload
+mks::DirtyRanges dirtyInstances{};
 std::vector<Instance> instances(0);
 int lua_AddInstance(lua_State* L) {
-  const u8 id = instances.size();
+  const u32 id = instances.size();
   instances.push_back({});
-  isVBODirty = true;
-  lua_pushnumber(L, id);
+  dirtyInstances.Mark(id);
+  lua_pushinteger(L, id);
   return 1;
 }
 
 mks::Audio a{};
-
-int lua_LoadAudioFile(lua_State* L) {
-  auto file = lua_tostring(L, 1);
-  a.loadAudioFile(file);
-  return 1;
+// textures, audio and shaders load in the background; scripts hold asset handles
+mks::Assets* aa = nullptr;
+
+// plays of audio which hadn't loaded yet; retried every frame
+struct PendingPlay {
+  u32 asset;
+  bool loop;
+  double gain;
+};
+std::vector<PendingPlay> pendingPlays;
+
+/**
+ * @return - false if the audio is still loading.
+ */
+bool TryPlay(const PendingPlay& play) {
+  auto asset = aa->Get(play.asset);
+  if (!asset || mks::Asset::State::FAILED == asset->state) {
+    // dropped; the failure was already logged
+    return true;
+  }
+  if (mks::Asset::State::LOADING == asset->state) {
+    return false;
+  }
+  a.playAudio(asset->value, play.loop, play.gain);
+  return true;
 }
 
 int lua_PlayAudio(lua_State* L) {
-  const int id = lua_tointeger(L, 1);
-  const bool loop = lua_toboolean(L, 2);
-  const double gain = lua_tonumber(L, 3);
-  a.playAudio(id, loop, gain);
+  const PendingPlay play{
+      static_cast<u32>(lua_tointeger(L, 1)), lua_toboolean(L, 2) != 0, lua_tonumber(L, 3)};
+  if (!TryPlay(play)) {
+    pendingPlays.push_back(play);
+  }
   return 3;
 }
 
+void FlushPendingPlays() {
+  std::erase_if(pendingPlays, TryPlay);
+}
+
+std::vector<mks::AssetHandle> AssetsOfType(mks::Assets& assets, mks::Asset::Type type) {
+  std::vector<mks::AssetHandle> found;
+  for (u32 id = 0; id < assets.Count(); id++) {
+    auto asset = assets.Get(id);
+    if (type == asset->type) {
+      found.push_back(asset);
+    }
+  }
+  return found;
+}
+
+/**
+ * The one shader the script loaded whose path ends in suffix (ie. ".frag.spv").
+ */
+mks::AssetHandle ShaderBySuffix(const std::vector<mks::AssetHandle>& shaders, const char* suffix) {
+  const std::string end = suffix;
+  mks::AssetHandle match = nullptr;
+  for (const auto& shader : shaders) {
+    const auto& path = shader->path;
+    if (path.size() >= end.size() && 0 == path.compare(path.size() - end.size(), end.size(), end)) {
+      if (match) {
+        throw mks::Logger::Errorf(
+            "pong.lua loaded more than one *%s shader: %s, %s",
+            suffix,
+            match->path.c_str(),
+            path.c_str());
+      }
+      match = shader;
+    }
+  }
+  if (!match) {
+    throw mks::Logger::Errorf(
+        "pong.lua must LoadShader() a *%s shader; it loaded %u shaders",
+        suffix,
+        static_cast<u32>(shaders.size()));
+  }
+  return match;
+}
+
 int lua_GetGamepadInput(lua_State* L) {
   const int index = lua_tointeger(L, 1);
   auto g = mks::Gamepad::registry[index];
@@ -126,67 +207,11 @@ int lua_GetKeyboardInput(lua_State* L) {
   return 7;
 }
 
-std::vector<std::string> textureFiles;
-int lua_LoadTexture(lua_State* L) {
-  textureFiles.resize(1);
-  auto file = lua_tostring(L, 1);
-  // TODO: make it possible to load more than one texture atlas?
-  textureFiles[0] = static_cast<std::string>(file);
-  return 1;
-}
-
-std::vector<std::string> shaderFiles;
-int lua_LoadShader(lua_State* L) {
-  auto file = lua_tostring(L, 1);
-  shaderFiles.push_back(static_cast<std::string>(file));
-  return 1;
-}
-
-int lua_ReadInstanceVBO(lua_State* L) {
-  const u8 id = lua_tointeger(L, 1);
-
-  auto& instance = instances[id];
-
-  lua_pushnumber(L, instance.pos.x);
-  lua_pushnumber(L, instance.pos.y);
-  lua_pushnumber(L, instance.pos.z);
-  lua_pushnumber(L, instance.rot.x);
-  lua_pushnumber(L, instance.rot.y);
-  lua_pushnumber(L, instance.rot.z);
-  lua_pushnumber(L, instance.scale.x);
-  lua_pushnumber(L, instance.scale.y);
-  lua_pushnumber(L, instance.scale.z);
-  lua_pushnumber(L, instance.texId);
-
-  return 11;
-}
-
-int lua_WriteInstanceVBO(lua_State* L) {
-  const u8 id = lua_tointeger(L, 1);
-  const f32 pos_x = lua_tonumber(L, 2);
-  const f32 pos_y = lua_tonumber(L, 3);
-  const f32 pos_z = lua_tonumber(L, 4);
-  const f32 rot_x = lua_tonumber(L, 5);
-  const f32 rot_y = lua_tonumber(L, 6);
-  const f32 rot_z = lua_tonumber(L, 7);
-  const f32 scale_x = lua_tonumber(L, 8);
-  const f32 scale_y = lua_tonumber(L, 9);
-  const f32 scale_z = lua_tonumber(L, 10);
-  const u8 texId = lua_tointeger(L, 11);
-  auto& instance = instances[id];
-  instance.pos = glm::vec3(pos_x, pos_y, pos_z);
-  instance.rot = glm::vec3(rot_x, rot_y, rot_z);
-  instance.scale = glm::vec3(scale_x, scale_y, scale_z);
-  instance.texId = texId;
-  isVBODirty = true;
-  return 11;
-}
-
 World world{{0.0f, 1.0f, 2.0f}, {0.0f, 0.0f, 0.0f}};
-std::vector<bool> isUBODirty{true, true};
+// one per frame in flight
+std::vector<bool> isUBODirty{};
 void markWorldDirty() {
-  isUBODirty[0] = true;
-  isUBODirty[1] = true;
+  isUBODirty.assign(isUBODirty.size(), true);
 }
 int lua_WriteWorldUBO(lua_State* L) {
   const f32 aspect = lua_tonumber(L, 1);
@@ -209,6 +234,16 @@ int lua_WriteWorldUBO(lua_State* L) {
   return 11;
 }
 
+// what the simulation thread hands to the render thread, in threaded mode
+struct Snapshot {
+  u64 sequence = 0;
+  mks::InputStamp input = {};
+  std::vector<Instance> instances = {};
+  // changed since the previous sequence
+  std::vector<mks::ByteRange> dirty = {};
+  World world = {};
+};
+
 int lua_Exit(lua_State* L) {
   ww->quit = true;
   return 0;
@@ -223,135 +258,354 @@ int main(int argc, char* argv[]) {
 
     srand((unsigned)time(NULL));  // use current time as random seed
 
-    a.init();
+    auto startupBegin = std::chrono::high_resolution_clock::now();
 
     mks::Lua l{};
-    lua_register(l.L, "LoadAudioFile", lua_LoadAudioFile);
     lua_register(l.L, "PlayAudio", lua_PlayAudio);
     lua_register(l.L, "GetGamepadInput", lua_GetGamepadInput);
     lua_register(l.L, "GetKeyboardInput", lua_GetKeyboardInput);
     lua_register(l.L, "AddInstance", lua_AddInstance);
-    lua_register(l.L, "LoadTexture", lua_LoadTexture);
-    lua_register(l.L, "LoadShader", lua_LoadShader);
-    lua_register(l.L, "ReadInstanceVBO", lua_ReadInstanceVBO);
-    lua_register(l.L, "WriteInstanceVBO", lua_WriteInstanceVBO);
     lua_register(l.L, "WriteWorldUBO", lua_WriteWorldUBO);
     lua_register(l.L, "Exit", lua_Exit);
 
-    mks::Gamepad::Enable();
+    // scripts read and write the instance array in place; it's the only copy
+    mks::LuaStructView instanceView{};
+    instanceView.Bind<Instance>(
+        l.L,
+        "Instances",
+        instances,
+        {{"posX", offsetof(Instance, pos) + 0, mks::LuaField::Type::F32},
+         {"posY", offsetof(Instance, pos) + 4, mks::LuaField::Type::F32},
+         {"posZ", offsetof(Instance, pos) + 8, mks::LuaField::Type::F32},
+         {"rotX", offsetof(Instance, rot) + 0, mks::LuaField::Type::F32},
+         {"rotY", offsetof(Instance, rot) + 4, mks::LuaField::Type::F32},
+         {"rotZ", offsetof(Instance, rot) + 8, mks::LuaField::Type::F32},
+         {"scaleX", offsetof(Instance, scale) + 0, mks::LuaField::Type::F32},
+         {"scaleY", offsetof(Instance, scale) + 4, mks::LuaField::Type::F32},
+         {"scaleZ", offsetof(Instance, scale) + 8, mks::LuaField::Type::F32},
+         {"texId", offsetof(Instance, texId), mks::LuaField::Type::U32}},
+        &dirtyInstances);
+    instanceView.BindWrite(l.L, "WriteInstances");
+
+    // bodies move natively; scripts keep the rules, and hear about contacts in OnContacts()
+    mks::Physics2D physics{};
+    physics.Bind(l.L, "Physics");
 
     auto w = mks::Window{};
     ww = &w;
-    w.Begin(WINDOW_TITLE, 800, 800);
-    // w.v.aspectRatio = 1.0f / 1;  // ASPECT_SQUARE (default)
-    // w.v.aspectRatio = 16.0f / 9; // ASPECT_WIDESCREEN
-    w.v.AssertDriverValidationLayersSupported();
-#if OS_MAC == 1
-    // enable MoltenVK support for MacOS cross-platform support
-    w.v.requiredDriverExtensionNames.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
-#endif
-    w.v.AssertDriverExtensionsSupported();
-    char instance_name[255];
-    std::sprintf(instance_name, "%s_test", WINDOW_TITLE);
-    w.v.CreateInstance(instance_name, 1, 0, 0);
-    w.v.UsePhysicalDevice(0);
-
-    w.Bind();
-
-    auto b = w.GetDrawableAreaExtentBounds();
-    w.KeepAspectRatio(b.width, b.height);
 
+    // usage: Pong_test [--threaded] [--frames-in-flight=2|3] [--drain-on-resize]
+    // --drain-on-resize recreates the swap chain the old way, after vkDeviceWaitIdle; compare
+    // the swap chain stats logged at exit against a run without it
+    bool threaded = false;
+    for (int i = 1; i < argc; i++) {
+      if (0 == strcmp(argv[i], "--threaded")) {
+        threaded = true;
+      } else if (0 == strcmp(argv[i], "--drain-on-resize")) {
+        w.v.drainOnRecreate = true;
+      } else if (0 == strncmp(argv[i], "--frames-in-flight=", 19)) {
+        w.v.framesInFlight = static_cast<u8>(atoi(argv[i] + 19));
+      }
+    }
+    isUBODirty.assign(w.v.framesInFlight, true);
     auto gamePad1 = mks::Gamepad{0};
-    mks::Logger::Infof("Controller Id: %d, Name: %s", gamePad1.index, gamePad1.GetControllerName());
-    gamePad1.Open();
 
-    if (!l.ReloadScript("../assets/lua/pong.lua")) {
-      throw mks::Logger::Errorf(l.GetError());
-    }
+    // assets decode on jobs workers, and finish on the main thread in assets.Update();
+    // at least one worker, so loading never waits on the frame loop
+    mks::Jobs jobs{};
+    const u32 hw = std::thread::hardware_concurrency();
+    jobs.Start(hw > 2 ? hw - 1 : 1);
+    mks::Assets assets{jobs};
+    aa = &assets;
+    assets.Bind(l.L);
+    // each texture gets a slot in the bindless table; scripts put it in texIds
+    assets.uploadTexture = [&w](const mks::Vulkan::DecodedImage& image) {
+      return w.v.CreateTexture(image);
+    };
+    assets.addAudio = [](cm_Source* source, const std::string& path) {
+      return a.addAudioSource(source, path.c_str());
+    };
+
+    // SDL and queue submits stay on the main thread; decoding and pipeline compile do not.
+    mks::TaskGraph init{};
+
+    // read on workers, consumed by main-thread tasks
+    std::vector<char> fragCode;
+    std::vector<char> vertCode;
+
+    auto audioInit = init.Add("audio device", [] { a.init(); }, {}, true);
+
+    auto window = init.Add(
+        "window + device",
+        [&w, &gamePad1] {
+          mks::Gamepad::Enable();
+
+          w.Begin(WINDOW_TITLE, 800, 800);
+          // w.v.aspectRatio = 1.0f / 1;  // ASPECT_SQUARE (default)
+          // w.v.aspectRatio = 16.0f / 9; // ASPECT_WIDESCREEN
+          w.v.AssertDriverValidationLayersSupported();
+#if OS_MAC == 1
+          // enable MoltenVK support for MacOS cross-platform support
+          w.v.requiredDriverExtensionNames.emplace_back(
+              VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+#endif
+          w.v.AssertDriverExtensionsSupported();
+          char instance_name[255];
+          std::sprintf(instance_name, "%s_test", WINDOW_TITLE);
+          w.v.CreateInstance(instance_name, 1, 0, 0);
+          w.v.UsePhysicalDevice(0);
+
+          w.Bind();
+
+          auto b = w.GetDrawableAreaExtentBounds();
+          w.KeepAspectRatio(b.width, b.height);
+
+          mks::Logger::Infof(
+              "Controller Id: %d, Name: %s", gamePad1.index, gamePad1.GetControllerName());
+          gamePad1.Open();
+
+          w.v.InitSwapChain();
+          w.v.CreateImageViews();
+          w.v.CreateRenderPass();
+          w.v.CreateDescriptorSetLayout();  // takes user data inputs
+          w.v.CreateFrameBuffers();
+          w.v.CreateCommandPool();
+        },
+        {},
+        true);
+
+    // the script's loads start right away, and run alongside window creation;
+    // the mixer must be up before any audio decodes
+    auto script = init.Add(
+        "lua script",
+        [&] {
+          if (!l.ReloadScript("../assets/lua/pong.lua")) {
+            throw mks::Logger::Errorf(l.GetError());
+          }
+        },
+        {audioInit});
+
+    auto shaderRead = init.Add(
+        "shader read",
+        [&jobs, &assets, &fragCode, &vertCode] {
+          auto shaders = AssetsOfType(assets, mks::Asset::Type::SHADER);
+          for (const auto& shader : shaders) {
+            jobs.Wait(shader->done);
+          }
+          fragCode = ShaderBySuffix(shaders, ".frag.spv")->bytes;
+          vertCode = ShaderBySuffix(shaders, ".vert.spv")->bytes;
+        },
+        {script});
+
+    auto pipeline = init.Add(
+        "pipeline compile",
+        [&w, &fragCode, &vertCode] {
+          w.v.CreateGraphicsPipeline(
+              fragCode,
+              vertCode,
+              sizeof(Mesh),
+              sizeof(Instance),
+              5,
+              {0, 1, 1, 1, 1},
+              {0, 1, 2, 3, 4},
+              {/*VK_FORMAT_R32G32_SFLOAT*/ 103,
+               /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
+               /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
+               /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
+               /*VK_FORMAT_R32_UINT*/ 98},
+              {offsetof(Mesh, vertex),
+               offsetof(Instance, pos),
+               offsetof(Instance, rot),
+               offsetof(Instance, scale),
+               offsetof(Instance, texId)});
+        },
+        {window, shaderRead});
+
+    // descriptor sets need the texture; audio keeps loading into the first frames
+    auto textureUpload = init.Add(
+        "texture upload",
+        [&assets] {
+          for (const auto& texture : AssetsOfType(assets, mks::Asset::Type::TEXTURE)) {
+            if (!assets.Wait(texture)) {
+              throw mks::Logger::Errorf("failed to load %s", texture->path.c_str());
+            }
+          }
+        },
+        {window, script},
+        true);
+
+    // pipeline creation sizes the vertex buffer list
+    auto bufferUpload = init.Add(
+        "buffer upload",
+        [&w] {
+          w.v.CreateVertexBuffer(0, VectorSize(vertices), vertices.data());
+          // contents are uploaded from dirtyInstances on first frame
+          w.v.CreateVertexBuffer(1, sizeof(Instance) * INITIAL_INSTANCE_CAPACITY, nullptr);
+          w.v.CreateIndexBuffer(sizeof(indices[0]) * indices.size(), indices.data());
+          w.v.CreateUniformBuffers(sizeof(ubo_ProjView));
+        },
+        {pipeline},
+        true);
+
+    init.Add(
+        "descriptors + commands",
+        [&w] {
+          w.v.CreateTextureSampler();
+          w.v.CreateDescriptorPool();  // setting
+          w.v.CreateDescriptorSets();  // setting
+          w.v.CreateCommandBuffers();  // these theoretically would get used in render loop by me
+          w.v.CreateSyncObjects();     // fence and semaphores
+        },
+        {textureUpload, bufferUpload},
+        true);
 
-    w.v.InitSwapChain();
-    w.v.CreateImageViews();
-    w.v.CreateRenderPass();
-    w.v.CreateDescriptorSetLayout();  // takes user data inputs
-    w.v.CreateGraphicsPipeline(       // reads shaders in
-        shaderFiles[0],
-        shaderFiles[1],
-        sizeof(Mesh),
-        sizeof(Instance),
-        5,
-        {0, 1, 1, 1, 1},
-        {0, 1, 2, 3, 4},
-        {/*VK_FORMAT_R32G32_SFLOAT*/ 103,
-         /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
-         /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
-         /*VK_FORMAT_R32G32B32_SFLOAT*/ 106,
-         /*VK_FORMAT_R32_UINT*/ 98},
-        {offsetof(Mesh, vertex),
-         offsetof(Instance, pos),
-         offsetof(Instance, rot),
-         offsetof(Instance, scale),
-         offsetof(Instance, texId)});
-    w.v.CreateFrameBuffers();
-    w.v.CreateCommandPool();
-
-    w.v.CreateTextureImage(textureFiles[0].c_str());
-    w.v.CreateTextureImageView();
-    w.v.CreateTextureSampler();
-    w.v.CreateVertexBuffer(0, VectorSize(vertices), vertices.data());
-    w.v.CreateVertexBuffer(
-        1,
-        sizeof(Instance) * MAX_INSTANCES /*VectorSize(instances)*/,
-        instances.data());
-    w.v.CreateIndexBuffer(sizeof(indices[0]) * indices.size(), indices.data());
-    w.v.CreateUniformBuffers(sizeof(ubo_ProjView));
-
-    w.v.CreateDescriptorPool();  // setting
-    w.v.CreateDescriptorSets();  // setting
-    w.v.CreateCommandBuffers();  // these theoretically would get used in render loop by me
-    w.v.CreateSyncObjects();     // fence and semaphores
+    init.Run(jobs);
+    init.LogTimeline();
 
     ubo_ProjView ubo1{};                                    // projection x view matrices
     w.v.drawIndexCount = static_cast<u32>(indices.size());  // vertices per mesh (two triangles)
 
-    w.RenderLoop(
-        PHYSICS_FPS,
-        RENDER_FPS,
-        [&l](const float deltaTime) {
-          lua_getglobal(l.L, "OnFixedUpdate");
-          lua_pushnumber(l.L, deltaTime);
-          lua_pcall(l.L, 1, 0, 0);
-        },
-        [&w, &ubo1, &l](const float deltaTime) {
-          lua_getglobal(l.L, "OnUpdate");
-          lua_pushnumber(l.L, deltaTime);
-          lua_pcall(l.L, 1, 0, 0);
-
-          if (isVBODirty) {
-            isVBODirty = false;
-            w.v.instanceCount = instances.size();
-            w.v.UpdateVertexBuffer(1, VectorSize(instances), instances.data());
-          }
-
-          if (isUBODirty[w.v.currentFrame]) {
-            isUBODirty[w.v.currentFrame] = false;
-            ubo1.view = glm::lookAt(
-                glm::vec3(world.cam.x, world.cam.y, world.cam.z),
-                glm::vec3(world.look.x, world.look.y, world.look.z),
-                glm::vec3(0.0f, 1.0f, 0.0f));  // Y-axis points upwards (GLM default)
-            w.v.aspectRatio = world.aspect;    // sync viewport
-            // ubo1.proj = glm::perspective(
-            //     glm::radians(45.0f),  // half the actual 90deg fov
-            //     world.aspect,
-            //     0.1f,  // TODO: adjust clipping range for z depth?
-            //     10.0f);
-            ubo1.proj = glm::ortho(-0.5f, +0.5f, -0.5f, +0.5f, 0.1f, 10.0f);
-            ubo1.user1 = world.user1;
-            ubo1.user2 = world.user2;
-            // TODO: not sure i make use of one UBO per frame, really
-            w.v.UpdateUniformBuffer(w.v.currentFrame, &ubo1);
-          }
-        });
+    auto onFixedUpdate = [&l, &physics](const float deltaTime) {
+      physics.Step(deltaTime);
+      if (!physics.DispatchContacts(l.L, "OnContacts")) {
+        mks::Logger::Infof("OnContacts: %.160s", l.GetError().c_str());
+        lua_pop(l.L, 1);
+      }
+      lua_getglobal(l.L, "OnFixedUpdate");
+      lua_pushnumber(l.L, deltaTime);
+      lua_pcall(l.L, 1, 0, 0);
+    };
+    auto onUpdate = [&w, &l, &physics](const float deltaTime) {
+      FlushPendingPlays();
+      lua_getglobal(l.L, "OnUpdate");
+      lua_pushnumber(l.L, deltaTime);
+      // physics runs at a fixed rate; this is how far we are toward its next step
+      lua_pushnumber(l.L, w.physics.Alpha());
+      lua_pcall(l.L, 2, 0, 0);
+      // draw bodies between their last two fixed steps
+      physics.Interpolate(w.physics.Alpha(), [](u32 instance, f32 x, f32 y) {
+        if (instance >= instances.size()) {
+          return;
+        }
+        instances[instance].pos.x = x;
+        instances[instance].pos.y = y;
+        dirtyInstances.Mark(instance);
+      });
+    };
+    auto logFirstFrame = [&w, &startupBegin]() {
+      if (0 == w.v.frameNumber) {
+        mks::Logger::Infof(
+            "time to first frame: %.2fms",
+            std::chrono::duration<f64, std::milli>(
+                std::chrono::high_resolution_clock::now() - startupBegin)
+                .count());
+      }
+    };
+    auto writeUBO = [&w, &ubo1](const World& world) {
+      ubo1.view = glm::lookAt(
+          glm::vec3(world.cam.x, world.cam.y, world.cam.z),
+          glm::vec3(world.look.x, world.look.y, world.look.z),
+          glm::vec3(0.0f, 1.0f, 0.0f));  // Y-axis points upwards (GLM default)
+      w.v.aspectRatio = world.aspect;    // sync viewport
+      // ubo1.proj = glm::perspective(
+      //     glm::radians(45.0f),  // half the actual 90deg fov
+      //     world.aspect,
+      //     0.1f,  // TODO: adjust clipping range for z depth?
+      //     10.0f);
+      ubo1.proj = glm::ortho(-0.5f, +0.5f, -0.5f, +0.5f, 0.1f, 10.0f);
+      ubo1.user1 = world.user1;
+      ubo1.user2 = world.user2;
+      // TODO: not sure i make use of one UBO per frame, really
+      w.v.UpdateUniformBuffer(w.v.currentFrame, &ubo1);
+    };
+
+    mks::Logger::Infof(
+        "simulation: %s, %u frames in flight",
+        threaded ? "own thread" : "render thread",
+        w.v.framesInFlight);
+
+    if (!threaded) {
+      w.RenderLoop(
+          PHYSICS_FPS,
+          RENDER_FPS,
+          onFixedUpdate,
+          [&w, &assets, &onUpdate, &logFirstFrame, &writeUBO](const float deltaTime) {
+            logFirstFrame();
+            assets.Update();
+            onUpdate(deltaTime);
+
+            if (dirtyInstances.IsDirty()) {
+              w.v.instanceCount = instances.size();
+              // upload only the modified instances
+              w.v.UpdateVertexBufferRanges(
+                  1,
+                  instances.data(),
+                  dirtyInstances.Coalesce(sizeof(Instance)));
+              dirtyInstances.Clear();
+            }
+
+            if (isUBODirty[w.v.currentFrame]) {
+              isUBODirty[w.v.currentFrame] = false;
+              writeUBO(world);
+            }
+          });
+    } else {
+      // Lua, instances, and world belong to the simulation thread;
+      // the render thread only ever sees published copies
+      mks::TripleBuffer<Snapshot> snapshots{};
+      u64 published = 0;
+      u64 drawn = 0;
+
+      w.RenderLoopThreaded(
+          PHYSICS_FPS,
+          RENDER_FPS,
+          onFixedUpdate,
+          [&snapshots, &published, &onUpdate](
+              const float deltaTime, const mks::InputStamp& input) {
+            onUpdate(deltaTime);
+
+            auto& snapshot = snapshots.Write();
+            snapshot.sequence = ++published;
+            snapshot.input = input;
+            snapshot.instances = instances;
+            snapshot.dirty = dirtyInstances.Coalesce(sizeof(Instance));
+            dirtyInstances.Clear();
+            snapshot.world = world;
+            snapshots.Publish();
+          },
+          [&w, &assets, &snapshots, &drawn, &logFirstFrame, &writeUBO](const float deltaTime) {
+            logFirstFrame();
+            assets.Update();
+
+            snapshots.Update();
+            const auto& snapshot = snapshots.Read();
+            if (0 == snapshot.sequence) {
+              // nothing simulated yet
+              return mks::InputStamp{};
+            }
+
+            if (snapshot.sequence != drawn) {
+              w.v.instanceCount = snapshot.instances.size();
+              if (snapshot.sequence == drawn + 1) {
+                // upload only the modified instances
+                w.v.UpdateVertexBufferRanges(1, snapshot.instances.data(), snapshot.dirty);
+              } else {
+                // skipped a snapshot (and its dirty ranges); upload them all
+                w.v.UpdateVertexBufferRanges(
+                    1,
+                    snapshot.instances.data(),
+                    {{0, sizeof(Instance) * snapshot.instances.size()}});
+              }
+              drawn = snapshot.sequence;
+            }
+
+            writeUBO(snapshot.world);
+            return snapshot.input;
+          });
+    }
 
+    // pending loads still upload textures and add audio sources; finish them first
+    assets.WaitAll();
     w.v.DeviceWaitIdle();
     gamePad1.Close();
     w.v.Cleanup();
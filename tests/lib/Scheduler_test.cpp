@@ -0,0 +1,275 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../../src/components/Components.hpp"
+#include "../../src/lib/Base.hpp"
+#include "../../src/lib/Ecs.hpp"
+#include "../../src/lib/Engine.hpp"
+#include "../../src/lib/Jobs.hpp"
+#include "../../src/lib/Logger.hpp"
+#include "../../src/lib/Scheduler.hpp"
+
+namespace {
+
+const u32 ENTITY_COUNT = 20000;
+const u32 FRAMES = 100;
+const f32 DT = 1.0f / 120;
+
+struct Health {
+  f32 hp = 0;
+};
+
+struct Score {
+  f32 points = 0;
+};
+
+// independent components, for systems with nothing to wait on
+template <u32 N>
+struct Load {
+  f32 value = 0;
+};
+
+/**
+ * Two chains which don't touch each other's components:
+ *   integrate -> bounce -> drag, and regen -> score.
+ * Whatever runs concurrently, the result must match running them in order.
+ */
+void AddChains(mks::Engine& engine) {
+  auto& registry = engine.registry;
+  engine.AddSystem(
+      "bounce",
+      mks::Reads<mks::Transform>{},
+      mks::Writes<mks::RigidBody2D>{},
+      [&registry](f32) {
+        registry.Each<mks::Transform, mks::RigidBody2D>(
+            [](mks::Entity, const mks::Transform& t, mks::RigidBody2D& body) {
+              if (t.x > 10 || t.x < -10) {
+                body.vx = -body.vx;
+              }
+            });
+      });
+  engine.AddSystem(
+      "drag",
+      mks::Reads<mks::RigidBody2D>{},
+      mks::Writes<mks::Transform>{},
+      [&registry](f32 dt) {
+        registry.Each<mks::Transform, mks::RigidBody2D>(
+            [dt](mks::Entity, mks::Transform& t, const mks::RigidBody2D& body) {
+              t.x -= body.vx * dt * 0.5f;
+            });
+      });
+  engine.AddSystem(
+      "regen", mks::Reads<>{}, mks::Writes<Health>{}, [&registry](f32 dt) {
+        registry.Each<Health>([dt](mks::Entity, Health& h) { h.hp = Min(h.hp + dt * 7, 100); });
+      });
+  engine.AddSystem(
+      "score", mks::Reads<Health>{}, mks::Writes<Score>{}, [&registry](f32) {
+        registry.Each<Health, Score>(
+            [](mks::Entity, const Health& h, Score& s) { s.points += h.hp * 0.01f; });
+      });
+}
+
+void Populate(mks::Registry& registry) {
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    const auto e = registry.Create();
+    registry.Add<mks::Transform>(e, {static_cast<f32>(i % 20) - 10, 0});
+    registry.Add<mks::RigidBody2D>(e, {static_cast<f32>(i % 7) * 30 - 90, 0});
+    registry.Add<Health>(e, {static_cast<f32>(i % 100)});
+    if (0 == i % 3) {
+      registry.Add<Score>(e);
+    }
+  }
+}
+
+bool CheckOrdering() {
+  bool ok = true;
+  mks::Engine serial{};
+  mks::Engine parallel{};
+  parallel.jobs.Start(3);
+  for (auto* engine : {&serial, &parallel}) {
+    AddChains(*engine);
+    Populate(engine->registry);
+  }
+
+  // integrate(0) -> bounce(1) -> drag(2); regen(3) -> score(4)
+  ok &= parallel.systems.Dependencies(0).empty();
+  ok &= std::vector<u32>{0} == parallel.systems.Dependencies(1);
+  ok &= std::vector<u32>{0, 1} == parallel.systems.Dependencies(2);
+  ok &= parallel.systems.Dependencies(3).empty();
+  ok &= std::vector<u32>{3} == parallel.systems.Dependencies(4);
+
+  for (u32 frame = 0; frame < FRAMES; frame++) {
+    serial.Update(DT);
+    parallel.Update(DT);
+  }
+  auto& a = serial.registry.Pool<mks::Transform>().Components();
+  auto& b = parallel.registry.Pool<mks::Transform>().Components();
+  auto& sa = serial.registry.Pool<Score>().Components();
+  auto& sb = parallel.registry.Pool<Score>().Components();
+  for (u32 i = 0; i < a.size(); i++) {
+    ok &= a[i].x == b[i].x;
+  }
+  for (u32 i = 0; i < sa.size(); i++) {
+    ok &= sa[i].points == sb[i].points;
+  }
+  if (!ok) {
+    mks::Logger::Infof("FAIL ordering");
+  }
+  return ok;
+}
+
+bool CheckMainThreadAndErrors() {
+  bool ok = true;
+  mks::Jobs jobs{};
+  jobs.Start(3);
+  mks::Scheduler scheduler{};
+  const auto mainId = std::this_thread::get_id();
+  u32 ranOnMain = 0;
+  u32 ranAfterThrow = 0;
+  // sdl -> throws -> after
+  scheduler.Add("sdl", mks::Reads<>{}, mks::Writes<Health>{}, [&](f32) {
+    ranOnMain += std::this_thread::get_id() == mainId;
+  }, true);
+  scheduler.Add("throws", mks::Reads<>{}, mks::Writes<Health>{}, [](f32) {
+    throw std::runtime_error("system failed");
+  });
+  scheduler.Add("after", mks::Reads<Health>{}, mks::Writes<>{}, [&](f32) { ranAfterThrow++; });
+
+  for (u32 frame = 0; frame < 10; frame++) {
+    try {
+      scheduler.Run(jobs, DT);
+      ok = false;
+    } catch (const std::runtime_error& e) {
+      ok &= std::string("system failed") == e.what();
+    }
+  }
+  ok &= 10 == ranOnMain && 0 == ranAfterThrow;
+  if (!ok) {
+    mks::Logger::Infof("FAIL main thread / errors");
+  }
+  return ok;
+}
+
+/**
+ * A system which uses a component it didn't declare must fail, rather than race the
+ * others for the Registry's pools.
+ */
+bool CheckUndeclared() {
+  bool ok = true;
+  mks::Engine engine{};
+  engine.jobs.Start(3);
+  auto& registry = engine.registry;
+  Populate(registry);
+  engine.AddSystem("regen", mks::Reads<>{}, mks::Writes<Health>{}, [&registry](f32) {
+    registry.Each<Health>([](mks::Entity, Health& h) { h.hp += 1; });
+  });
+  engine.AddSystem("sneaky", mks::Reads<Health>{}, mks::Writes<>{}, [&registry](f32) {
+    registry.Each<Load<99>>([](mks::Entity, Load<99>&) {});
+  });
+  try {
+    engine.Update(DT);
+    ok = false;
+  } catch (const std::runtime_error& e) {
+    ok &= std::string(e.what()).find("didn't declare") != std::string::npos;
+  }
+  // declared, but created from within the system; its pool didn't exist before Run()
+  mks::Scheduler scheduler{};
+  scheduler.Add(
+      "late", {}, {mks::Registry::ComponentId<Load<98>>()}, [&registry](f32) {
+        registry.Each<Load<98>>([](mks::Entity, Load<98>&) {});
+      });
+  try {
+    scheduler.Run(engine.jobs, DT);
+    ok = false;
+  } catch (const std::runtime_error& e) {
+    ok &= std::string(e.what()).find("no pool") != std::string::npos;
+  }
+  // outside of systems, anything goes
+  registry.Each<Load<99>>([](mks::Entity, Load<99>&) {});
+  if (!ok) {
+    mks::Logger::Infof("FAIL undeclared components");
+  }
+  return ok;
+}
+
+template <u32 N>
+void AddLoad(mks::Engine& engine) {
+  auto& registry = engine.registry;
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    registry.Add<Load<N>>(mks::Entity{i, 0}, {static_cast<f32>(i)});
+  }
+  engine.AddSystem(
+      "load " + std::to_string(N), mks::Reads<>{}, mks::Writes<Load<N>>{}, [&registry](f32 dt) {
+        registry.Each<Load<N>>([dt](mks::Entity, Load<N>& l) {
+          for (u32 k = 0; k < 16; k++) {
+            l.value = l.value * 0.999f + dt;
+          }
+        });
+      });
+}
+
+template <u32... N>
+void AddLoads(mks::Engine& engine, std::integer_sequence<u32, N...>) {
+  (AddLoad<N>(engine), ...);
+}
+
+/**
+ * Eight independent systems and the two chains, serially and on every hardware thread.
+ */
+void Bench() {
+  f64 wallMs[2] = {};
+  for (const bool threaded : {false, true}) {
+    mks::Engine engine{};
+    if (threaded) {
+      engine.Run();
+    }
+    AddChains(engine);
+    Populate(engine.registry);
+    AddLoads(engine, std::make_integer_sequence<u32, 8>{});
+    for (u32 frame = 0; frame < FRAMES; frame++) {
+      engine.Update(DT);
+      wallMs[threaded] += engine.systems.LastWallMs();
+    }
+    if (threaded) {
+      engine.systems.LogTimings();
+    }
+  }
+  mks::Logger::Infof(
+      "%u systems: serial %.3fms/frame, scheduled %.3fms/frame on %u threads",
+      13u,
+      wallMs[0] / FRAMES,
+      wallMs[1] / FRAMES,
+      std::thread::hardware_concurrency());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    mks::Logger::Infof("Begin Scheduler test.");
+    bool ok = true;
+
+    ok &= CheckOrdering();
+    ok &= CheckMainThreadAndErrors();
+    ok &= CheckUndeclared();
+    Bench();
+
+    mks::Logger::Infof(ok ? "End of test." : "Test failed.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Fatal: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Unidentifiable error" << std::endl;
+    return EXIT_FAILURE;
+  }
+}